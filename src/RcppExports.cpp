@@ -11,9 +11,10 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // trial_mdp
-void trial_mdp(int n_patients, float failure_cost, float block_cost, std::string sqlite_fname, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic, float act_l, float act_u, int act_n);
-RcppExport SEXP _TrialMDP_trial_mdp(SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP sqlite_fnameSEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP, SEXP act_lSEXP, SEXP act_uSEXP, SEXP act_nSEXP) {
+SEXP trial_mdp(int n_patients, float failure_cost, float block_cost, std::string sqlite_fname, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic, float act_l, float act_u, int act_n, std::string act_search, int act_coarse, int act_validate, int coarse_factor, float epsilon, bool reachable_only, bool reach_prob, bool return_handle, std::string cache_dir, double memory_budget_gb, int n_processes, std::string backup);
+RcppExport SEXP _TrialMDP_trial_mdp(SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP sqlite_fnameSEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP, SEXP act_lSEXP, SEXP act_uSEXP, SEXP act_nSEXP, SEXP act_searchSEXP, SEXP act_coarseSEXP, SEXP act_validateSEXP, SEXP coarse_factorSEXP, SEXP epsilonSEXP, SEXP reachable_onlySEXP, SEXP reach_probSEXP, SEXP return_handleSEXP, SEXP cache_dirSEXP, SEXP memory_budget_gbSEXP, SEXP n_processesSEXP, SEXP backupSEXP) {
 BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< int >::type n_patients(n_patientsSEXP);
     Rcpp::traits::input_parameter< float >::type failure_cost(failure_costSEXP);
@@ -30,13 +31,358 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< float >::type act_l(act_lSEXP);
     Rcpp::traits::input_parameter< float >::type act_u(act_uSEXP);
     Rcpp::traits::input_parameter< int >::type act_n(act_nSEXP);
-    trial_mdp(n_patients, failure_cost, block_cost, sqlite_fname, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic, act_l, act_u, act_n);
+    Rcpp::traits::input_parameter< std::string >::type act_search(act_searchSEXP);
+    Rcpp::traits::input_parameter< int >::type act_coarse(act_coarseSEXP);
+    Rcpp::traits::input_parameter< int >::type act_validate(act_validateSEXP);
+    Rcpp::traits::input_parameter< int >::type coarse_factor(coarse_factorSEXP);
+    Rcpp::traits::input_parameter< float >::type epsilon(epsilonSEXP);
+    Rcpp::traits::input_parameter< bool >::type reachable_only(reachable_onlySEXP);
+    Rcpp::traits::input_parameter< bool >::type reach_prob(reach_probSEXP);
+    Rcpp::traits::input_parameter< bool >::type return_handle(return_handleSEXP);
+    Rcpp::traits::input_parameter< std::string >::type cache_dir(cache_dirSEXP);
+    Rcpp::traits::input_parameter< double >::type memory_budget_gb(memory_budget_gbSEXP);
+    Rcpp::traits::input_parameter< int >::type n_processes(n_processesSEXP);
+    Rcpp::traits::input_parameter< std::string >::type backup(backupSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp(n_patients, failure_cost, block_cost, sqlite_fname, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic, act_l, act_u, act_n, act_search, act_coarse, act_validate, coarse_factor, epsilon, reachable_only, reach_prob, return_handle, cache_dir, memory_budget_gb, n_processes, backup));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_lookup
+DataFrame trial_mdp_lookup(SEXP design, IntegerVector a0, IntegerVector a1, IntegerVector b0, IntegerVector b1);
+RcppExport SEXP _TrialMDP_trial_mdp_lookup(SEXP designSEXP, SEXP a0SEXP, SEXP a1SEXP, SEXP b0SEXP, SEXP b1SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type design(designSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type a0(a0SEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type a1(a1SEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type b0(b0SEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type b1(b1SEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_lookup(design, a0, a1, b0, b1));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_columns
+DataFrame trial_mdp_columns(SEXP design);
+RcppExport SEXP _TrialMDP_trial_mdp_columns(SEXP designSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type design(designSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_columns(design));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_save
+void trial_mdp_save(SEXP design, std::string fname, std::string format, bool reachable_only, bool reach_prob, int value_bits);
+RcppExport SEXP _TrialMDP_trial_mdp_save(SEXP designSEXP, SEXP fnameSEXP, SEXP formatSEXP, SEXP reachable_onlySEXP, SEXP reach_probSEXP, SEXP value_bitsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type design(designSEXP);
+    Rcpp::traits::input_parameter< std::string >::type fname(fnameSEXP);
+    Rcpp::traits::input_parameter< std::string >::type format(formatSEXP);
+    Rcpp::traits::input_parameter< bool >::type reachable_only(reachable_onlySEXP);
+    Rcpp::traits::input_parameter< bool >::type reach_prob(reach_probSEXP);
+    Rcpp::traits::input_parameter< int >::type value_bits(value_bitsSEXP);
+    trial_mdp_save(design, fname, format, reachable_only, reach_prob, value_bits);
+    return R_NilValue;
+END_RCPP
+}
+// trial_mdp_async
+SEXP trial_mdp_async(int n_patients, float failure_cost, float block_cost, std::string sqlite_fname, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic, float act_l, float act_u, int act_n, std::string act_search, int act_coarse, float epsilon, bool reachable_only, bool reach_prob, int n_workers);
+RcppExport SEXP _TrialMDP_trial_mdp_async(SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP sqlite_fnameSEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP, SEXP act_lSEXP, SEXP act_uSEXP, SEXP act_nSEXP, SEXP act_searchSEXP, SEXP act_coarseSEXP, SEXP epsilonSEXP, SEXP reachable_onlySEXP, SEXP reach_probSEXP, SEXP n_workersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type n_patients(n_patientsSEXP);
+    Rcpp::traits::input_parameter< float >::type failure_cost(failure_costSEXP);
+    Rcpp::traits::input_parameter< float >::type block_cost(block_costSEXP);
+    Rcpp::traits::input_parameter< std::string >::type sqlite_fname(sqlite_fnameSEXP);
+    Rcpp::traits::input_parameter< int >::type min_size(min_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type block_incr(block_incrSEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a0(prior_a0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a1(prior_a1SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b0(prior_b0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b1(prior_b1SEXP);
+    Rcpp::traits::input_parameter< std::string >::type transition_dist(transition_distSEXP);
+    Rcpp::traits::input_parameter< std::string >::type test_statistic(test_statisticSEXP);
+    Rcpp::traits::input_parameter< float >::type act_l(act_lSEXP);
+    Rcpp::traits::input_parameter< float >::type act_u(act_uSEXP);
+    Rcpp::traits::input_parameter< int >::type act_n(act_nSEXP);
+    Rcpp::traits::input_parameter< std::string >::type act_search(act_searchSEXP);
+    Rcpp::traits::input_parameter< int >::type act_coarse(act_coarseSEXP);
+    Rcpp::traits::input_parameter< float >::type epsilon(epsilonSEXP);
+    Rcpp::traits::input_parameter< bool >::type reachable_only(reachable_onlySEXP);
+    Rcpp::traits::input_parameter< bool >::type reach_prob(reach_probSEXP);
+    Rcpp::traits::input_parameter< int >::type n_workers(n_workersSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_async(n_patients, failure_cost, block_cost, sqlite_fname, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic, act_l, act_u, act_n, act_search, act_coarse, epsilon, reachable_only, reach_prob, n_workers));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_job_status
+List trial_mdp_job_status(SEXP job);
+RcppExport SEXP _TrialMDP_trial_mdp_job_status(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_job_status(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_job_wait
+bool trial_mdp_job_wait(SEXP job, double timeout);
+RcppExport SEXP _TrialMDP_trial_mdp_job_wait(SEXP jobSEXP, SEXP timeoutSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    Rcpp::traits::input_parameter< double >::type timeout(timeoutSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_job_wait(job, timeout));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_job_cancel
+void trial_mdp_job_cancel(SEXP job);
+RcppExport SEXP _TrialMDP_trial_mdp_job_cancel(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    trial_mdp_job_cancel(job);
+    return R_NilValue;
+END_RCPP
+}
+// trial_mdp_job_result
+SEXP trial_mdp_job_result(SEXP job);
+RcppExport SEXP _TrialMDP_trial_mdp_job_result(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_job_result(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_plan
+List trial_mdp_plan(int n_patients, float failure_cost, float block_cost, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic, float act_l, float act_u, int act_n, double memory_budget_gb, bool calibrate, std::string backup, int coarse_factor, int n_processes);
+RcppExport SEXP _TrialMDP_trial_mdp_plan(SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP, SEXP act_lSEXP, SEXP act_uSEXP, SEXP act_nSEXP, SEXP memory_budget_gbSEXP, SEXP calibrateSEXP, SEXP backupSEXP, SEXP coarse_factorSEXP, SEXP n_processesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type n_patients(n_patientsSEXP);
+    Rcpp::traits::input_parameter< float >::type failure_cost(failure_costSEXP);
+    Rcpp::traits::input_parameter< float >::type block_cost(block_costSEXP);
+    Rcpp::traits::input_parameter< int >::type min_size(min_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type block_incr(block_incrSEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a0(prior_a0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a1(prior_a1SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b0(prior_b0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b1(prior_b1SEXP);
+    Rcpp::traits::input_parameter< std::string >::type transition_dist(transition_distSEXP);
+    Rcpp::traits::input_parameter< std::string >::type test_statistic(test_statisticSEXP);
+    Rcpp::traits::input_parameter< float >::type act_l(act_lSEXP);
+    Rcpp::traits::input_parameter< float >::type act_u(act_uSEXP);
+    Rcpp::traits::input_parameter< int >::type act_n(act_nSEXP);
+    Rcpp::traits::input_parameter< double >::type memory_budget_gb(memory_budget_gbSEXP);
+    Rcpp::traits::input_parameter< bool >::type calibrate(calibrateSEXP);
+    Rcpp::traits::input_parameter< std::string >::type backup(backupSEXP);
+    Rcpp::traits::input_parameter< int >::type coarse_factor(coarse_factorSEXP);
+    Rcpp::traits::input_parameter< int >::type n_processes(n_processesSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_plan(n_patients, failure_cost, block_cost, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic, act_l, act_u, act_n, memory_budget_gb, calibrate, backup, coarse_factor, n_processes));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_oc
+DataFrame trial_mdp_oc(std::string sqlite_fname, NumericVector p_a, NumericVector p_b, float alpha);
+RcppExport SEXP _TrialMDP_trial_mdp_oc(SEXP sqlite_fnameSEXP, SEXP p_aSEXP, SEXP p_bSEXP, SEXP alphaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type sqlite_fname(sqlite_fnameSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type p_a(p_aSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type p_b(p_bSEXP);
+    Rcpp::traits::input_parameter< float >::type alpha(alphaSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_oc(sqlite_fname, p_a, p_b, alpha));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_simulate
+List trial_mdp_simulate(std::string sqlite_fname, float p_a, float p_b, int n_trials, int n_threads, int seed, float alpha, bool return_traces);
+RcppExport SEXP _TrialMDP_trial_mdp_simulate(SEXP sqlite_fnameSEXP, SEXP p_aSEXP, SEXP p_bSEXP, SEXP n_trialsSEXP, SEXP n_threadsSEXP, SEXP seedSEXP, SEXP alphaSEXP, SEXP return_tracesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type sqlite_fname(sqlite_fnameSEXP);
+    Rcpp::traits::input_parameter< float >::type p_a(p_aSEXP);
+    Rcpp::traits::input_parameter< float >::type p_b(p_bSEXP);
+    Rcpp::traits::input_parameter< int >::type n_trials(n_trialsSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< float >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< bool >::type return_traces(return_tracesSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_simulate(sqlite_fname, p_a, p_b, n_trials, n_threads, seed, alpha, return_traces));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_evaluate
+void trial_mdp_evaluate(std::string policy_fname, int n_patients, float failure_cost, float block_cost, std::string sqlite_fname, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic);
+RcppExport SEXP _TrialMDP_trial_mdp_evaluate(SEXP policy_fnameSEXP, SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP sqlite_fnameSEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type policy_fname(policy_fnameSEXP);
+    Rcpp::traits::input_parameter< int >::type n_patients(n_patientsSEXP);
+    Rcpp::traits::input_parameter< float >::type failure_cost(failure_costSEXP);
+    Rcpp::traits::input_parameter< float >::type block_cost(block_costSEXP);
+    Rcpp::traits::input_parameter< std::string >::type sqlite_fname(sqlite_fnameSEXP);
+    Rcpp::traits::input_parameter< int >::type min_size(min_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type block_incr(block_incrSEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a0(prior_a0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a1(prior_a1SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b0(prior_b0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b1(prior_b1SEXP);
+    Rcpp::traits::input_parameter< std::string >::type transition_dist(transition_distSEXP);
+    Rcpp::traits::input_parameter< std::string >::type test_statistic(test_statisticSEXP);
+    trial_mdp_evaluate(policy_fname, n_patients, failure_cost, block_cost, sqlite_fname, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic);
+    return R_NilValue;
+END_RCPP
+}
+// trial_mdp_approx
+void trial_mdp_approx(int n_patients, float failure_cost, float block_cost, std::string sqlite_fname, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic, float act_l, float act_u, int act_n, int grid_n, int grid_p, float epsilon, std::string exact_fname);
+RcppExport SEXP _TrialMDP_trial_mdp_approx(SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP sqlite_fnameSEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP, SEXP act_lSEXP, SEXP act_uSEXP, SEXP act_nSEXP, SEXP grid_nSEXP, SEXP grid_pSEXP, SEXP epsilonSEXP, SEXP exact_fnameSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type n_patients(n_patientsSEXP);
+    Rcpp::traits::input_parameter< float >::type failure_cost(failure_costSEXP);
+    Rcpp::traits::input_parameter< float >::type block_cost(block_costSEXP);
+    Rcpp::traits::input_parameter< std::string >::type sqlite_fname(sqlite_fnameSEXP);
+    Rcpp::traits::input_parameter< int >::type min_size(min_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type block_incr(block_incrSEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a0(prior_a0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a1(prior_a1SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b0(prior_b0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b1(prior_b1SEXP);
+    Rcpp::traits::input_parameter< std::string >::type transition_dist(transition_distSEXP);
+    Rcpp::traits::input_parameter< std::string >::type test_statistic(test_statisticSEXP);
+    Rcpp::traits::input_parameter< float >::type act_l(act_lSEXP);
+    Rcpp::traits::input_parameter< float >::type act_u(act_uSEXP);
+    Rcpp::traits::input_parameter< int >::type act_n(act_nSEXP);
+    Rcpp::traits::input_parameter< int >::type grid_n(grid_nSEXP);
+    Rcpp::traits::input_parameter< int >::type grid_p(grid_pSEXP);
+    Rcpp::traits::input_parameter< float >::type epsilon(epsilonSEXP);
+    Rcpp::traits::input_parameter< std::string >::type exact_fname(exact_fnameSEXP);
+    trial_mdp_approx(n_patients, failure_cost, block_cost, sqlite_fname, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic, act_l, act_u, act_n, grid_n, grid_p, epsilon, exact_fname);
+    return R_NilValue;
+END_RCPP
+}
+// trial_mdp_solve_from
+DataFrame trial_mdp_solve_from(int n_patients, float failure_cost, float block_cost, int a0, int a1, int b0, int b1, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic, float act_l, float act_u, int act_n, std::string sqlite_fname);
+RcppExport SEXP _TrialMDP_trial_mdp_solve_from(SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP a0SEXP, SEXP a1SEXP, SEXP b0SEXP, SEXP b1SEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP, SEXP act_lSEXP, SEXP act_uSEXP, SEXP act_nSEXP, SEXP sqlite_fnameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type n_patients(n_patientsSEXP);
+    Rcpp::traits::input_parameter< float >::type failure_cost(failure_costSEXP);
+    Rcpp::traits::input_parameter< float >::type block_cost(block_costSEXP);
+    Rcpp::traits::input_parameter< int >::type a0(a0SEXP);
+    Rcpp::traits::input_parameter< int >::type a1(a1SEXP);
+    Rcpp::traits::input_parameter< int >::type b0(b0SEXP);
+    Rcpp::traits::input_parameter< int >::type b1(b1SEXP);
+    Rcpp::traits::input_parameter< int >::type min_size(min_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type block_incr(block_incrSEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a0(prior_a0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a1(prior_a1SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b0(prior_b0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b1(prior_b1SEXP);
+    Rcpp::traits::input_parameter< std::string >::type transition_dist(transition_distSEXP);
+    Rcpp::traits::input_parameter< std::string >::type test_statistic(test_statisticSEXP);
+    Rcpp::traits::input_parameter< float >::type act_l(act_lSEXP);
+    Rcpp::traits::input_parameter< float >::type act_u(act_uSEXP);
+    Rcpp::traits::input_parameter< int >::type act_n(act_nSEXP);
+    Rcpp::traits::input_parameter< std::string >::type sqlite_fname(sqlite_fnameSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_solve_from(n_patients, failure_cost, block_cost, a0, a1, b0, b1, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic, act_l, act_u, act_n, sqlite_fname));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_mcts
+List trial_mdp_mcts(int n_patients, float failure_cost, float block_cost, int a0, int a1, int b0, int b1, double seconds, int n_threads, int seed, double max_iter, float exploration, int min_size, int block_incr, float prior_a0, float prior_a1, float prior_b0, float prior_b1, std::string transition_dist, std::string test_statistic, float act_l, float act_u, int act_n);
+RcppExport SEXP _TrialMDP_trial_mdp_mcts(SEXP n_patientsSEXP, SEXP failure_costSEXP, SEXP block_costSEXP, SEXP a0SEXP, SEXP a1SEXP, SEXP b0SEXP, SEXP b1SEXP, SEXP secondsSEXP, SEXP n_threadsSEXP, SEXP seedSEXP, SEXP max_iterSEXP, SEXP explorationSEXP, SEXP min_sizeSEXP, SEXP block_incrSEXP, SEXP prior_a0SEXP, SEXP prior_a1SEXP, SEXP prior_b0SEXP, SEXP prior_b1SEXP, SEXP transition_distSEXP, SEXP test_statisticSEXP, SEXP act_lSEXP, SEXP act_uSEXP, SEXP act_nSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type n_patients(n_patientsSEXP);
+    Rcpp::traits::input_parameter< float >::type failure_cost(failure_costSEXP);
+    Rcpp::traits::input_parameter< float >::type block_cost(block_costSEXP);
+    Rcpp::traits::input_parameter< int >::type a0(a0SEXP);
+    Rcpp::traits::input_parameter< int >::type a1(a1SEXP);
+    Rcpp::traits::input_parameter< int >::type b0(b0SEXP);
+    Rcpp::traits::input_parameter< int >::type b1(b1SEXP);
+    Rcpp::traits::input_parameter< double >::type seconds(secondsSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< double >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< float >::type exploration(explorationSEXP);
+    Rcpp::traits::input_parameter< int >::type min_size(min_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type block_incr(block_incrSEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a0(prior_a0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_a1(prior_a1SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b0(prior_b0SEXP);
+    Rcpp::traits::input_parameter< float >::type prior_b1(prior_b1SEXP);
+    Rcpp::traits::input_parameter< std::string >::type transition_dist(transition_distSEXP);
+    Rcpp::traits::input_parameter< std::string >::type test_statistic(test_statisticSEXP);
+    Rcpp::traits::input_parameter< float >::type act_l(act_lSEXP);
+    Rcpp::traits::input_parameter< float >::type act_u(act_uSEXP);
+    Rcpp::traits::input_parameter< int >::type act_n(act_nSEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_mcts(n_patients, failure_cost, block_cost, a0, a1, b0, b1, seconds, n_threads, seed, max_iter, exploration, min_size, block_incr, prior_a0, prior_a1, prior_b0, prior_b1, transition_dist, test_statistic, act_l, act_u, act_n));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trial_mdp_compact
+void trial_mdp_compact(std::string sqlite_fname, std::string compact_fname, int value_bits);
+RcppExport SEXP _TrialMDP_trial_mdp_compact(SEXP sqlite_fnameSEXP, SEXP compact_fnameSEXP, SEXP value_bitsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type sqlite_fname(sqlite_fnameSEXP);
+    Rcpp::traits::input_parameter< std::string >::type compact_fname(compact_fnameSEXP);
+    Rcpp::traits::input_parameter< int >::type value_bits(value_bitsSEXP);
+    trial_mdp_compact(sqlite_fname, compact_fname, value_bits);
     return R_NilValue;
 END_RCPP
 }
+// trial_mdp_compact_lookup
+DataFrame trial_mdp_compact_lookup(std::string compact_fname, IntegerVector a0, IntegerVector a1, IntegerVector b0, IntegerVector b1);
+RcppExport SEXP _TrialMDP_trial_mdp_compact_lookup(SEXP compact_fnameSEXP, SEXP a0SEXP, SEXP a1SEXP, SEXP b0SEXP, SEXP b1SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type compact_fname(compact_fnameSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type a0(a0SEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type a1(a1SEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type b0(b0SEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type b1(b1SEXP);
+    rcpp_result_gen = Rcpp::wrap(trial_mdp_compact_lookup(compact_fname, a0, a1, b0, b1));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_TrialMDP_trial_mdp", (DL_FUNC) &_TrialMDP_trial_mdp, 15},
+    {"_TrialMDP_trial_mdp", (DL_FUNC) &_TrialMDP_trial_mdp, 27},
+    {"_TrialMDP_trial_mdp_lookup", (DL_FUNC) &_TrialMDP_trial_mdp_lookup, 5},
+    {"_TrialMDP_trial_mdp_columns", (DL_FUNC) &_TrialMDP_trial_mdp_columns, 1},
+    {"_TrialMDP_trial_mdp_save", (DL_FUNC) &_TrialMDP_trial_mdp_save, 6},
+    {"_TrialMDP_trial_mdp_async", (DL_FUNC) &_TrialMDP_trial_mdp_async, 21},
+    {"_TrialMDP_trial_mdp_job_status", (DL_FUNC) &_TrialMDP_trial_mdp_job_status, 1},
+    {"_TrialMDP_trial_mdp_job_wait", (DL_FUNC) &_TrialMDP_trial_mdp_job_wait, 2},
+    {"_TrialMDP_trial_mdp_job_cancel", (DL_FUNC) &_TrialMDP_trial_mdp_job_cancel, 1},
+    {"_TrialMDP_trial_mdp_job_result", (DL_FUNC) &_TrialMDP_trial_mdp_job_result, 1},
+    {"_TrialMDP_trial_mdp_plan", (DL_FUNC) &_TrialMDP_trial_mdp_plan, 19},
+    {"_TrialMDP_trial_mdp_oc", (DL_FUNC) &_TrialMDP_trial_mdp_oc, 4},
+    {"_TrialMDP_trial_mdp_simulate", (DL_FUNC) &_TrialMDP_trial_mdp_simulate, 8},
+    {"_TrialMDP_trial_mdp_evaluate", (DL_FUNC) &_TrialMDP_trial_mdp_evaluate, 13},
+    {"_TrialMDP_trial_mdp_approx", (DL_FUNC) &_TrialMDP_trial_mdp_approx, 19},
+    {"_TrialMDP_trial_mdp_solve_from", (DL_FUNC) &_TrialMDP_trial_mdp_solve_from, 19},
+    {"_TrialMDP_trial_mdp_mcts", (DL_FUNC) &_TrialMDP_trial_mdp_mcts, 23},
+    {"_TrialMDP_trial_mdp_compact", (DL_FUNC) &_TrialMDP_trial_mdp_compact, 3},
+    {"_TrialMDP_trial_mdp_compact_lookup", (DL_FUNC) &_TrialMDP_trial_mdp_compact_lookup, 5},
     {NULL, NULL, 0}
 };
 
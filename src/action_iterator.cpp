@@ -118,3 +118,21 @@ int ActionIterator::action_b(){
 int ActionIterator::get_next_size_idx(){
     return next_size_idx;
 }
+
+
+std::vector<BlockAction> ActionIterator::all_actions(int n_idx){
+    std::vector<BlockAction> actions;
+    reset(n_idx);
+    while(not_finished()){
+        BlockAction act;
+        act.block_size = block_size;
+        act.a_A = act_a;
+        act.a_B = act_b;
+        act.next_size_idx = next_size_idx;
+        act.order = actions.size();
+        act.bound = 0.0;
+        actions.push_back(act);
+        advance();
+    }
+    return actions;
+}
@@ -16,6 +16,17 @@
 #include "contingency_table.h"
 #include <vector>
 
+// A single action, as yielded by an ActionIterator.
+// `order` is its position in the iteration order.
+struct BlockAction{
+    int block_size;
+    int a_A;
+    int a_B;
+    int next_size_idx;
+    int order;
+    float bound;
+};
+
 class ActionIterator{
 
     private:
@@ -71,6 +82,9 @@ class ActionIterator{
         int action_b();
 
 	int get_next_size_idx();
+
+        // All of the actions, in iteration order
+        std::vector<BlockAction> all_actions(int n_idx);
 };
 
 #endif
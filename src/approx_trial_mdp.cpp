@@ -0,0 +1,507 @@
+// approx_trial_mdp.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the ApproxTrialMDP class
+
+#include "approx_trial_mdp.h"
+#include "trial_mdp_table.h"
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
+
+
+ApproxTrialMDP::ApproxTrialMDP(int n_pat, float failure_cost, float block_cost,
+                               int min_size, int block_incr,
+                               float pr_a0, float pr_a1,
+                               float pr_b0, float pr_b1,
+                               std::string tr_dist,
+                               std::string test_statistic,
+                               float act_l, float act_u, int act_n,
+                               int g_n, int g_p){
+
+    check_trial_size(n_pat, "ApproxTrialMDP");
+    if(g_n < 2 || g_p < 2){
+        std::cerr << "`ApproxTrialMDP`: grid_n and grid_p must be at least 2." << std::endl;
+        throw 1;
+    }
+
+    n_patients = n_pat;
+    grid_n = g_n;
+    grid_p = g_p;
+    prior_a0 = pr_a0;
+    prior_a1 = pr_a1;
+    prior_b0 = pr_b0;
+    prior_b1 = pr_b1;
+
+    result_interpreter = ResultInterpreter(test_statistic, failure_cost, block_cost, n_patients);
+    n_attr = result_interpreter.get_n_attr();
+
+    n_vec = build_n_vec(n_patients, min_size, block_incr);
+    action_iterator = new ActionIterator(act_l, act_u, act_n, n_vec, min_size, 0);
+    transition_dist = TransitionDist::make_transition_dist(tr_dist,
+                                                           prior_a0, prior_a1,
+                                                           prior_b0, prior_b1);
+    terminal_rule = TerminalRule::make_terminal_rule(test_statistic, failure_cost);
+
+    na_grid = std::vector< std::vector<int> >(n_vec.size());
+    na_offset = std::vector< std::vector<int> >(n_vec.size());
+    grid_values = std::vector< std::vector<float> >(n_vec.size());
+    grid_block_size = std::vector< std::vector<int> >(n_vec.size());
+    grid_a_allocation = std::vector< std::vector<int> >(n_vec.size());
+    for(unsigned int idx=0; idx < n_vec.size(); ++idx){
+        build_grid(idx);
+    }
+}
+
+
+/**
+ * Lay out a level's grid: up to grid_n arm-A sample sizes, evenly
+ * spaced; for each, up to grid_p success counts per arm.
+ */
+void ApproxTrialMDP::build_grid(int idx){
+
+    int n = n_vec[idx];
+    int k_max = std::min(grid_n, n + 1);
+
+    std::vector<int> sizes;
+    for(int k=0; k < k_max; ++k){
+        int n_a = (k_max == 1) ? 0 : int(round(float(k) * n / (k_max - 1)));
+        if(sizes.empty() || n_a != sizes.back()){
+            sizes.push_back(n_a);
+        }
+    }
+
+    std::vector<int> offsets;
+    int count = 0;
+    for(unsigned int r=0; r < sizes.size(); ++r){
+        offsets.push_back(count);
+        count += p_grid_size(sizes[r]) * p_grid_size(n - sizes[r]);
+    }
+    offsets.push_back(count);
+
+    na_grid[idx] = sizes;
+    na_offset[idx] = offsets;
+    grid_values[idx] = std::vector<float>(count * n_attr, 0.0);
+    grid_block_size[idx] = std::vector<int>(count, 0);
+    grid_a_allocation[idx] = std::vector<int>(count, 0);
+}
+
+
+int ApproxTrialMDP::n_grid_points(int idx){
+    return na_offset[idx].back();
+}
+
+
+// The i-th grid point's number of successes, in an arm with n_arm patients
+int ApproxTrialMDP::p_grid_count(int i, int n_arm){
+    int g = p_grid_size(n_arm);
+    if(g == 1){ return 0; }
+    return int(round(float(i) * n_arm / (g - 1)));
+}
+
+
+ContingencyTable ApproxTrialMDP::representative(int idx, int r, int i, int j){
+    int n_a = na_grid[idx][r];
+    int n_b = n_vec[idx] - n_a;
+    int a1 = p_grid_count(i, n_a);
+    int b1 = p_grid_count(j, n_b);
+    return ContingencyTable(n_a - a1, a1, n_b - b1, b1);
+}
+
+
+void ApproxTrialMDP::store(int idx, int r, int i, int j, StateResult& res){
+    int n_b = n_vec[idx] - na_grid[idx][r];
+    int pos = na_offset[idx][r] + i*p_grid_size(n_b) + j;
+    grid_block_size[idx][pos] = res.block_size;
+    grid_a_allocation[idx][pos] = res.a_allocation;
+    for(int k=0; k < n_attr; ++k){
+        grid_values[idx][pos*n_attr + k] = res.values[k];
+    }
+}
+
+
+/**
+ * Find the grid points bracketing a value (in counts of
+ * successes) within an arm of n_arm patients; and the
+ * weight on the upper one.
+ */
+void bracket(float x, int n_arm, int g, int& i0, float& t){
+    if(g == 1){
+        i0 = 0;
+        t = 0.0;
+        return;
+    }
+    x = std::min(std::max(x, 0.0f), float(n_arm));
+    float u = x * (g - 1) / n_arm;
+    i0 = std::min(int(floor(u)), g - 2);
+    float lo = round(float(i0) * n_arm / (g - 1));
+    float hi = round(float(i0 + 1) * n_arm / (g - 1));
+    t = (hi > lo) ? (x - lo) / (hi - lo) : 0.0;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+}
+
+
+/**
+ * Locate an arm with n_arm patients and `successes` successes
+ * within the grid row for arm-A sample size na_grid[idx][r]:
+ * find the grid points bracketing it (by posterior mean success
+ * rate), and the weight on the upper one.
+ */
+void ApproxTrialMDP::arm_position(int idx, int r, bool arm_a, int n_arm, int successes,
+                                  int& i0, float& t){
+
+    int m = arm_a ? na_grid[idx][r] : n_vec[idx] - na_grid[idx][r];
+    float pr_0 = arm_a ? prior_a0 : prior_b0;
+    float pr_1 = arm_a ? prior_a1 : prior_b1;
+
+    // Successes (among this row's m patients) matching the posterior mean
+    float x = successes;
+    if(m != n_arm){
+        float mean = (successes + pr_1) / (n_arm + pr_0 + pr_1);
+        x = mean * (m + pr_0 + pr_1) - pr_1;
+    }
+    bracket(x, m, p_grid_size(m), i0, t);
+}
+
+
+/**
+ * Add `weight` times the bilinear interpolation between
+ * grid points (i0, j0) and (i0+1, j0+1) of row r
+ */
+void ApproxTrialMDP::add_corners(int idx, int r, int i0, float t_a, int j0, float t_b,
+                                 float weight, StateResult& result){
+
+    int g_b = p_grid_size(n_vec[idx] - na_grid[idx][r]);
+    const float* row_values = &grid_values[idx][0] + na_offset[idx][r]*n_attr;
+
+    for(int di=0; di < 2; ++di){
+        float w_a = (di == 0) ? 1.0 - t_a : t_a;
+        for(int dj=0; dj < 2; ++dj){
+            float w = weight * w_a * ((dj == 0) ? 1.0 - t_b : t_b);
+            // (Skip empty corners; they may hold -infinity)
+            if(w <= 0.0){ continue; }
+
+            const float* v = row_values + ((i0 + di)*g_b + (j0 + dj))*n_attr;
+            for(int k=0; k < n_attr; ++k){
+                result.values[k] += w * v[k];
+            }
+        }
+    }
+}
+
+
+/**
+ * Find the grid rows (arm-A sample sizes) bracketing n_a,
+ * and their weights
+ */
+int ApproxTrialMDP::row_weights(int idx, int n_a, int* rows, float* weights){
+
+    const std::vector<int>& sizes = na_grid[idx];
+    int r1 = int(std::lower_bound(sizes.begin(), sizes.end(), n_a) - sizes.begin());
+
+    if(sizes[r1] == n_a){
+        rows[0] = r1;
+        weights[0] = 1.0;
+        return 1;
+    }
+    float t = float(n_a - sizes[r1 - 1]) / float(sizes[r1] - sizes[r1 - 1]);
+    rows[0] = r1 - 1;
+    weights[0] = 1.0 - t;
+    rows[1] = r1;
+    weights[1] = t;
+    return 2;
+}
+
+
+/**
+ * Interpolate the values of table ct from the grid of its level
+ */
+void ApproxTrialMDP::interpolate(int idx, ContingencyTable ct, StateResult& result){
+
+    for(int k=0; k < n_attr; ++k){
+        result.values[k] = 0.0;
+    }
+
+    int n_a = ct.a0 + ct.a1;
+    int n_b = ct.b0 + ct.b1;
+    int rows[2];
+    float weights[2];
+    int n_rows = row_weights(idx, n_a, rows, weights);
+    for(int q=0; q < n_rows; ++q){
+        int i0, j0;
+        float t_a, t_b;
+        arm_position(idx, rows[q], true, n_a, ct.a1, i0, t_a);
+        arm_position(idx, rows[q], false, n_b, ct.b1, j0, t_b);
+        add_corners(idx, rows[q], i0, t_a, j0, t_b, weights[q], result);
+    }
+}
+
+
+/**
+ * Collapse one arm's outcomes (successes in [lo, hi]) into at most 
+ * grid_p bins of consecutive counts. Each bin is represented by its
+ * (rounded) mean count, and carries its total probability. 
+ * (The successor grid can't resolve finer outcomes anyway; and 
+ * blocks with at most grid_p outcomes aren't binned at all.)
+ */
+void ApproxTrialMDP::bin_outcomes(bool arm_a, int lo, int hi,
+                                  std::vector<int>& counts, std::vector<float>& mass){
+    counts.clear();
+    mass.clear();
+
+    int n_outcomes = hi - lo + 1;
+    int n_bins = std::min(grid_p, n_outcomes);
+    for(int k=0; k < n_bins; ++k){
+        int first = lo + (k * n_outcomes) / n_bins;
+        int last = lo + ((k + 1) * n_outcomes) / n_bins - 1;
+
+        float m = 0.0;
+        float mean = 0.0;
+        for(int c=first; c <= last; ++c){
+            float p = arm_a ? transition_dist->a_prob(c) : transition_dist->b_prob(c);
+            m += p;
+            mean += p * c;
+        }
+        if(m <= 0.0){ continue; }
+
+        counts.push_back(int(round(mean / m)));
+        mass.push_back(m);
+    }
+}
+
+
+/**
+ * For a representative table, find the action that maximizes
+ * expected reward, w.r.t. the interpolated successor values
+ */
+StateResult ApproxTrialMDP::max_expected_reward(int cur_idx, ContingencyTable ct){
+
+    int rwd_idx = n_attr - 1;
+
+    StateResult best_choice = StateResult(n_attr);
+    best_choice.values[rwd_idx] = -std::numeric_limits<float>::infinity();
+    StateResult expected_values = StateResult(n_attr);
+    StateResult next_values = StateResult(n_attr);
+    std::vector<int> a_counts, b_counts;
+    std::vector<float> a_mass, b_mass;
+    std::vector<int> a_pos[2], b_pos[2];
+    std::vector<float> a_t[2], b_t[2];
+
+    std::vector<BlockAction> actions = action_iterator->all_actions(cur_idx);
+    for(unsigned int k=0; k < actions.size(); ++k){
+        BlockAction& act = actions[k];
+
+        for(int i=0; i < n_attr; ++i){
+            expected_values.values[i] = 0.0;
+        }
+
+        transition_dist->set_state_action(ct, act.a_A, act.a_B);
+        bin_outcomes(true, transition_dist->a_lower(), transition_dist->a_upper(), a_counts, a_mass);
+        bin_outcomes(false, transition_dist->b_lower(), transition_dist->b_upper(), b_counts, b_mass);
+
+        // Every successor has the same arm sizes; so locate
+        // each arm's outcomes in the next level's grid just once
+        int next_idx = act.next_size_idx;
+        int next_n_a = ct.a0 + ct.a1 + act.a_A;
+        int next_n_b = ct.b0 + ct.b1 + act.a_B;
+        int rows[2];
+        float weights[2];
+        int n_rows = row_weights(next_idx, next_n_a, rows, weights);
+        for(int q=0; q < n_rows; ++q){
+            a_pos[q].resize(a_counts.size());
+            a_t[q].resize(a_counts.size());
+            for(unsigned int ia=0; ia < a_counts.size(); ++ia){
+                arm_position(next_idx, rows[q], true, next_n_a, ct.a1 + a_counts[ia], a_pos[q][ia], a_t[q][ia]);
+            }
+            b_pos[q].resize(b_counts.size());
+            b_t[q].resize(b_counts.size());
+            for(unsigned int ib=0; ib < b_counts.size(); ++ib){
+                arm_position(next_idx, rows[q], false, next_n_b, ct.b1 + b_counts[ib], b_pos[q][ib], b_t[q][ib]);
+            }
+        }
+
+        for(unsigned int ia=0; ia < a_counts.size(); ++ia){
+            int n_A = a_counts[ia];
+            for(unsigned int ib=0; ib < b_counts.size(); ++ib){
+                int n_B = b_counts[ib];
+
+                for(int k=0; k < n_attr; ++k){
+                    next_values.values[k] = 0.0;
+                }
+                for(int q=0; q < n_rows; ++q){
+                    add_corners(next_idx, rows[q], a_pos[q][ia], a_t[q][ia], 
+                                b_pos[q][ib], b_t[q][ib], weights[q], next_values);
+                }
+
+                float prob = a_mass[ia] * b_mass[ib];
+                result_interpreter.compute_lookaheads(ct, act.a_A, act.a_B, n_A, n_B, next_values);
+                for(int i=0; i < n_attr; ++i){
+                    expected_values.values[i] += (prob * result_interpreter.look_ahead(i));
+                }
+                result_interpreter.clear_lookaheads();
+            }
+        }
+
+        if(expected_values.values[rwd_idx] > best_choice.values[rwd_idx]){
+            best_choice.block_size = act.block_size;
+            best_choice.a_allocation = act.a_A;
+            for(int i=0; i < n_attr; ++i){
+                best_choice.values[i] = expected_values.values[i];
+            }
+        }
+    }
+
+    return best_choice;
+}
+
+
+void ApproxTrialMDP::solve(){
+
+    long n_states = 0;
+    for(int idx = int(n_vec.size()) - 1; idx >= 0; --idx){
+
+        bool terminal = (idx == int(n_vec.size()) - 1);
+        for(unsigned int r=0; r < na_grid[idx].size(); ++r){
+
+            int n_a = na_grid[idx][r];
+            int g_a = p_grid_size(n_a);
+            int g_b = p_grid_size(n_vec[idx] - n_a);
+            for(int i=0; i < g_a; ++i){
+                for(int j=0; j < g_b; ++j){
+                    ContingencyTable ct = representative(idx, r, i, j);
+                    StateResult res;
+                    if(terminal){
+                        res = (*terminal_rule)(result_interpreter, ct);
+                    }else{
+                        res = max_expected_reward(idx, ct);
+                    }
+                    store(idx, r, i, j, res);
+                    n_states++;
+                }
+            }
+        }
+    }
+
+    // Compare with the number of tables the exact solver visits
+    double n_exact = 0.0;
+    for(unsigned int idx=0; idx < n_vec.size(); ++idx){
+        double n = n_vec[idx];
+        n_exact += (n + 1.0)*(n + 2.0)*(n + 3.0)/6.0;
+    }
+    std::cout << "Approximate solve: " << n_states << " grid states (the exact solver has "
+              << n_exact << ")" << std::endl;
+
+    StateResult first_move = StateResult(n_attr);
+    interpolate(0, ContingencyTable(), first_move);
+    first_move.block_size = grid_block_size[0][0];
+    first_move.a_allocation = grid_a_allocation[0][0];
+    std::cout << result_interpreter.pretty_print_result(first_move);
+}
+
+
+/**
+ * Copy the representative tables' results into a TrialMDPTable
+ */
+TrialMDPTable* ApproxTrialMDP::representative_table(){
+
+    TrialMDPTable* table = new TrialMDPTable(n_vec);
+    for(unsigned int idx=0; idx < n_vec.size(); ++idx){
+        for(unsigned int r=0; r < na_grid[idx].size(); ++r){
+            int n_b = n_vec[idx] - na_grid[idx][r];
+            int g_a = p_grid_size(na_grid[idx][r]);
+            int g_b = p_grid_size(n_b);
+            for(int i=0; i < g_a; ++i){
+                for(int j=0; j < g_b; ++j){
+                    int pos = na_offset[idx][r] + i*g_b + j;
+                    StateResult res = StateResult(n_attr);
+                    res.block_size = grid_block_size[idx][pos];
+                    res.a_allocation = grid_a_allocation[idx][pos];
+                    for(int k=0; k < n_attr; ++k){
+                        res.values[k] = grid_values[idx][pos*n_attr + k];
+                    }
+                    (*table)(idx, representative(idx, r, i, j)) = res;
+                }
+            }
+        }
+    }
+    return table;
+}
+
+
+ApproxValidation ApproxTrialMDP::validate(TrialMDPTable& exact){
+
+    if(exact.get_n_vec() != n_vec){
+        std::cerr << "`validate`: the exact design's table sizes don't match this problem's. Check n_patients, min_size and block_incr." << std::endl;
+        throw 1;
+    }
+
+    int rwd_idx = n_attr - 1;
+    ApproxValidation result;
+    result.n_states = 0;
+    result.action_agreement = 0.0;
+    result.max_reward_error = 0.0;
+    result.mean_reward_error = 0.0;
+    result.first_move_error = 0.0;
+
+    long n_same = 0;
+    double total_error = 0.0;
+    for(unsigned int idx=0; idx + 1 < n_vec.size(); ++idx){
+        for(unsigned int r=0; r < na_grid[idx].size(); ++r){
+            int n_b = n_vec[idx] - na_grid[idx][r];
+            int g_a = p_grid_size(na_grid[idx][r]);
+            int g_b = p_grid_size(n_b);
+            for(int i=0; i < g_a; ++i){
+                for(int j=0; j < g_b; ++j){
+                    const StateResult* exact_res = exact.lookup(idx, representative(idx, r, i, j));
+                    if(exact_res == NULL || exact_res->n_values != n_attr){
+                        std::cerr << "`validate`: the exact design is missing states, or has different attributes." << std::endl;
+                        throw 1;
+                    }
+                    int pos = na_offset[idx][r] + i*g_b + j;
+                    float error = fabs(grid_values[idx][pos*n_attr + rwd_idx] - exact_res->values[rwd_idx]);
+
+                    result.n_states++;
+                    total_error += error;
+                    result.max_reward_error = std::max(result.max_reward_error, error);
+                    if(exact_res->block_size == grid_block_size[idx][pos] &&
+                       exact_res->a_allocation == grid_a_allocation[idx][pos]){
+                        n_same++;
+                    }
+                    if(idx == 0){
+                        result.first_move_error = error;
+                    }
+                }
+            }
+        }
+    }
+
+    if(result.n_states > 0){
+        result.action_agreement = float(n_same) / result.n_states;
+        result.mean_reward_error = total_error / result.n_states;
+    }
+    return result;
+}
+
+
+void ApproxTrialMDP::to_sqlite(char* db_fname, int chunk_size){
+    TrialMDPTable* table = representative_table();
+    try{
+        table->to_sqlite(db_fname, result_interpreter, chunk_size);
+    }
+    catch(...){
+        table->release();
+        delete table;
+        throw;
+    }
+    table->release();
+    delete table;
+}
+
+
+ApproxTrialMDP::~ApproxTrialMDP(){
+    delete action_iterator;
+    delete transition_dist;
+    delete terminal_rule;
+}
@@ -0,0 +1,122 @@
+// approx_trial_mdp.h
+// (c) 2021-03 David Merrell
+//
+// An approximate solver for trials too large to enumerate
+// every contingency table.
+//
+// Each level's tables are aggregated onto a grid of posterior
+// summaries: the sample size in arm A (grid_n points), and the
+// posterior mean success rate in each arm (grid_p points apiece,
+// spanning the attainable range). The DP runs only on one
+// representative table per grid point; successor values are
+// interpolated (linearly in each summary) from the next level's grid.
+//
+// When the grids are at least as fine as the tables themselves
+// (grid_n, grid_p > n_patients) every table is a grid point and
+// the solution is exact.
+//
+// The solver reuses TransitionDist, ResultInterpreter, and the
+// RESULTS export, so its output has the same schema as TrialMDP's.
+// (It contains only the representative tables, though.)
+
+#ifndef _APPROX_TRIAL_MDP_H
+#define _APPROX_TRIAL_MDP_H
+
+#include "result_interpreter.h"
+#include "contingency_table.h"
+#include "state_result.h"
+#include "trial_mdp_table.h"
+#include "action_iterator.h"
+#include "transition_dist.h"
+#include "terminal_rule.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+// Agreement between an approximate design and an exact one,
+// over the approximate design's representative tables
+struct ApproxValidation{
+    long n_states;
+    float action_agreement;
+    float max_reward_error;
+    float mean_reward_error;
+    float first_move_error;
+};
+
+
+class ApproxTrialMDP{
+
+    private:
+        int n_patients;
+        int n_attr;
+        int grid_n;
+        int grid_p;
+        float prior_a0;
+        float prior_a1;
+        float prior_b0;
+        float prior_b1;
+
+        std::vector<int> n_vec;
+
+        // For each level: the grid of arm-A sample sizes, the offset
+        // of each sample size's block of grid points, and the
+        // solution (values are n_attr floats per grid point)
+        std::vector< std::vector<int> > na_grid;
+        std::vector< std::vector<int> > na_offset;
+        std::vector< std::vector<float> > grid_values;
+        std::vector< std::vector<int> > grid_block_size;
+        std::vector< std::vector<int> > grid_a_allocation;
+
+        ActionIterator* action_iterator;
+        TransitionDist* transition_dist;
+        TerminalRule* terminal_rule;
+        ResultInterpreter result_interpreter;
+
+        // Private methods
+        void build_grid(int idx);
+        int n_grid_points(int idx);
+        int p_grid_size(int n_arm){ return std::min(grid_p, n_arm + 1); }
+        int p_grid_count(int i, int n_arm);
+        ContingencyTable representative(int idx, int r, int i, int j);
+        void store(int idx, int r, int i, int j, StateResult& res);
+        void arm_position(int idx, int r, bool arm_a, int n_arm, int successes,
+                          int& i0, float& t);
+        void add_corners(int idx, int r, int i0, float t_a, int j0, float t_b,
+                         float weight, StateResult& result);
+        int row_weights(int idx, int n_a, int* rows, float* weights);
+        void interpolate(int idx, ContingencyTable ct, StateResult& result);
+        void bin_outcomes(bool arm_a, int lo, int hi,
+                          std::vector<int>& counts, std::vector<float>& mass);
+        StateResult max_expected_reward(int cur_idx, ContingencyTable ct);
+        TrialMDPTable* representative_table();
+
+    public:
+        // (Same problem parameters as TrialMDP;
+        //  plus the grid resolutions)
+        ApproxTrialMDP(int n_patients, float failure_cost, float block_cost,
+                       int min_size, int block_incr,
+                       float prior_a0, float prior_a1,
+                       float prior_b0, float prior_b1,
+                       std::string transition_dist="beta_binom",
+                       std::string test_statistic="scaled_cmh",
+                       float act_l=0.2, float act_u=0.8, int act_n=7,
+                       int grid_n=21, int grid_p=21);
+
+        void solve();
+
+        // Drop each arm's outcomes outside the central 1 - eps
+        // of its mass (see TransitionDist::set_epsilon)
+        void set_epsilon(float eps){ transition_dist->set_epsilon(eps); }
+
+        // Compare against an exact design for the same problem
+        // (e.g., loaded with TrialMDPTable::from_sqlite)
+        ApproxValidation validate(TrialMDPTable& exact);
+
+        // Save the representative tables' results
+        void to_sqlite(char* db_fname, int chunk_size);
+
+        ~ApproxTrialMDP();
+};
+
+#endif
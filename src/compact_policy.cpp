@@ -0,0 +1,565 @@
+// compact_policy.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the CompactPolicy class.
+
+#include "compact_policy.h"
+#include "state_result.h"
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+////////////////////////////////
+// Little-endian encoding
+////////////////////////////////
+
+void put_u32(std::vector<unsigned char>& buf, uint32_t x){
+    for(int i = 0; i < 4; ++i){
+        buf.push_back((x >> (8*i)) & 0xFF);
+    }
+}
+
+uint32_t get_u32(const unsigned char* p){
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+void put_f32(std::vector<unsigned char>& buf, float x){
+    uint32_t u;
+    std::memcpy(&u, &x, 4);
+    put_u32(buf, u);
+}
+
+float get_f32(const unsigned char* p){
+    uint32_t u = get_u32(p);
+    float x;
+    std::memcpy(&x, &u, 4);
+    return x;
+}
+
+// An unsigned integer of `bytes` bytes
+void put_uint(std::vector<unsigned char>& buf, uint32_t x, int bytes){
+    for(int i = 0; i < bytes; ++i){
+        buf.push_back((x >> (8*i)) & 0xFF);
+    }
+}
+
+uint32_t get_uint(const unsigned char* p, int bytes){
+    uint32_t x = 0;
+    for(int i = 0; i < bytes; ++i){
+        x |= uint32_t(p[i]) << (8*i);
+    }
+    return x;
+}
+
+
+////////////////////////////////
+// Encoding
+////////////////////////////////
+
+CompactPolicy::CompactPolicy(TrialMDPTable& table, std::vector<std::string> names, int bits){
+
+    if(bits != 0 && bits != 8 && bits != 16 && bits != 32){
+        std::cerr << "`CompactPolicy`: value_bits must be 0, 8, 16 or 32." << std::endl;
+        throw 1;
+    }
+    value_bits = bits;
+    attr_names = names;
+    int n_attr = attr_names.size();
+    int value_bytes = value_bits / 8;
+    uint32_t missing_value = (value_bits == 32) ? 0 : (uint32_t(1) << value_bits) - 1;
+
+    data.insert(data.end(), COMPACT_MAGIC, COMPACT_MAGIC + 8);
+    put_u32(data, 1);
+    put_u32(data, value_bits);
+    put_u32(data, n_attr);
+    for(int i = 0; i < n_attr; ++i){
+        put_u32(data, attr_names[i].size());
+        data.insert(data.end(), attr_names[i].begin(), attr_names[i].end());
+    }
+
+    std::vector<int>& n_vec = table.get_n_vec();
+    put_u32(data, n_vec.size());
+
+    for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+
+        // Every table of the level, in rank order
+        int n = n_vec[idx];
+        int64_t n_states = n_tables(n);
+        std::vector<const StateResult*> states;
+        states.reserve(n_states);
+        for(int a0 = 0; a0 <= n; ++a0){
+            for(int a1 = 0; a0 + a1 <= n; ++a1){
+                for(int b0 = 0; a0 + a1 + b0 <= n; ++b0){
+                    states.push_back(table.lookup(idx, ContingencyTable(a0, a1, b0, n - a0 - a1 - b0)));
+                }
+            }
+        }
+
+        // The level's action dictionary
+        // (block size -1 marks missing states)
+        std::map< std::pair<int,int>, int > dict;
+        std::vector< std::pair<int,int> > dict_entries;
+        std::vector<uint32_t> codes = std::vector<uint32_t>(n_states);
+        for(int64_t r = 0; r < n_states; ++r){
+            std::pair<int,int> act = (states[r] == NULL) ? std::make_pair(-1, -1)
+                                     : std::make_pair(states[r]->block_size, states[r]->a_allocation);
+            std::map< std::pair<int,int>, int >::iterator it = dict.find(act);
+            if(it == dict.end()){
+                it = dict.insert(std::make_pair(act, int(dict_entries.size()))).first;
+                dict_entries.push_back(act);
+            }
+            codes[r] = it->second;
+        }
+        if(dict_entries.size() > 65536){
+            std::cerr << "`CompactPolicy`: more than 65536 distinct actions in a level." << std::endl;
+            throw 1;
+        }
+        int code_bytes = (dict_entries.size() <= 256) ? 1 : 2;
+
+        put_u32(data, n);
+        put_u32(data, dict_entries.size());
+        put_u32(data, code_bytes);
+        for(unsigned int k = 0; k < dict_entries.size(); ++k){
+            put_u32(data, uint32_t(dict_entries[k].first));
+            put_u32(data, uint32_t(dict_entries[k].second));
+        }
+
+        // Run-length code each block of ranks: (code, length - 1)
+        std::vector<unsigned char> runs;
+        int64_t n_blocks = (n_states + COMPACT_BLOCK - 1) / COMPACT_BLOCK;
+        std::vector<uint32_t> offsets;
+        for(int64_t b = 0; b < n_blocks; ++b){
+            if(runs.size() > 0xFFFFFFFFu){
+                std::cerr << "`CompactPolicy`: a level's actions don't fit in 4GB." << std::endl;
+                throw 1;
+            }
+            offsets.push_back(runs.size());
+            int64_t stop = std::min(n_states, (b+1)*COMPACT_BLOCK);
+            int64_t r = b*COMPACT_BLOCK;
+            while(r < stop){
+                int64_t run_end = r + 1;
+                while(run_end < stop && codes[run_end] == codes[r]){ run_end++; }
+                put_uint(runs, codes[r], code_bytes);
+                runs.push_back(uint8_t(run_end - r - 1));
+                r = run_end;
+            }
+        }
+        offsets.push_back(runs.size());
+
+        put_u32(data, n_blocks);
+        for(unsigned int b = 0; b < offsets.size(); ++b){
+            put_u32(data, offsets[b]);
+        }
+        data.insert(data.end(), runs.begin(), runs.end());
+
+        // The values: each attribute's range, then its codes
+        for(int i = 0; i < n_attr && value_bits > 0; ++i){
+
+            if(value_bits == 32){
+                for(int64_t r = 0; r < n_states; ++r){
+                    put_f32(data, (states[r] == NULL) ? std::numeric_limits<float>::quiet_NaN()
+                                                      : states[r]->values[i]);
+                }
+                continue;
+            }
+
+            float lo = std::numeric_limits<float>::infinity();
+            float hi = -std::numeric_limits<float>::infinity();
+            for(int64_t r = 0; r < n_states; ++r){
+                if(states[r] != NULL && std::isfinite(states[r]->values[i])){
+                    lo = std::min(lo, states[r]->values[i]);
+                    hi = std::max(hi, states[r]->values[i]);
+                }
+            }
+            if(lo > hi){
+                lo = 0.0;
+                hi = 0.0;
+            }
+            put_f32(data, lo);
+            put_f32(data, hi);
+
+            double scale = (hi > lo) ? (missing_value - 1) / (double(hi) - lo) : 0.0;
+            for(int64_t r = 0; r < n_states; ++r){
+                uint32_t q = missing_value;
+                if(states[r] != NULL && std::isfinite(states[r]->values[i])){
+                    q = uint32_t(std::floor((states[r]->values[i] - lo)*scale + 0.5));
+                }
+                put_uint(data, q, value_bytes);
+            }
+        }
+    }
+
+    bytes = &data[0];
+    n_bytes = data.size();
+    mapping = NULL;
+    index_levels();
+}
+
+
+////////////////////////////////
+// Decoding
+////////////////////////////////
+
+void corrupt_policy(){
+    std::cerr << "`CompactPolicy`: the policy is truncated or corrupt." << std::endl;
+    throw 1;
+}
+
+// Check that `count` items of `size` bytes follow `pos`
+void check_room(size_t pos, uint64_t count, uint64_t size, size_t n_bytes){
+    if(pos > n_bytes || (size > 0 && count > (n_bytes - pos) / size)){
+        corrupt_policy();
+    }
+}
+
+
+// Find each level's pieces in `bytes` (and read the header).
+// Every length and offset is checked against the file's size,
+// and every action code against its level's dictionary, so
+// lookups needn't check them again.
+void CompactPolicy::index_levels(){
+
+    if(n_bytes < 20 || std::memcmp(bytes, COMPACT_MAGIC, 8) != 0){
+        std::cerr << "`CompactPolicy`: not a compact policy." << std::endl;
+        throw 1;
+    }
+
+    size_t pos = 12;
+    value_bits = get_u32(&bytes[pos]); pos += 4;
+    if(value_bits != 0 && value_bits != 8 && value_bits != 16 && value_bits != 32){
+        corrupt_policy();
+    }
+    uint32_t n_attr = get_u32(&bytes[pos]); pos += 4;
+    check_room(pos, n_attr, 4, n_bytes);
+    attr_names.clear();
+    for(uint32_t i = 0; i < n_attr; ++i){
+        check_room(pos, 1, 4, n_bytes);
+        uint32_t len = get_u32(&bytes[pos]); pos += 4;
+        check_room(pos, len, 1, n_bytes);
+        attr_names.push_back(std::string((const char*) bytes + pos, len));
+        pos += len;
+    }
+
+    check_room(pos, 1, 4, n_bytes);
+    uint32_t n_levels = get_u32(&bytes[pos]); pos += 4;
+    check_room(pos, n_levels, 12, n_bytes);
+    levels.clear();
+    for(uint32_t idx = 0; idx < n_levels; ++idx){
+        Level lev;
+        check_room(pos, 3, 4, n_bytes);
+        uint32_t n_total = get_u32(&bytes[pos]); pos += 4;
+        uint32_t n_actions = get_u32(&bytes[pos]); pos += 4;
+        uint32_t code_bytes = get_u32(&bytes[pos]); pos += 4;
+
+        // (Levels are ascending, for level_idx, and their sizes fit a ContingencyTable)
+        if(n_total > 0xFFFF || (idx > 0 && int(n_total) <= levels.back().n_total)
+           || (code_bytes != 1 && code_bytes != 2)
+           || n_actions == 0 || n_actions > (uint32_t(1) << (8*code_bytes))){
+            corrupt_policy();
+        }
+        lev.n_total = n_total;
+        lev.n_states = n_tables(lev.n_total);
+        lev.n_actions = n_actions;
+        lev.code_bytes = code_bytes;
+        check_room(pos, n_actions, 8, n_bytes);
+        lev.actions = pos;
+        pos += 8*size_t(n_actions);
+
+        check_room(pos, 1, 4, n_bytes);
+        int64_t n_blocks = get_u32(&bytes[pos]); pos += 4;
+        if(n_blocks != (lev.n_states + COMPACT_BLOCK - 1) / COMPACT_BLOCK){
+            corrupt_policy();
+        }
+        check_room(pos, n_blocks + 1, 4, n_bytes);
+        lev.block_offsets = pos;
+        pos += 4*size_t(n_blocks + 1);
+        lev.runs = pos;
+        uint64_t runs_size = get_u32(&bytes[lev.block_offsets + 4*n_blocks]);
+        check_room(pos, runs_size, 1, n_bytes);
+        pos += runs_size;
+
+        // Each block's runs must cover exactly its ranks, with known codes
+        int code_size = lev.code_bytes + 1;
+        for(int64_t b = 0; b < n_blocks; ++b){
+            uint64_t start = get_u32(&bytes[lev.block_offsets + 4*b]);
+            uint64_t stop = get_u32(&bytes[lev.block_offsets + 4*(b+1)]);
+            if(start > stop || stop > runs_size || (stop - start) % code_size != 0){
+                corrupt_policy();
+            }
+            int64_t n_ranks = 0;
+            for(uint64_t q = start; q < stop; q += code_size){
+                const unsigned char* run = &bytes[lev.runs + q];
+                if(get_uint(run, lev.code_bytes) >= n_actions){
+                    corrupt_policy();
+                }
+                n_ranks += int64_t(run[lev.code_bytes]) + 1;
+            }
+            if(n_ranks != std::min(int64_t(COMPACT_BLOCK), lev.n_states - b*COMPACT_BLOCK)){
+                corrupt_policy();
+            }
+        }
+
+        lev.values = pos;
+        if(value_bits == 32){
+            check_room(pos, n_attr, 4*uint64_t(lev.n_states), n_bytes);
+            pos += n_attr * 4*size_t(lev.n_states);
+        }else if(value_bits > 0){
+            check_room(pos, n_attr, 8 + (value_bits/8)*uint64_t(lev.n_states), n_bytes);
+            pos += n_attr * (8 + (value_bits/8)*size_t(lev.n_states));
+        }
+        levels.push_back(lev);
+    }
+    if(pos != n_bytes){
+        corrupt_policy();
+    }
+}
+
+
+int CompactPolicy::level_idx(int n_total) const {
+    int lo = 0;
+    int hi = int(levels.size()) - 1;
+    while(lo <= hi){
+        int mid = (lo + hi)/2;
+        if(levels[mid].n_total == n_total){ return mid; }
+        if(levels[mid].n_total < n_total){ lo = mid + 1; }else{ hi = mid - 1; }
+    }
+    return -1;
+}
+
+
+// Decode (part of) one block
+int CompactPolicy::action_code(const Level& lev, int64_t rank) const {
+    int64_t block = rank / COMPACT_BLOCK;
+    int64_t offset = rank % COMPACT_BLOCK;
+    const unsigned char* p = &bytes[lev.runs + get_u32(&bytes[lev.block_offsets + 4*block])];
+    while(true){
+        int code = get_uint(p, lev.code_bytes);
+        int64_t len = int64_t(p[lev.code_bytes]) + 1;
+        if(offset < len){
+            return code;
+        }
+        offset -= len;
+        p += lev.code_bytes + 1;
+    }
+}
+
+
+bool CompactPolicy::lookup_rank(int level, int64_t rank, int& block_size, int& a_allocation) const {
+    const Level& lev = levels[level];
+    if(rank < 0 || rank >= lev.n_states){
+        return false;
+    }
+    int code = action_code(lev, rank);
+    block_size = int32_t(get_u32(&bytes[lev.actions + 8*code]));
+    a_allocation = int32_t(get_u32(&bytes[lev.actions + 8*code + 4]));
+    return block_size >= 0;
+}
+
+
+bool CompactPolicy::lookup(const ContingencyTable& ct, int& block_size, int& a_allocation) const {
+    int idx = level_idx(ct.a0 + ct.a1 + ct.b0 + ct.b1);
+    if(idx < 0){
+        return false;
+    }
+    return lookup_rank(idx, table_rank(ct), block_size, a_allocation);
+}
+
+
+float CompactPolicy::value(const ContingencyTable& ct, int attr_idx) const {
+
+    float nan = std::numeric_limits<float>::quiet_NaN();
+    int idx = level_idx(ct.a0 + ct.a1 + ct.b0 + ct.b1);
+    if(idx < 0 || value_bits == 0 || attr_idx < 0 || attr_idx >= int(attr_names.size())){
+        return nan;
+    }
+    const Level& lev = levels[idx];
+    int64_t rank = table_rank(ct);
+
+    if(value_bits == 32){
+        return get_f32(&bytes[lev.values + 4*(attr_idx*lev.n_states + rank)]);
+    }
+
+    int value_bytes = value_bits / 8;
+    size_t start = lev.values + attr_idx*(8 + value_bytes*lev.n_states);
+    float lo = get_f32(&bytes[start]);
+    float hi = get_f32(&bytes[start + 4]);
+    uint32_t missing_value = (uint32_t(1) << value_bits) - 1;
+    uint32_t q = get_uint(&bytes[start + 8 + value_bytes*rank], value_bytes);
+    if(q == missing_value){
+        return nan;
+    }
+    return lo + q * ((double(hi) - lo) / (missing_value - 1));
+}
+
+
+TrialMDPTable* CompactPolicy::to_table() const {
+
+    std::vector<int> n_vec;
+    for(unsigned int idx = 0; idx < levels.size(); ++idx){
+        n_vec.push_back(levels[idx].n_total);
+    }
+    TrialMDPTable* table = new TrialMDPTable(n_vec);
+    int n_attr = attr_names.size();
+
+    for(unsigned int idx = 0; idx < levels.size(); ++idx){
+        const Level& lev = levels[idx];
+        int n = lev.n_total;
+
+        // The blocks' runs are contiguous: decode them in order
+        const unsigned char* p = &bytes[lev.runs];
+        int code = 0;
+        int64_t left = 0;
+        for(int a0 = 0; a0 <= n; ++a0){
+            for(int a1 = 0; a0 + a1 <= n; ++a1){
+                for(int b0 = 0; a0 + a1 + b0 <= n; ++b0){
+                    if(left == 0){
+                        code = get_uint(p, lev.code_bytes);
+                        left = int64_t(p[lev.code_bytes]) + 1;
+                        p += lev.code_bytes + 1;
+                    }
+                    left--;
+
+                    int block_size = int32_t(get_u32(&bytes[lev.actions + 8*code]));
+                    if(block_size >= 0){
+                        ContingencyTable ct = ContingencyTable(a0, a1, b0, n - a0 - a1 - b0);
+                        StateResult res = StateResult(n_attr);
+                        res.block_size = block_size;
+                        res.a_allocation = int32_t(get_u32(&bytes[lev.actions + 8*code + 4]));
+                        for(int i = 0; i < n_attr; ++i){
+                            res.values[i] = value(ct, i);
+                        }
+                        (*table)(idx, ct) = res;
+                    }
+                }
+            }
+        }
+    }
+    return table;
+}
+
+
+////////////////////////////////
+// Files
+////////////////////////////////
+
+void CompactPolicy::save(std::string fname){
+    std::ofstream out(fname.c_str(), std::ios::binary);
+    if(!out){
+        std::cerr << "`CompactPolicy`: failed to open " << fname << " for writing." << std::endl;
+        throw 1;
+    }
+    out.write((const char*) bytes, n_bytes);
+    out.close();
+    if(!out){
+        std::cerr << "`CompactPolicy`: failed to write " << fname << std::endl;
+        throw 1;
+    }
+}
+
+
+CompactPolicy* CompactPolicy::load(std::string fname){
+    std::ifstream in(fname.c_str(), std::ios::binary | std::ios::ate);
+    if(!in){
+        std::cerr << "`CompactPolicy`: failed to open " << fname << std::endl;
+        throw 1;
+    }
+    CompactPolicy* policy = new CompactPolicy();
+    policy->data.resize(in.tellg());
+    in.seekg(0);
+    in.read((char*) &policy->data[0], policy->data.size());
+    if(!in){
+        delete policy;
+        std::cerr << "`CompactPolicy`: failed to read " << fname << std::endl;
+        throw 1;
+    }
+    policy->bytes = policy->data.empty() ? NULL : &policy->data[0];
+    policy->n_bytes = policy->data.size();
+    try{
+        policy->index_levels();
+    }
+    catch(int code){
+        delete policy;
+        throw code;
+    }
+    return policy;
+}
+
+
+CompactPolicy* CompactPolicy::map(std::string fname){
+
+    int fd = open(fname.c_str(), O_RDONLY);
+    if(fd < 0){
+        std::cerr << "`CompactPolicy`: failed to open " << fname << std::endl;
+        throw 1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        std::cerr << "`CompactPolicy`: failed to read " << fname << std::endl;
+        throw 1;
+    }
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED){
+        std::cerr << "`CompactPolicy`: failed to map " << fname << std::endl;
+        throw 1;
+    }
+
+    CompactPolicy* policy = new CompactPolicy();
+    policy->mapping = addr;
+    policy->bytes = (const unsigned char*) addr;
+    policy->n_bytes = st.st_size;
+    try{
+        policy->index_levels();
+    }
+    catch(int code){
+        delete policy;
+        throw code;
+    }
+    return policy;
+}
+
+
+CompactPolicy::CompactPolicy(const CompactPolicy& other){
+    // A copy holds its own bytes, even if `other` is mapped
+    data = std::vector<unsigned char>(other.bytes, other.bytes + other.n_bytes);
+    bytes = data.empty() ? NULL : &data[0];
+    n_bytes = data.size();
+    mapping = NULL;
+    levels = other.levels;
+    attr_names = other.attr_names;
+    value_bits = other.value_bits;
+}
+
+
+CompactPolicy::~CompactPolicy(){
+    if(mapping != NULL){
+        munmap(mapping, n_bytes);
+    }
+}
+
+
+TrialMDPTable* load_policy_table(std::string fname){
+
+    char magic[8] = {0};
+    std::ifstream in(fname.c_str(), std::ios::binary);
+    if(in){
+        in.read(magic, 8);
+    }
+    if(in && std::memcmp(magic, COMPACT_MAGIC, 8) == 0){
+        CompactPolicy* policy = CompactPolicy::load(fname);
+        TrialMDPTable* table = policy->to_table();
+        delete policy;
+        return table;
+    }
+    return TrialMDPTable::from_sqlite(fname);
+}
@@ -0,0 +1,115 @@
+// compact_policy.h
+// (c) 2021-03 David Merrell
+//
+// A compact binary format for solved trial designs.
+//
+// A deployed design only needs each state's action, and the
+// actions are few: so each level stores a small dictionary of
+// (BlockSize, AAllocation) pairs, and every state's action as a
+// 1- or 2-byte index into it, in rank order (see table_rank).
+// The indices are run-length coded in blocks of COMPACT_BLOCK
+// ranks, with an offset per block, so a lookup decodes at most
+// one block. Runs are long: all of a level's terminal states
+// share an action, and so do neighboring tables.
+//
+// The result attributes are optional. They're stored per level
+// as value_bits-bit codes, linear between the level's minimum
+// and maximum (the largest code means "not finite");
+// or as raw floats (value_bits = 32); or dropped (value_bits = 0).
+//
+// States missing from the source table (e.g., a design saved
+// with only its reachable states) stay missing.
+//
+// The file is a little-endian byte string; `load` reads it
+// into one buffer (or `map` maps it into memory), checks its
+// lengths, offsets and action codes, and lookups decode from
+// those bytes directly.
+
+#ifndef _COMPACT_POLICY_H
+#define _COMPACT_POLICY_H
+
+#include "contingency_table.h"
+#include "trial_mdp_table.h"
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#define COMPACT_BLOCK 256
+#define COMPACT_MAGIC "TMDPPOL1"
+
+class CompactPolicy{
+
+    private:
+        // Where each level's pieces start in `data`
+        struct Level{
+            int n_total;
+            int64_t n_states;
+            int n_actions;
+            int code_bytes;
+            size_t actions;
+            size_t block_offsets;
+            size_t runs;
+            size_t values;
+        };
+
+        // The encoded policy: `bytes` points into `data`,
+        // or into a mapped file (`mapping`)
+        std::vector<unsigned char> data;
+        const unsigned char* bytes;
+        size_t n_bytes;
+        void* mapping;
+        std::vector<Level> levels;
+        std::vector<std::string> attr_names;
+        int value_bits;
+
+        // Private methods
+        CompactPolicy& operator=(const CompactPolicy& other);
+        void index_levels();
+        int level_idx(int n_total) const;
+        int action_code(const Level& lev, int64_t rank) const;
+
+    public:
+        // Encode a solved table (attr_names: its result attributes)
+        CompactPolicy(TrialMDPTable& table, std::vector<std::string> names, int value_bits);
+
+        CompactPolicy(){ value_bits = 0; bytes = NULL; n_bytes = 0; mapping = NULL; }
+        CompactPolicy(const CompactPolicy& other);
+        ~CompactPolicy();
+
+        void save(std::string fname);
+        static CompactPolicy* load(std::string fname);
+
+        // Like `load`, but map the file read-only instead of reading
+        // it: pages are shared between processes serving the
+        // same file, and past the (checked) action runs, only
+        // the pages lookups touch are read.
+        static CompactPolicy* map(std::string fname);
+
+        // Random access by state. Returns false if the
+        // state is missing; block_size = 0 means the trial ends.
+        bool lookup(const ContingencyTable& ct, int& block_size, int& a_allocation) const;
+
+        // ... and by level and rank
+        bool lookup_rank(int level, int64_t rank, int& block_size, int& a_allocation) const;
+
+        // A result attribute (NaN if missing, or if values were dropped)
+        float value(const ContingencyTable& ct, int attr_idx) const;
+
+        // Decode the whole design (e.g., for simulation)
+        TrialMDPTable* to_table() const;
+
+        int get_n_levels() const { return levels.size(); }
+        int get_level_size(int level) const { return levels[level].n_total; }
+        std::vector<std::string> get_attr_names() const { return attr_names; }
+        size_t size_bytes() const { return n_bytes; }
+};
+
+// Little-endian encoding (also used by the policy server)
+void put_u32(std::vector<unsigned char>& buf, uint32_t x);
+uint32_t get_u32(const unsigned char* p);
+
+// Read a design saved either as a SQLite database
+// or in the compact format (recognized by its magic bytes)
+TrialMDPTable* load_policy_table(std::string fname);
+
+#endif
@@ -1,94 +1,90 @@
 // contingency_iterator.h
 // (c) 2020-08 David Merrell
 //
-// Definition of two classes:
-// 
-//   * SimplexIterator
-//     - class that iterates all nonnegative integer vectors
-//       constrained s.t. they sum to a given number, `total`.
-// 
-//   * ContingencyIterator
-//     - A thin wrapper around SimplexIterator, which iterates
-//       all possible contingency tables of a given size.
-//     - I.e., we iterate all 2x2 contingency tables with N patients
-//       by using the 4D SimplexIterator with `total`=N.
+// Definition of ContingencyIterator, which iterates
+// all possible contingency tables of a given size N
+// (i.e., all nonnegative integer 4-vectors summing to N).
+//
+// The tables come in rank order (see table_rank), the order
+// of dense tables and compact designs, so traversals read
+// memory linearly. An iterator can start at any rank and 
+// cover any half-open range of ranks, so a level can be 
+// split among workers. It holds only the current table:
+// no allocation.
 //
 
 #ifndef _CONT_ITER_H
 #define _CONT_ITER_H
 
 #include "contingency_table.h"
-#include <vector>
-
-class SimplexIterator {
-
-    private:
-	// private data
-	int dim;
-	int total;
-	SimplexIterator* sub_state;
-
-	// private methods
-	void increment_total(){ total++; cur_value[0]++; }
-	void restart();
-        void reset_totals();	
-
-    public:
-	// public data member
-	int* cur_value;
-
-        // constructors
-	SimplexIterator();
-	SimplexIterator(int, int, int*);
-
-	// copy constructor
-        SimplexIterator(const SimplexIterator& it);
-
-	// Assignment operator
-	SimplexIterator& operator=(SimplexIterator);
-
-	// other public methods
-	void set_sub(SimplexIterator* sub_iter);
-	bool not_finished();
-	void advance();
-	void pretty_print();
-    
-};
-
+#include <stdint.h>
 
 class ContingencyIterator {
 
 	private:
-	    std::vector<SimplexIterator*> state;
-	    std::vector<SimplexIterator*> simplex_iter_factory(int dim, int total, int* memloc);
+	    int n;
+	    int64_t rank;
+	    int64_t rank_end;
+	    ContingencyTable cur;
 
 	public:
 
+	    ContingencyIterator(){
+	        n = 0;
+	        rank = 0;
+	        rank_end = 0;
+	    }
+
+	    // Every table of this size
 	    ContingencyIterator(int size){
-		int* cur_value = new int [4];
-	        state = this->simplex_iter_factory(4, size, cur_value); 
+	        n = size;
+	        rank_end = n_tables(size);
+	        seek(0);
 	    }
+
+	    // The tables with ranks in [rank_lo, rank_hi)
+	    ContingencyIterator(int size, int64_t rank_lo, int64_t rank_hi){
+	        n = size;
+	        rank_end = rank_hi;
+	        seek(rank_lo);
+	    }
+
+	    // Whether the current table is in the range
+	    bool in_range(){ return rank < rank_end; }
+
+	    // Whether there are tables after the current one
+	    bool not_finished(){ return rank + 1 < rank_end; }
 	    
-	    bool not_finished(){ return state[0]->not_finished(); }
-	    
-	    ContingencyTable value(){ 
-		    ContingencyTable result;
-		    result.a0 = state[0]->cur_value[0];  
-		    result.a1 = state[0]->cur_value[1];  
-		    result.b0 = state[0]->cur_value[2];  
-		    result.b1 = state[0]->cur_value[3];  
-		    return result;
+	    ContingencyTable value(){ return cur; }
+	    int64_t get_rank(){ return rank; }
+
+	    // Jump to a rank (in constant time)
+	    void seek(int64_t new_rank){
+	        rank = new_rank;
+	        if(rank < n_tables(n)){
+	            cur = table_unrank(n, rank);
+	        }
 	    }
-	    void advance(){ state[0]->advance(); }
 
-	    ~ContingencyIterator(){
-                delete state[0]->cur_value;
-	        for(unsigned int i=0; i<state.size(); i++){
-                    delete state[i];
+	    // The next table in rank order: increment b0 (taking
+	    // from b1); once b1 runs out, a1; then a0
+	    void advance(){
+	        rank++;
+	        if(cur.b1 > 0){
+	            cur.b0++;
+	            cur.b1--;
+	        }else if(cur.b0 > 0){
+	            cur.a1++;
+	            cur.b1 = cur.b0 - 1;
+	            cur.b0 = 0;
+	        }else{
+	            cur.a0++;
+	            cur.b1 = cur.a1 - 1;
+	            cur.a1 = 0;
 	        }
 	    }
 
-	    void pretty_print();
+	    void pretty_print(){ cur.pretty_print(); }
 };
 
 #endif
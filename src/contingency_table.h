@@ -2,12 +2,22 @@
 // (c) 2020-08 David Merrell
 //
 // A simple struct definition for 2x2 contingency tables.
+//
+// Each count is stored in 16 bits, so trials (and any table's
+// total) are limited to CT_MAX_COUNT patients. Check counts
+// from outside the solver with ct_counts_fit before building
+// a table from them: the constructor doesn't.
 
 #ifndef _CONT_TABLE_H
 #define _CONT_TABLE_H
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+
+#define CT_MAX_COUNT 65535
 
 struct ContingencyTable {
     short unsigned int a0;
@@ -41,6 +51,16 @@ struct ContingencyTable {
 	std::cout << b0 << "\t" << b1 << std::endl;
     }
 
+    // The four counts packed into one 64-bit key (16 bits each)
+    uint64_t key() const {
+        return (uint64_t(a0) << 48) | (uint64_t(a1) << 32) | (uint64_t(b0) << 16) | uint64_t(b1);
+    }
+
+    static ContingencyTable from_key(uint64_t key){
+        return ContingencyTable((key >> 48) & 0xFFFF, (key >> 32) & 0xFFFF,
+                                (key >> 16) & 0xFFFF, key & 0xFFFF);
+    }
+
     bool operator==(const ContingencyTable& other) const {
 	return (a0 == other.a0) && (a1 == other.a1) && (b0 == other.b0) && (b1 == other.b1);
     }
@@ -57,17 +77,82 @@ struct ContingencyTable {
 
 
 
-struct CTHash {
+// Whether these counts make a valid table (nonnegative,
+// and at most CT_MAX_COUNT patients in all)
+inline bool ct_counts_fit(int64_t a0, int64_t a1, int64_t b0, int64_t b1){
+    return a0 >= 0 && a1 >= 0 && b0 >= 0 && b1 >= 0
+           && a0 + a1 + b0 + b1 <= CT_MAX_COUNT;
+}
 
-    int N = 1000;
-    int N2 = 1000000;
-    int N3 = 1000000000;
+// Throws if a trial of n_patients can't be represented
+inline void check_trial_size(int64_t n_patients, std::string caller){
+    if(n_patients < 0 || n_patients > CT_MAX_COUNT){
+        std::cerr << "`" << caller << "`: n_patients must be between 0 and "
+                  << CT_MAX_COUNT << "." << std::endl;
+        throw 1;
+    }
+}
+
+
+// Hash of the packed key (mixed, so that nearby
+// tables land in unrelated buckets)
+struct CTHash {
 
     std::size_t operator()(const ContingencyTable& t) const{
-        return t.a0*N3 + t.a1*N2 + t.b0*N + t.b0;
+        uint64_t k = t.key();
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        return std::size_t(k);
     }
 
 };
 
+
+// Tables of n patients are ranked 0, ..., C(n+3,3) - 1
+// in lexicographic order of (a0, a1, b0). (In 64 bits:
+// C(n+3,3) exceeds 2^31 from n = 2343.)
+inline int64_t n_tables(int64_t n){
+    return (n+1)*(n+2)*(n+3)/6;
+}
+
+inline int64_t table_rank(const ContingencyTable& t){
+    int64_t n = int64_t(t.a0) + t.a1 + t.b0 + t.b1;
+    int64_t m = n - t.a0;
+    int64_t m2 = m - t.a1;
+    return (n_tables(n) - n_tables(m)) 
+           + ((m+1)*(m+2)/2 - (m2+1)*(m2+2)/2)
+           + t.b0;
+}
+
+// The smallest m >= 0 with n_tables(m) >= count
+// (estimated with a cube root, then corrected)
+inline int64_t n_tables_root(int64_t count){
+    int64_t m = std::max(int64_t(std::cbrt(6.0*count)) - 3, int64_t(0));
+    while(n_tables(m) < count){ m++; }
+    while(m > 0 && n_tables(m-1) >= count){ m--; }
+    return m;
+}
+
+// The smallest m >= 0 with (m+1)(m+2)/2 >= count
+inline int64_t n_triangle_root(int64_t count){
+    int64_t m = std::max(int64_t(std::sqrt(2.0*count)) - 3, int64_t(0));
+    while((m+1)*(m+2)/2 < count){ m++; }
+    while(m > 0 && m*(m+1)/2 >= count){ m--; }
+    return m;
+}
+
+// The table of n patients with the given rank (in constant time)
+inline ContingencyTable table_unrank(int64_t n, int64_t rank){
+    // The tables with a0 = n - m are ranked from n_tables(n) - n_tables(m)
+    int64_t m = n_tables_root(n_tables(n) - rank);
+    rank -= n_tables(n) - n_tables(m);
+    // ...and among them, those with a1 = m - m2, from 
+    // tri(m) - tri(m2) (tri(k) = (k+1)(k+2)/2)
+    int64_t m2 = n_triangle_root((m+1)*(m+2)/2 - rank);
+    rank -= (m+1)*(m+2)/2 - (m2+1)*(m2+2)/2;
+    return ContingencyTable(n - m, m - m2, rank, m2 - rank);
+}
+
 #endif
 
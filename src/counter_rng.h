@@ -0,0 +1,85 @@
+// counter_rng.h
+// (c) 2021-03 David Merrell
+//
+// A counter-based random number generator (Philox4x32-10;
+// Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011).
+//
+// Each random draw is a pure function of (key, counter). 
+// We key the generator with the user's seed and give every
+// simulated trial its own counter stream, so the simulation
+// results don't depend on how trials are divided among threads.
+
+#ifndef _COUNTER_RNG_H
+#define _COUNTER_RNG_H
+
+#include <stdint.h>
+
+class CounterRNG{
+
+    private:
+        uint32_t key[2];
+        uint32_t ctr[4];
+        uint32_t out[4];
+        int out_idx;
+
+        static void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo){
+            uint64_t prod = uint64_t(a) * uint64_t(b);
+            hi = uint32_t(prod >> 32);
+            lo = uint32_t(prod);
+        }
+
+        // Ten Philox rounds on the current counter
+        void generate(){
+            uint32_t c[4] = {ctr[0], ctr[1], ctr[2], ctr[3]};
+            uint32_t k[2] = {key[0], key[1]};
+            for(int r = 0; r < 10; ++r){
+                uint32_t hi0, lo0, hi1, lo1;
+                mulhilo(0xD2511F53, c[0], hi0, lo0);
+                mulhilo(0xCD9E8D57, c[2], hi1, lo1);
+                c[0] = hi1 ^ c[1] ^ k[0];
+                c[1] = lo1;
+                c[2] = hi0 ^ c[3] ^ k[1];
+                c[3] = lo0;
+                k[0] += 0x9E3779B9;
+                k[1] += 0xBB67AE85;
+            }
+            for(int i = 0; i < 4; ++i){
+                out[i] = c[i];
+            }
+            out_idx = 0;
+            // the third counter word counts draws within a stream
+            ctr[2]++;
+        }
+
+    public:
+        CounterRNG(uint64_t seed){
+            key[0] = uint32_t(seed);
+            key[1] = uint32_t(seed >> 32);
+            set_stream(0);
+        }
+
+        // Jump to the start of an independent stream
+        void set_stream(uint64_t stream){
+            ctr[0] = uint32_t(stream);
+            ctr[1] = uint32_t(stream >> 32);
+            ctr[2] = 0;
+            ctr[3] = 0;
+            out_idx = 4;
+        }
+
+        uint32_t next_u32(){
+            if(out_idx == 4){
+                generate();
+            }
+            return out[out_idx++];
+        }
+
+        // Uniform double in [0,1)
+        double uniform(){
+            uint64_t hi = next_u32() >> 5;
+            uint64_t lo = next_u32() >> 6;
+            return (hi * 67108864.0 + lo) * (1.0 / 9007199254740992.0);
+        }
+};
+
+#endif
@@ -0,0 +1,84 @@
+// level_bounds.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of LevelBounds class
+
+#include "level_bounds.h"
+#include "contingency_table.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+
+// floor(log2(x)), for x >= 1
+int floor_log2(int x){
+    int k = 0;
+    while((2 << k) <= x){ k++; }
+    return k;
+}
+
+
+void LevelBounds::init_rows(int n_total){
+    n = n_total;
+
+    // Each row holds floor(log2(len))+1 arrays of length len
+    n_a_offset = std::vector<int64_t>(n + 2, 0);
+    row_size = std::vector<int64_t>(n + 1, 0);
+    for(int n_a = 0; n_a <= n; ++n_a){
+        int len = row_len(n_a);
+        row_size[n_a] = int64_t(len) * (floor_log2(len) + 1);
+        n_a_offset[n_a + 1] = n_a_offset[n_a] + (n_a + 1)*row_size[n_a];
+    }
+}
+
+
+int64_t LevelBounds::table_size(int n_total){
+    LevelBounds sizes;
+    sizes.init_rows(n_total);
+    return sizes.n_a_offset[n_total + 1];
+}
+
+
+LevelBounds::LevelBounds(int n_total){
+    init_rows(n_total);
+    owned = std::vector<float>(n_a_offset[n + 1], -std::numeric_limits<float>::infinity());
+    storage = NULL;
+}
+
+
+LevelBounds::LevelBounds(int n_total, float* external){
+    init_rows(n_total);
+    storage = external;
+}
+
+
+void LevelBounds::set(const ContingencyTable& ct, float value){
+    int n_a = ct.a0 + ct.a1;
+    table()[row_offset(n_a, ct.a1) + ct.b1] = value;
+}
+
+
+void LevelBounds::build_rows(int first, int stride){
+    for(int n_a = first; n_a <= n; n_a += stride){
+        int len = row_len(n_a);
+        int n_lev = floor_log2(len) + 1;
+        for(int a1 = 0; a1 <= n_a; ++a1){
+            float* row = &table()[row_offset(n_a, a1)];
+            // row[k*len + j] = max of row[j, ..., j + 2^k - 1]
+            for(int k = 1; k < n_lev; ++k){
+                int half = 1 << (k - 1);
+                for(int j = 0; j + (1 << k) <= len; ++j){
+                    row[int64_t(k)*len + j] = std::max(row[int64_t(k-1)*len + j], row[int64_t(k-1)*len + j + half]);
+                }
+            }
+        }
+    }
+}
+
+
+float LevelBounds::row_max(int n_a, int a1, int b1_lo, int b1_hi) const {
+    int len = row_len(n_a);
+    int k = floor_log2(b1_hi - b1_lo + 1);
+    const float* row = &table()[row_offset(n_a, a1) + int64_t(k)*len];
+    return std::max(row[b1_lo], row[b1_hi - (1 << k) + 1]);
+}
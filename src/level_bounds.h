@@ -0,0 +1,63 @@
+// level_bounds.h
+// (c) 2021-03 David Merrell
+//
+// Range-maximum queries over the solved states of one level.
+//
+// Once we fix the outcome in arm A of a block, the possible
+// successor states form a "row" of the next level: 
+// same a0' and a1', with b1' in [b1, b1 + a_B].
+// LevelBounds returns the largest value stored in such a row,
+// in constant time (each row keeps a sparse table over b1').
+
+#ifndef _LEVEL_BOUNDS_H
+#define _LEVEL_BOUNDS_H
+
+#include "contingency_table.h"
+#include <vector>
+#include <cstdint>
+
+class LevelBounds{
+
+    private:
+        int n;
+        // Where the rows with n_a patients in arm A begin, and 
+        // the size of each of them (row a1 is a1 rows further on)
+        std::vector<int64_t> n_a_offset;
+        std::vector<int64_t> row_size;
+        // The sparse tables: our own, or the caller's (see below)
+        std::vector<float> owned;
+        float* storage;
+
+        int64_t row_offset(int n_a, int a1) const { return n_a_offset[n_a] + a1*row_size[n_a]; }
+        int row_len(int n_a) const { return n - n_a + 1; }
+        void init_rows(int n_total);
+        float* table(){ return (storage != NULL) ? storage : &owned[0]; }
+        const float* table() const { return (storage != NULL) ? storage : &owned[0]; }
+
+    public:
+        LevelBounds(){ n = 0; storage = NULL; }
+        LevelBounds(int n_total);
+
+        // Keep the sparse tables in `external` (table_size(n_total) 
+        // floats; not owned), e.g. in memory shared between processes. 
+        // Copies of these bounds share the tables.
+        LevelBounds(int n_total, float* external);
+        static int64_t table_size(int n_total);
+
+        // Whether the bounds hold a level
+        bool empty() const { return storage == NULL && owned.empty(); }
+
+        // Store the value of a state (call `build` when finished)
+        void set(const ContingencyTable& ct, float value);
+        void build(){ build_rows(0, 1); }
+
+        // Build only the rows with n_a = first, first + stride, ...
+        // patients in arm A (so that processes can share the work)
+        void build_rows(int first, int stride);
+
+        // Max over states with a0 + a1 = n_a, the given a1,
+        // and b1 in [b1_lo, b1_hi]
+        float row_max(int n_a, int a1, int b1_lo, int b1_hi) const;
+};
+
+#endif
@@ -10,6 +10,18 @@
 // q_i = E[ f(s, a, s') ]
 //
 // A LookaheadRule defines that function, f.
+//
+// Every rule here has the form f = next.values[i] + g(s, a, s'),
+// and `increment_bounds` bounds E[g] for an action, given the
+// expected number of successes in each arm. The solver uses 
+// these to bound an action's expected value before evaluating it.
+// `increment_range` bounds g itself, over every possible outcome.
+//
+// For a given action, f must depend on the current state and the
+// outcome only through the next state s' (as every rule here does:
+// ScaledCMH's increment uses s' counts). The factored backup
+// (TrialMDP::set_backup_order) evaluates f once per s', from any
+// state and outcome that lead to it.
 
 
 #ifndef __LOOKAHEAD_RULE_H_
@@ -20,6 +32,7 @@
 #include <vector>
 #include <iostream>
 #include <limits>
+#include <algorithm>
 
 /**
 *  Abstract base class
@@ -34,6 +47,24 @@ class LookaheadRule{
                                 StateResult& next,
                                 int idx) = 0;
 
+        // Store bounds on the expected difference between this
+        // attribute and its value in the next state. mean_n_a and
+        // mean_n_b are the expected numbers of successes.
+        virtual void increment_bounds(std::vector<float>& lo,
+                                      std::vector<float>& hi,
+                                      ContingencyTable& current_state,
+                                      int action_a, int action_b,
+                                      float mean_n_a, float mean_n_b,
+                                      int idx) = 0;
+
+        // Store bounds on the difference itself, over
+        // every possible outcome of the action
+        virtual void increment_range(std::vector<float>& lo,
+                                     std::vector<float>& hi,
+                                     ContingencyTable& current_state,
+                                     int action_a, int action_b,
+                                     int idx) = 0;
+
 };
 
 
@@ -53,6 +84,25 @@ class IdentityLR : public LookaheadRule{
             current_values[idx] = next.values[idx];
         }
 
+        void increment_bounds(std::vector<float>& lo,
+                              std::vector<float>& hi,
+                              ContingencyTable& current_state,
+                              int action_a, int action_b,
+                              float mean_n_a, float mean_n_b,
+                              int idx){
+            lo[idx] = 0.0;
+            hi[idx] = 0.0;
+        }
+
+        void increment_range(std::vector<float>& lo,
+                             std::vector<float>& hi,
+                             ContingencyTable& current_state,
+                             int action_a, int action_b,
+                             int idx){
+            lo[idx] = 0.0;
+            hi[idx] = 0.0;
+        }
+
 };
 
 
@@ -86,6 +136,25 @@ class AddConstLR : public LookaheadRule{
             current_values[idx] = next.values[idx] + a;
         }
 
+        void increment_bounds(std::vector<float>& lo,
+                              std::vector<float>& hi,
+                              ContingencyTable& current_state,
+                              int action_a, int action_b,
+                              float mean_n_a, float mean_n_b,
+                              int idx){
+            lo[idx] = a;
+            hi[idx] = a;
+        }
+
+        void increment_range(std::vector<float>& lo,
+                             std::vector<float>& hi,
+                             ContingencyTable& current_state,
+                             int action_a, int action_b,
+                             int idx){
+            lo[idx] = a;
+            hi[idx] = a;
+        }
+
 };
 
 
@@ -165,6 +234,78 @@ class ScaledCMH : public LookaheadRule{
                 throw 1;
             }
         }
+
+        // The increment is N_inv * w * f(P), where f(P) = 1/(P(1-P))
+        // is convex and P = (p_a + p_b)/2 is linear in the outcome. 
+        // So E[f(P)] lies between f(E[P]) (Jensen) and the chord
+        // of f between the extreme outcomes (0,0) and (action_a, action_b).
+        void increment_bounds(std::vector<float>& lo,
+                              std::vector<float>& hi,
+                              ContingencyTable& current_state,
+                              int action_a, int action_b,
+                              float mean_n_a, float mean_n_b,
+                              int idx){
+
+            if (action_a == 0 || action_b == 0){
+                lo[idx] = -std::numeric_limits<float>::infinity();
+                hi[idx] = -std::numeric_limits<float>::infinity();
+                return;
+            }
+
+            float T = action_a + action_b;
+            float w = action_a*action_b / T;
+
+            float a_denom = float(current_state.a1 + current_state.a0 + action_a + 2.0);
+            float b_denom = float(current_state.b1 + current_state.b0 + action_b + 2.0);
+            float P_lo = 0.5*(float(current_state.a1 + 1) / a_denom
+                              + float(current_state.b1 + 1) / b_denom);
+            float P_hi = 0.5*(float(current_state.a1 + action_a + 1) / a_denom
+                              + float(current_state.b1 + action_b + 1) / b_denom);
+            float P_mean = 0.5*((current_state.a1 + mean_n_a + 1) / a_denom
+                                + (current_state.b1 + mean_n_b + 1) / b_denom);
+
+            float f_lo = 1.0 / (P_lo*(1.0 - P_lo));
+            float f_hi = 1.0 / (P_hi*(1.0 - P_hi));
+            float f_chord = f_lo;
+            if (P_hi > P_lo){
+                f_chord = f_lo + (f_hi - f_lo)*(P_mean - P_lo)/(P_hi - P_lo);
+            }
+
+            lo[idx] = N_inv * w / (P_mean*(1.0 - P_mean));
+            hi[idx] = N_inv * w * f_chord;
+        }
+
+        // Over the outcomes, P ranges over [P_lo, P_hi]; f is 
+        // largest at an endpoint, and smallest nearest P = 0.5.
+        void increment_range(std::vector<float>& lo,
+                             std::vector<float>& hi,
+                             ContingencyTable& current_state,
+                             int action_a, int action_b,
+                             int idx){
+
+            if (action_a == 0 || action_b == 0){
+                lo[idx] = -std::numeric_limits<float>::infinity();
+                hi[idx] = -std::numeric_limits<float>::infinity();
+                return;
+            }
+
+            float T = action_a + action_b;
+            float w = action_a*action_b / T;
+
+            float a_denom = float(current_state.a1 + current_state.a0 + action_a + 2.0);
+            float b_denom = float(current_state.b1 + current_state.b0 + action_b + 2.0);
+            float P_lo = 0.5*(float(current_state.a1 + 1) / a_denom
+                              + float(current_state.b1 + 1) / b_denom);
+            float P_hi = 0.5*(float(current_state.a1 + action_a + 1) / a_denom
+                              + float(current_state.b1 + action_b + 1) / b_denom);
+            float P_min = std::min(std::max(0.5f, P_lo), P_hi);
+
+            float f_lo = 1.0 / (P_lo*(1.0 - P_lo));
+            float f_hi = 1.0 / (P_hi*(1.0 - P_hi));
+
+            lo[idx] = N_inv * w / (P_min*(1.0 - P_min));
+            hi[idx] = N_inv * w * std::max(f_lo, f_hi);
+        }
 };
 
 
@@ -211,6 +352,48 @@ class LinCombLR : public LookaheadRule {
             current_values[idx] = current_values[a_idx]*a + current_values[b_idx]*b + current_values[c_idx]*c;
         }
 
+        // (Assumes the combined attributes' bounds are already computed)
+        void increment_bounds(std::vector<float>& lo,
+                              std::vector<float>& hi,
+                              ContingencyTable& current_state,
+                              int action_a, int action_b,
+                              float mean_n_a, float mean_n_b,
+                              int idx){
+            lo[idx] = 0.0;
+            hi[idx] = 0.0;
+            add_scaled_bounds(lo, hi, a_idx, a, idx);
+            add_scaled_bounds(lo, hi, b_idx, b, idx);
+            add_scaled_bounds(lo, hi, c_idx, c, idx);
+        }
+
+        // (Assumes the combined attributes' ranges are already computed)
+        void increment_range(std::vector<float>& lo,
+                             std::vector<float>& hi,
+                             ContingencyTable& current_state,
+                             int action_a, int action_b,
+                             int idx){
+            lo[idx] = 0.0;
+            hi[idx] = 0.0;
+            add_scaled_bounds(lo, hi, a_idx, a, idx);
+            add_scaled_bounds(lo, hi, b_idx, b, idx);
+            add_scaled_bounds(lo, hi, c_idx, c, idx);
+        }
+
+    private:
+        void add_scaled_bounds(std::vector<float>& lo, std::vector<float>& hi,
+                               int src_idx, float coeff, int idx){
+            if(coeff == 0.0){
+                return;
+            }
+            if(coeff > 0.0){
+                lo[idx] += coeff*lo[src_idx];
+                hi[idx] += coeff*hi[src_idx];
+            }else{
+                lo[idx] += coeff*hi[src_idx];
+                hi[idx] += coeff*lo[src_idx];
+            }
+        }
+
         
 
 };
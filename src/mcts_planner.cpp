@@ -0,0 +1,456 @@
+// mcts_planner.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the MCTSPlanner class.
+
+#include "mcts_planner.h"
+#include "trial_mdp_table.h"
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <exception>
+
+
+MCTSPlanner::MCTSPlanner(int n_patients, float failure_cost, float block_cost,
+                         int min_size, int block_incr,
+                         float prior_a0, float prior_a1,
+                         float prior_b0, float prior_b1,
+                         std::string transition_dist,
+                         std::string test_statistic,
+                         float act_l, float act_u, int act_n){
+
+    check_trial_size(n_patients, "MCTSPlanner");
+    this->n_patients = n_patients;
+    this->min_size = min_size;
+    this->failure_cost = failure_cost;
+    this->block_cost = block_cost;
+    this->prior_a0 = prior_a0;
+    this->prior_a1 = prior_a1;
+    this->prior_b0 = prior_b0;
+    this->prior_b1 = prior_b1;
+    this->tr_dist = transition_dist;
+    this->test_statistic = test_statistic;
+    this->act_l = act_l;
+    this->act_u = act_u;
+    this->act_n = act_n;
+
+    n_attr = ResultInterpreter(test_statistic, failure_cost, block_cost, n_patients).get_n_attr();
+
+    n_vec = build_n_vec(n_patients, min_size, block_incr);
+    ActionIterator action_iterator = ActionIterator(act_l, act_u, act_n, n_vec, min_size, 0);
+    level_actions = std::vector< std::vector<BlockAction> >(n_vec.size());
+    for(unsigned int idx = 0; idx + 1 < n_vec.size(); ++idx){
+        level_actions[idx] = usable_actions(action_iterator.all_actions(idx));
+    }
+    // (stages that end the trial, by increasing allocation to A)
+    final_actions = std::vector< std::vector<int> >(n_vec.size());
+    for(unsigned int idx = 0; idx + 1 < n_vec.size(); ++idx){
+        for(unsigned int k = 0; k < level_actions[idx].size(); ++k){
+            if(level_actions[idx][k].next_size_idx == int(n_vec.size()) - 1){
+                final_actions[idx].push_back(k);
+            }
+        }
+        std::sort(final_actions[idx].begin(), final_actions[idx].end(),
+                  [&](int j, int k){ return level_actions[idx][j].a_A < level_actions[idx][k].a_A; });
+    }
+
+    exploration = 0.1;
+    reward_lo = 0.0;
+    reward_hi = 0.0;
+    have_rewards = false;
+    n_iterations = 0;
+    max_iterations = 0;
+    has_deadline = false;
+}
+
+
+// Stages that put nobody in one of the arms make the test
+// statistic undefined (-Infinity); a single such sample would
+// swamp every average above it. Drop them, unless there's
+// nothing else to choose.
+std::vector<BlockAction> MCTSPlanner::usable_actions(std::vector<BlockAction> actions){
+    std::vector<BlockAction> usable;
+    for(unsigned int k = 0; k < actions.size(); ++k){
+        if(actions[k].a_A > 0 && actions[k].a_B > 0){
+            usable.push_back(actions[k]);
+        }
+    }
+    if(usable.empty()){
+        return actions;
+    }
+    return usable;
+}
+
+
+// The default policy ends the trial in one stage, giving the arm
+// that looks better (by posterior mean) the largest share the grid
+// allows. (Uniformly random stages pay so many block costs that
+// every multistage plan looks bad; balanced ones ignore what the
+// trial has learned.)
+BlockAction& MCTSPlanner::default_action(int level_idx, ContingencyTable& ct){
+
+    std::vector<int>& finals = final_actions[level_idx];
+    std::vector<BlockAction>& actions = level_actions[level_idx];
+    if(finals.empty()){
+        // (no stage reaches the end; take the largest)
+        int largest = 0;
+        for(unsigned int k = 1; k < actions.size(); ++k){
+            if(actions[k].block_size > actions[largest].block_size){ largest = k; }
+        }
+        return actions[largest];
+    }
+
+    float p_a = (ct.a1 + prior_a1) / (ct.a0 + ct.a1 + prior_a0 + prior_a1);
+    float p_b = (ct.b1 + prior_b1) / (ct.b0 + ct.b1 + prior_b0 + prior_b1);
+    if(p_a > p_b){
+        return actions[finals.back()];
+    }else if(p_a < p_b){
+        return actions[finals.front()];
+    }
+    return actions[finals[finals.size()/2]];
+}
+
+
+// The stages available from the root (as in TrialMDP::solve_from,
+// its size needn't be one of the design's levels)
+std::vector<BlockAction> MCTSPlanner::root_actions(ContingencyTable ct){
+
+    int n_total = ct.a0 + ct.a1 + ct.b0 + ct.b1;
+    if(n_total >= n_vec.back()){
+        std::cerr << "MCTSPlanner: the table already has " << n_total
+                  << " patients; the trial is over." << std::endl;
+        throw 1;
+    }
+
+    std::vector<int>::iterator level = std::lower_bound(n_vec.begin(), n_vec.end(), n_total);
+    if(*level == n_total){
+        return level_actions[level - n_vec.begin()];
+    }
+
+    int first_later = int(level - n_vec.begin());
+    std::vector<int> sub_vec = std::vector<int>(1, n_total);
+    sub_vec.insert(sub_vec.end(), level, n_vec.end());
+    int root_min = std::min(min_size, n_vec.back() - n_total);
+
+    ActionIterator root_iterator = ActionIterator(act_l, act_u, act_n, sub_vec, root_min, 0);
+    std::vector<BlockAction> actions = usable_actions(root_iterator.all_actions(0));
+    for(unsigned int k = 0; k < actions.size(); ++k){
+        actions[k].next_size_idx += first_later - 1;
+    }
+    return actions;
+}
+
+
+int MCTSPlanner::add_node(ContingencyTable ct, int level_idx){
+    Node node;
+    node.ct = ct;
+    node.level_idx = level_idx;
+    node.visits = 0;
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+
+// Most tables are reached only once (and then finished by the
+// default policy), so we only give a node its edges when
+// the search comes back to it
+void MCTSPlanner::expand(int node_idx){
+    Node& node = nodes[node_idx];
+    std::vector<BlockAction>& actions = (node_idx == 0) ? root_action_list : level_actions[node.level_idx];
+    node.edges = std::vector<Edge>(actions.size());
+    for(unsigned int k = 0; k < actions.size(); ++k){
+        node.edges[k].action = actions[k];
+        node.edges[k].visits = 0;
+        node.edges[k].virtual_loss = 0;
+        node.edges[k].total = 0.0;
+        node.edges[k].total_sq = 0.0;
+    }
+}
+
+
+// UCB1: try every stage once, then maximize mean + bonus.
+// Each virtual loss counts as a visit with the worst reward seen.
+int MCTSPlanner::select_edge(Node& node){
+
+    for(unsigned int k = 0; k < node.edges.size(); ++k){
+        if(node.edges[k].visits == 0 && node.edges[k].virtual_loss == 0){
+            return k;
+        }
+    }
+
+    double scale = (reward_hi > reward_lo) ? (reward_hi - reward_lo) : 1.0;
+    long pending = 0;
+    for(unsigned int k = 0; k < node.edges.size(); ++k){
+        pending += node.edges[k].virtual_loss;
+    }
+    double log_n = std::log(double(node.visits + pending) + 1.0);
+
+    int best = 0;
+    double best_score = -std::numeric_limits<double>::infinity();
+    for(unsigned int k = 0; k < node.edges.size(); ++k){
+        Edge& e = node.edges[k];
+        double n = double(e.visits + e.virtual_loss);
+        double mean = (e.total + e.virtual_loss*reward_lo) / n;
+        double score = mean + exploration * scale * std::sqrt(log_n / n);
+        if(score > best_score){
+            best_score = score;
+            best = k;
+        }
+    }
+    return best;
+}
+
+
+// Outcomes in the two arms are independent
+// (see TransitionDist::prob); invert each arm's CDF
+void MCTSPlanner::sample_outcome(TransitionDist* dist, CounterRNG& rng,
+                                 ContingencyTable& ct, BlockAction& action,
+                                 int& n_A, int& n_B){
+
+    dist->set_state_action(ct, action.a_A, action.a_B);
+
+    float a_total = 0.0;
+    for(int a = dist->a_lower(); a <= dist->a_upper(); ++a){
+        a_total += dist->a_prob(a);
+    }
+    float u = rng.uniform() * a_total;
+    n_A = dist->a_upper();
+    for(int a = dist->a_lower(); a < dist->a_upper(); ++a){
+        u -= dist->a_prob(a);
+        if(u < 0.0){ n_A = a; break; }
+    }
+
+    float b_total = 0.0;
+    for(int b = dist->b_lower(); b <= dist->b_upper(); ++b){
+        b_total += dist->b_prob(b);
+    }
+    u = rng.uniform() * b_total;
+    n_B = dist->b_upper();
+    for(int b = dist->b_lower(); b < dist->b_upper(); ++b){
+        u -= dist->b_prob(b);
+        if(u < 0.0){ n_B = b; break; }
+    }
+}
+
+
+void MCTSPlanner::iterate(CounterRNG& rng, TransitionDist* dist, TerminalRule* terminal_rule,
+                          ResultInterpreter& interp, std::vector<Step>& path){
+
+    int last_idx = n_vec.size() - 1;
+    path.clear();
+
+    // Walk down the tree until we add a node (or reach the end)
+    int cur = 0;
+    std::unique_lock<std::mutex> lock(tree_mutex);
+    while(nodes[cur].level_idx != last_idx){
+        if(nodes[cur].edges.empty()){
+            expand(cur);
+        }
+        Step step;
+        step.node = cur;
+        step.edge = select_edge(nodes[cur]);
+        step.ct = nodes[cur].ct;
+        step.action = nodes[cur].edges[step.edge].action;
+        nodes[cur].edges[step.edge].virtual_loss++;
+
+        lock.unlock();
+        sample_outcome(dist, rng, step.ct, step.action, step.n_A, step.n_B);
+        lock.lock();
+        path.push_back(step);
+
+        int key = step.n_A*(step.action.a_B + 1) + step.n_B;
+        std::unordered_map<int, int>::iterator child = nodes[cur].edges[step.edge].children.find(key);
+        if(child != nodes[cur].edges[step.edge].children.end()){
+            cur = child->second;
+            continue;
+        }
+
+        ContingencyTable next_ct = ContingencyTable(step.ct.a0 + step.action.a_A - step.n_A,
+                                                    step.ct.a1 + step.n_A,
+                                                    step.ct.b0 + step.action.a_B - step.n_B,
+                                                    step.ct.b1 + step.n_B);
+        int next_idx = step.action.next_size_idx;
+        int added = add_node(next_ct, next_idx);
+        nodes[cur].edges[step.edge].children[key] = added;
+        cur = added;
+        break;
+    }
+    ContingencyTable ct = nodes[cur].ct;
+    int level_idx = nodes[cur].level_idx;
+    lock.unlock();
+
+    // Finish the trial with the default policy
+    while(level_idx != last_idx){
+        Step step;
+        step.node = -1;
+        step.edge = -1;
+        step.ct = ct;
+        step.action = default_action(level_idx, ct);
+        sample_outcome(dist, rng, step.ct, step.action, step.n_A, step.n_B);
+        path.push_back(step);
+
+        ct = ContingencyTable(ct.a0 + step.action.a_A - step.n_A,
+                              ct.a1 + step.n_A,
+                              ct.b0 + step.action.a_B - step.n_B,
+                              ct.b1 + step.n_B);
+        level_idx = step.action.next_size_idx;
+    }
+
+    // Carry the terminal score back up the path
+    StateResult result = (*terminal_rule)(interp, ct);
+    std::vector<double> returns = std::vector<double>(path.size());
+    for(int k = int(path.size()) - 1; k >= 0; --k){
+        Step& step = path[k];
+        interp.compute_lookaheads(step.ct, step.action.a_A, step.action.a_B,
+                                  step.n_A, step.n_B, result);
+        for(int i = 0; i < n_attr; ++i){
+            result.values[i] = interp.look_ahead(i);
+        }
+        returns[k] = result.values[n_attr - 1];
+    }
+
+    lock.lock();
+    for(unsigned int k = 0; k < path.size() && path[k].node >= 0; ++k){
+        Edge& e = nodes[path[k].node].edges[path[k].edge];
+        e.visits++;
+        e.virtual_loss--;
+        e.total += returns[k];
+        e.total_sq += returns[k]*returns[k];
+        nodes[path[k].node].visits++;
+
+        if(!have_rewards){
+            reward_lo = returns[k];
+            reward_hi = returns[k];
+            have_rewards = true;
+        }
+        reward_lo = std::min(reward_lo, returns[k]);
+        reward_hi = std::max(reward_hi, returns[k]);
+    }
+}
+
+
+void MCTSPlanner::search_batch(uint64_t seed, int thread_idx, std::exception_ptr* error){
+
+    CounterRNG rng = CounterRNG(seed);
+    rng.set_stream(thread_idx);
+
+    // Exceptions can't leave a worker thread (std::terminate);
+    // hand them back to the calling thread instead.
+    // Each thread gets its own (stateful) distribution and rules.
+    TransitionDist* dist = NULL;
+    TerminalRule* terminal_rule = NULL;
+    try{
+        dist = TransitionDist::make_transition_dist(tr_dist,
+                                                    prior_a0, prior_a1,
+                                                    prior_b0, prior_b1);
+        terminal_rule = TerminalRule::make_terminal_rule(test_statistic, failure_cost);
+        ResultInterpreter interp = ResultInterpreter(test_statistic, failure_cost, block_cost, n_patients);
+        std::vector<Step> path;
+
+        while(true){
+            if(max_iterations > 0){
+                if(n_iterations.fetch_add(1) >= max_iterations){ break; }
+            }
+            if(has_deadline && std::chrono::steady_clock::now() >= deadline){ break; }
+            iterate(rng, dist, terminal_rule, interp, path);
+        }
+    }
+    catch(...){
+        *error = std::current_exception();
+    }
+
+    delete dist;
+    delete terminal_rule;
+}
+
+
+MCTSResult MCTSPlanner::plan(ContingencyTable ct, double seconds,
+                             int n_threads, uint64_t seed, long max_iter){
+
+    if(seconds <= 0.0 && max_iter <= 0){
+        std::cerr << "MCTSPlanner: need a time budget or an iteration cap." << std::endl;
+        throw 1;
+    }
+    if(n_threads < 1){
+        n_threads = std::thread::hardware_concurrency();
+        if(n_threads < 1){ n_threads = 1; }
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    nodes.clear();
+    root_action_list = root_actions(ct);
+    int n_total = ct.a0 + ct.a1 + ct.b0 + ct.b1;
+    // (-1: the root isn't on any level)
+    int root_level = std::find(n_vec.begin(), n_vec.end(), n_total) - n_vec.begin();
+    add_node(ct, (root_level < int(n_vec.size())) ? root_level : -1);
+    expand(0);
+
+    reward_lo = 0.0;
+    reward_hi = 0.0;
+    have_rewards = false;
+    n_iterations = 0;
+    max_iterations = max_iter;
+    has_deadline = (seconds > 0.0);
+    deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(seconds));
+
+    std::vector<std::exception_ptr> errors = std::vector<std::exception_ptr>(n_threads);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < n_threads; ++t){
+        workers.push_back(std::thread(&MCTSPlanner::search_batch, this,
+                                      seed, t, &errors[t]));
+    }
+    for(unsigned int t = 0; t < workers.size(); ++t){
+        workers[t].join();
+    }
+    for(int t = 0; t < n_threads; ++t){
+        if(errors[t]){ std::rethrow_exception(errors[t]); }
+    }
+
+    MCTSResult result;
+    result.n_iterations = nodes[0].visits;
+    result.n_nodes = nodes.size();
+    result.n_threads = n_threads;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Recommend the most visited stage (ties: the higher mean)
+    int best = -1;
+    for(unsigned int k = 0; k < nodes[0].edges.size(); ++k){
+        Edge& e = nodes[0].edges[k];
+        MCTSActionStats stats;
+        stats.block_size = e.action.block_size;
+        stats.a_allocation = e.action.a_A;
+        stats.visits = e.visits;
+        stats.mean_reward = std::numeric_limits<double>::quiet_NaN();
+        stats.std_err = std::numeric_limits<double>::quiet_NaN();
+        if(e.visits > 0){
+            stats.mean_reward = e.total / e.visits;
+        }
+        if(e.visits > 1){
+            double var = (e.total_sq - e.visits*stats.mean_reward*stats.mean_reward) / (e.visits - 1);
+            stats.std_err = std::sqrt(std::max(var, 0.0) / e.visits);
+        }
+        result.actions.push_back(stats);
+
+        if(e.visits > 0 && (best < 0 || e.visits > result.actions[best].visits
+                            || (e.visits == result.actions[best].visits
+                                && stats.mean_reward > result.actions[best].mean_reward))){
+            best = k;
+        }
+    }
+
+    result.block_size = 0;
+    result.a_allocation = 0;
+    result.mean_reward = std::numeric_limits<double>::quiet_NaN();
+    result.std_err = std::numeric_limits<double>::quiet_NaN();
+    if(best >= 0){
+        result.block_size = result.actions[best].block_size;
+        result.a_allocation = result.actions[best].a_allocation;
+        result.mean_reward = result.actions[best].mean_reward;
+        result.std_err = result.actions[best].std_err;
+    }
+    return result;
+}
@@ -0,0 +1,175 @@
+// mcts_planner.h
+// (c) 2021-03 David Merrell
+//
+// An anytime planner for trials too large to solve exactly.
+//
+// Rather than solving every contingency table, we run Monte Carlo
+// tree search (UCT; Kocsis & Szepesvari, 2006) rooted at the current
+// table. Each iteration walks down the tree (choosing stages by an
+// upper confidence bound, and sampling their outcomes from the
+// TransitionDist), adds one table to the tree, and finishes the trial
+// with a default policy (one last stage, favoring the arm that looks
+// better). The TerminalRule scores the final
+// table, and the ResultInterpreter's lookahead rules carry the score
+// back up the path -- so every stage on the path gets a sample of
+// its expected TotalReward, in the same units as TrialMDP's.
+//
+// Several threads search the same tree; a "virtual loss" on the
+// stages each thread is exploring steers the others elsewhere.
+// The search stops at a wall-clock budget (or an iteration cap).
+//
+// Thread t draws from random stream t (see CounterRNG). With one
+// thread and an iteration cap, results are reproducible; otherwise
+// they depend on how the threads interleave.
+
+#ifndef _MCTS_PLANNER_H
+#define _MCTS_PLANNER_H
+
+#include "result_interpreter.h"
+#include "contingency_table.h"
+#include "state_result.h"
+#include "action_iterator.h"
+#include "transition_dist.h"
+#include "terminal_rule.h"
+#include "counter_rng.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <stdint.h>
+
+
+// Search statistics for one of the root's stages
+struct MCTSActionStats{
+    int block_size;
+    int a_allocation;
+    long visits;
+    double mean_reward;
+    double std_err;
+};
+
+
+struct MCTSResult{
+    // The recommended stage (the root's most visited)
+    int block_size;
+    int a_allocation;
+    double mean_reward;
+    double std_err;
+
+    long n_iterations;
+    long n_nodes;
+    int n_threads;
+    double seconds;
+
+    std::vector<MCTSActionStats> actions;
+};
+
+
+class MCTSPlanner{
+
+    private:
+        // A stage from some table in the tree, and the
+        // tables its sampled outcomes have led to
+        struct Edge{
+            BlockAction action;
+            long visits;
+            int virtual_loss;
+            double total;
+            double total_sq;
+            std::unordered_map<int, int> children;
+        };
+
+        struct Node{
+            ContingencyTable ct;
+            int level_idx;
+            long visits;
+            std::vector<Edge> edges;
+        };
+
+        // One step of a sampled trajectory
+        struct Step{
+            int node;
+            int edge;
+            ContingencyTable ct;
+            BlockAction action;
+            int n_A;
+            int n_B;
+        };
+
+        int n_patients;
+        int min_size;
+        float failure_cost;
+        float block_cost;
+        float prior_a0;
+        float prior_a1;
+        float prior_b0;
+        float prior_b1;
+        std::string tr_dist;
+        std::string test_statistic;
+        float act_l;
+        float act_u;
+        int act_n;
+        int n_attr;
+
+        std::vector<int> n_vec;
+        // Each level's stages (without those that
+        // skip an arm; see `usable_actions`)
+        std::vector< std::vector<BlockAction> > level_actions;
+        // Each level's stages that end the trial
+        std::vector< std::vector<int> > final_actions;
+
+        float exploration;
+
+        // The search tree (guarded by tree_mutex)
+        std::deque<Node> nodes;
+        std::vector<BlockAction> root_action_list;
+        std::mutex tree_mutex;
+        double reward_lo;
+        double reward_hi;
+        bool have_rewards;
+
+        std::atomic<long> n_iterations;
+        long max_iterations;
+        bool has_deadline;
+        std::chrono::steady_clock::time_point deadline;
+
+        // Private methods
+        std::vector<BlockAction> usable_actions(std::vector<BlockAction> actions);
+        BlockAction& default_action(int level_idx, ContingencyTable& ct);
+        std::vector<BlockAction> root_actions(ContingencyTable ct);
+        int add_node(ContingencyTable ct, int level_idx);
+        void expand(int node_idx);
+        int select_edge(Node& node);
+        void sample_outcome(TransitionDist* dist, CounterRNG& rng,
+                            ContingencyTable& ct, BlockAction& action,
+                            int& n_A, int& n_B);
+        void iterate(CounterRNG& rng, TransitionDist* dist, TerminalRule* terminal_rule,
+                     ResultInterpreter& interp, std::vector<Step>& path);
+        void search_batch(uint64_t seed, int thread_idx, std::exception_ptr* error);
+
+    public:
+        // (Same problem parameters as TrialMDP)
+        MCTSPlanner(int n_patients, float failure_cost, float block_cost,
+                    int min_size, int block_incr,
+                    float prior_a0, float prior_a1,
+                    float prior_b0, float prior_b1,
+                    std::string transition_dist="beta_binom",
+                    std::string test_statistic="scaled_cmh",
+                    float act_l=0.2, float act_u=0.8, int act_n=7);
+
+        // The UCB exploration constant, relative to the
+        // range of rewards observed so far. (Default: 0.1)
+        void set_exploration(float c){ exploration = c; }
+
+        // Search from `ct` for `seconds` of wall-clock time
+        // (or until `max_iter` iterations, if positive).
+        // n_threads < 1 uses every core.
+        MCTSResult plan(ContingencyTable ct, double seconds,
+                        int n_threads, uint64_t seed, long max_iter=0);
+};
+
+#endif
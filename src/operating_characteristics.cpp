@@ -0,0 +1,102 @@
+// operating_characteristics.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of OperatingCharacteristics class
+
+#include "operating_characteristics.h"
+#include "contingency_table.h"
+#include "trial_mdp_table.h"
+#include "transition_dist.h"
+#include "terminal_rule.h"
+#include "state_result.h"
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+typedef std::unordered_map<ContingencyTable, std::vector<double>, CTHash> MassMap;
+
+
+OperatingCharacteristics::OperatingCharacteristics(TrialMDPTable& policy_table, float crit_value){
+    table = policy_table;
+    critical_value = crit_value;
+}
+
+
+std::vector<OCResult> OperatingCharacteristics::compute(std::vector<float> p_a, std::vector<float> p_b){
+
+    unsigned int n_scen = p_a.size();
+    std::vector<OCResult> results = std::vector<OCResult>(n_scen);
+    std::vector<int> n_vec = table.get_n_vec();
+
+    // One map of probability masses per level;
+    // all of the mass starts at the empty table.
+    // (The extra map holds tables past the last stored level:
+    //  designs saved without their terminal tables end there.)
+    unsigned int end_idx = n_vec.size();
+    std::vector<MassMap> mass = std::vector<MassMap>(n_vec.size() + 1);
+    mass[0][ContingencyTable()] = std::vector<double>(n_scen, 1.0);
+
+    std::vector< std::vector<float> > a_probs = std::vector< std::vector<float> >(n_scen);
+    std::vector< std::vector<float> > b_probs = std::vector< std::vector<float> >(n_scen);
+
+    for(unsigned int idx = 0; idx <= end_idx; ++idx){
+        for(MassMap::iterator it = mass[idx].begin(); it != mass[idx].end(); ++it){
+
+            ContingencyTable ct = it->first;
+            std::vector<double>& m = it->second;
+
+            const StateResult* res = (idx < end_idx) ? table.lookup(idx, ct) : NULL;
+            if(idx < end_idx && res == NULL){
+                std::cerr << "`OperatingCharacteristics`: the policy has no entry for a reachable state." << std::endl;
+                throw 1;
+            }
+
+            // The trial ends here: accumulate the terminal quantities
+            if(idx == end_idx || res->block_size == 0){
+                bool reject = (wald_statistic(ct) > critical_value);
+                for(unsigned int s = 0; s < n_scen; ++s){
+                    if(reject){ results[s].reject_prob += m[s]; }
+                    results[s].expected_n_a += m[s]*(ct.a0 + ct.a1);
+                    results[s].expected_n_b += m[s]*(ct.b0 + ct.b1);
+                    results[s].expected_failures += m[s]*(ct.a0 + ct.b0);
+                }
+                continue;
+            }
+
+            // Otherwise, run the policy's next stage
+            int a_A = res->a_allocation;
+            int a_B = res->block_size - a_A;
+            int n_next = n_vec[idx] + res->block_size;
+            int next_idx = (n_next > n_vec.back()) ? end_idx : table.get_level_idx(n_next);
+            if(next_idx < 0){
+                std::cerr << "`OperatingCharacteristics`: the policy has no level with " << n_next << " patients." << std::endl;
+                throw 1;
+            }
+
+            for(unsigned int s = 0; s < n_scen; ++s){
+                results[s].expected_stages += m[s];
+                a_probs[s] = initialize_binom_probs(a_A, p_a[s]);
+                b_probs[s] = initialize_binom_probs(a_B, p_b[s]);
+            }
+
+            for(int n_A = 0; n_A <= a_A; ++n_A){
+                for(int n_B = 0; n_B <= a_B; ++n_B){
+                    ContingencyTable next = ContingencyTable(ct.a0 + a_A - n_A, ct.a1 + n_A,
+                                                             ct.b0 + a_B - n_B, ct.b1 + n_B);
+                    std::vector<double>& next_m = mass[next_idx][next];
+                    if(next_m.size() == 0){
+                        next_m = std::vector<double>(n_scen, 0.0);
+                    }
+                    for(unsigned int s = 0; s < n_scen; ++s){
+                        next_m[s] += m[s] * a_probs[s][n_A] * b_probs[s][n_B];
+                    }
+                }
+            }
+        }
+        // This level's mass has been pushed forward
+        mass[idx].clear();
+    }
+
+    return results;
+}
+
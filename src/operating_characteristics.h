@@ -0,0 +1,57 @@
+// operating_characteristics.h
+// (c) 2021-03 David Merrell
+//
+// Exact operating characteristics of a solved trial design.
+//
+// Given a solved TrialMDPTable and some "true" response
+// rates (p_A, p_B), we push probability mass forward from
+// the empty contingency table, level by level, following
+// the policy's actions and binomial transitions. At the 
+// terminal states we accumulate exact expectations:
+//   * the probability of rejecting p_A = p_B 
+//     (the Wald/chi-square statistic exceeds a critical value),
+//   * the expected number of patients assigned to A and B,
+//   * the expected number of failures,
+//   * the expected number of stages.
+//
+// A single pass handles a whole grid of (p_A, p_B) scenarios.
+// Setting p_A = p_B gives the type-I error.
+
+#ifndef _OPERATING_CHARACTERISTICS_H
+#define _OPERATING_CHARACTERISTICS_H
+
+#include "contingency_table.h"
+#include "trial_mdp_table.h"
+#include <vector>
+
+struct OCResult{
+    double reject_prob;
+    double expected_n_a;
+    double expected_n_b;
+    double expected_failures;
+    double expected_stages;
+
+    OCResult(){
+        reject_prob = 0.0;
+        expected_n_a = 0.0;
+        expected_n_b = 0.0;
+        expected_failures = 0.0;
+        expected_stages = 0.0;
+    }
+};
+
+
+class OperatingCharacteristics{
+
+    private:
+        TrialMDPTable table;
+        float critical_value;
+
+    public:
+        OperatingCharacteristics(TrialMDPTable& policy_table, float crit_value);
+
+        // One result per scenario (p_a[i], p_b[i])
+        std::vector<OCResult> compute(std::vector<float> p_a, std::vector<float> p_b);
+};
+
+#endif
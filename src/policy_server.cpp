@@ -0,0 +1,535 @@
+// policy_server.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the PolicyServer and PolicyClient classes.
+
+#include "policy_server.h"
+#include "state_result.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <utility>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+
+////////////////////////////////
+// LatencyHistogram
+////////////////////////////////
+
+LatencyHistogram::LatencyHistogram(){
+    counts = std::vector<long>(LATENCY_BUCKETS, 0);
+    total = 0;
+}
+
+
+void LatencyHistogram::record(double nanoseconds){
+    int b = 0;
+    if(nanoseconds > LATENCY_MIN_NS){
+        b = int(std::floor(LATENCY_PER_DOUBLING * std::log2(nanoseconds / LATENCY_MIN_NS)));
+    }
+    if(b >= LATENCY_BUCKETS){
+        b = LATENCY_BUCKETS - 1;
+    }
+    counts[b]++;
+    total++;
+}
+
+
+double LatencyHistogram::quantile(double q) const {
+    if(total == 0){
+        return 0.0;
+    }
+    long target = long(std::ceil(q * total));
+    if(target < 1){
+        target = 1;
+    }
+    long seen = 0;
+    int b = 0;
+    for(; b < LATENCY_BUCKETS - 1; ++b){
+        seen += counts[b];
+        if(seen >= target){
+            break;
+        }
+    }
+    // The bucket's geometric midpoint
+    return LATENCY_MIN_NS * std::pow(2.0, (b + 0.5) / LATENCY_PER_DOUBLING);
+}
+
+
+////////////////////////////////
+// Protocol helpers
+////////////////////////////////
+
+void put_u16(std::vector<unsigned char>& buf, uint32_t x){
+    buf.push_back(x & 0xFF);
+    buf.push_back((x >> 8) & 0xFF);
+}
+
+uint32_t get_u16(const unsigned char* p){
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8);
+}
+
+
+// Send as much of the connection's pending output as
+// the socket takes. Returns false if the connection failed.
+bool PolicyServer::send_pending(Connection& conn){
+    while(conn.out_pos < conn.out.size()){
+        ssize_t k = send(conn.fd, &conn.out[conn.out_pos],
+                         conn.out.size() - conn.out_pos, MSG_NOSIGNAL);
+        if(k < 0 && errno == EINTR){
+            continue;
+        }
+        if(k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            break;
+        }
+        if(k <= 0){
+            return false;
+        }
+        conn.out_pos += k;
+    }
+    if(conn.out_pos == conn.out.size()){
+        conn.out.clear();
+        conn.out_pos = 0;
+    }
+    return true;
+}
+
+
+// Read exactly n bytes (client side)
+void recv_all(int fd, unsigned char* p, size_t n){
+    size_t got = 0;
+    while(got < n){
+        ssize_t k = recv(fd, p + got, n - got, 0);
+        if(k < 0 && errno == EINTR){
+            continue;
+        }
+        if(k <= 0){
+            std::cerr << "`PolicyClient`: the server closed the connection." << std::endl;
+            throw 1;
+        }
+        got += k;
+    }
+}
+
+
+////////////////////////////////
+// PolicyServer
+////////////////////////////////
+
+PolicyServer::PolicyServer(std::string path){
+
+    socket_path = path;
+    stop_requested = false;
+
+    struct sockaddr_un addr;
+    if(socket_path.size() >= sizeof(addr.sun_path)){
+        std::cerr << "`PolicyServer`: socket path too long: " << socket_path << std::endl;
+        throw 1;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    // Replace a stale socket (but nothing else)
+    struct stat st;
+    if(lstat(socket_path.c_str(), &st) == 0){
+        if(!S_ISSOCK(st.st_mode)){
+            std::cerr << "`PolicyServer`: " << socket_path << " exists and is not a socket." << std::endl;
+            throw 1;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listen_fd < 0){
+        std::cerr << "`PolicyServer`: failed to create a socket." << std::endl;
+        throw 1;
+    }
+    if(bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0
+       || listen(listen_fd, 64) != 0){
+        std::cerr << "`PolicyServer`: failed to listen on " << socket_path
+                  << " (" << std::strerror(errno) << ")" << std::endl;
+        close(listen_fd);
+        throw 1;
+    }
+}
+
+
+PolicyServer::~PolicyServer(){
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    for(unsigned int i = 0; i < policies.size(); ++i){
+        delete policies[i].compact;
+        if(policies[i].table != NULL){
+            policies[i].table->release();
+            delete policies[i].table;
+        }
+    }
+}
+
+
+int PolicyServer::add_policy(std::string fname){
+
+    Policy policy;
+    policy.fname = fname;
+    policy.compact = NULL;
+    policy.table = NULL;
+
+    char magic[8] = {0};
+    std::ifstream in(fname.c_str(), std::ios::binary);
+    if(in){
+        in.read(magic, 8);
+    }
+    if(in && std::memcmp(magic, COMPACT_MAGIC, 8) == 0){
+        policy.compact = CompactPolicy::map(fname);
+    }else{
+        policy.table = TrialMDPTable::from_sqlite(fname);
+    }
+
+    CacheEntry empty;
+    empty.valid = false;
+    empty.block_size = 0;
+    empty.a_allocation = 0;
+    policy.cache = std::vector<CacheEntry>(POLICY_CACHE_SIZE, empty);
+    policy.n_requests = 0;
+    policy.n_states = 0;
+    policy.n_hits = 0;
+
+    policies.push_back(policy);
+    return policies.size() - 1;
+}
+
+
+bool PolicyServer::lookup(Policy& policy, const ContingencyTable& ct,
+                          int& block_size, int& a_allocation){
+
+    uint64_t key = uint64_t(ct.a0) | (uint64_t(ct.a1) << 16)
+                   | (uint64_t(ct.b0) << 32) | (uint64_t(ct.b1) << 48);
+    CacheEntry& entry = policy.cache[(key * 0x9E3779B97F4A7C15ull) >> 52];
+    if(entry.valid && entry.ct == ct){
+        policy.n_hits++;
+        block_size = entry.block_size;
+        a_allocation = entry.a_allocation;
+        return block_size >= 0;
+    }
+
+    bool found = false;
+    if(policy.compact != NULL){
+        found = policy.compact->lookup(ct, block_size, a_allocation);
+    }else{
+        int idx = policy.table->get_level_idx(ct.a0 + ct.a1 + ct.b0 + ct.b1);
+        const StateResult* res = (idx < 0) ? NULL : policy.table->lookup(idx, ct);
+        if(res != NULL){
+            block_size = res->block_size;
+            a_allocation = res->a_allocation;
+            found = true;
+        }
+    }
+    if(!found){
+        block_size = -1;
+        a_allocation = -1;
+    }
+
+    entry.valid = true;
+    entry.ct = ct;
+    entry.block_size = block_size;
+    entry.a_allocation = a_allocation;
+    return found;
+}
+
+
+// Serve every complete request in the connection's input,
+// appending the replies to its output. Returns false if the
+// connection should be closed.
+bool PolicyServer::handle_requests(Connection& conn){
+
+    size_t pos = 0;
+    while(!conn.closing && conn.in.size() - pos >= 12
+          && conn.out.size() - conn.out_pos < POLICY_MAX_PENDING){
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const unsigned char* p = &conn.in[pos];
+        uint32_t op = get_u32(p);
+        uint32_t policy_idx = get_u32(p + 4);
+        uint32_t count = get_u32(p + 8);
+
+        std::vector<unsigned char>& reply = conn.out;
+
+        if(op == POLICY_OP_STATS){
+            std::string report = stats();
+            put_u32(reply, POLICY_OK);
+            put_u32(reply, report.size());
+            reply.insert(reply.end(), report.begin(), report.end());
+            pos += 12;
+        }else if(op == POLICY_OP_LOOKUP && count <= POLICY_MAX_BATCH){
+
+            size_t length = 12 + 8*size_t(count);
+            if(conn.in.size() - pos < length){
+                break;
+            }
+            if(policy_idx >= policies.size()){
+                put_u32(reply, POLICY_BAD_POLICY);
+                put_u32(reply, 0);
+            }else{
+                Policy& policy = policies[policy_idx];
+                reply.reserve(reply.size() + 8 + 8*size_t(count));
+                put_u32(reply, POLICY_OK);
+                put_u32(reply, count);
+                for(uint32_t k = 0; k < count; ++k){
+                    const unsigned char* s = p + 12 + 8*k;
+                    ContingencyTable ct = ContingencyTable(get_u16(s), get_u16(s + 2),
+                                                           get_u16(s + 4), get_u16(s + 6));
+                    int block_size, a_allocation;
+                    lookup(policy, ct, block_size, a_allocation);
+                    put_u32(reply, uint32_t(block_size));
+                    put_u32(reply, uint32_t(a_allocation));
+                }
+                policy.n_requests++;
+                policy.n_states += count;
+            }
+            pos += length;
+        }else{
+            // We can't find the next request's start
+            put_u32(reply, POLICY_BAD_REQUEST);
+            put_u32(reply, 0);
+            conn.closing = true;
+            pos = conn.in.size();
+            break;
+        }
+
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        latency.record(ns);
+        if(op == POLICY_OP_LOOKUP && policy_idx < policies.size()){
+            policies[policy_idx].latency.record(ns);
+        }
+    }
+    conn.in.erase(conn.in.begin(), conn.in.begin() + pos);
+    return send_pending(conn);
+}
+
+
+void PolicyServer::serve(){
+
+    std::vector<Connection> conns;
+    std::vector<unsigned char> buf(1 << 16);
+
+    while(!stop_requested){
+
+        // Read requests only while the replies are being taken
+        std::vector<struct pollfd> fds(conns.size() + 1);
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for(unsigned int i = 0; i < conns.size(); ++i){
+            size_t pending = conns[i].out.size() - conns[i].out_pos;
+            fds[i+1].fd = conns[i].fd;
+            fds[i+1].events = 0;
+            if(!conns[i].closing && pending < POLICY_MAX_PENDING){
+                fds[i+1].events |= POLLIN;
+            }
+            if(pending > 0){
+                fds[i+1].events |= POLLOUT;
+            }
+        }
+
+        // Wake up now and then to check stop_requested
+        int n_ready = poll(&fds[0], fds.size(), 200);
+        if(n_ready < 0 && errno != EINTR){
+            std::cerr << "`PolicyServer`: poll failed (" << std::strerror(errno) << ")" << std::endl;
+            break;
+        }
+        if(n_ready <= 0){
+            continue;
+        }
+
+        // (Open connections move to the front, without copying their buffers)
+        unsigned int n_open = 0;
+        for(unsigned int i = 0; i < conns.size(); ++i){
+            Connection& conn = conns[i];
+            bool keep = true;
+            if(fds[i+1].revents & (POLLOUT | POLLHUP | POLLERR)){
+                // (Also serves requests held back by a full output)
+                keep = send_pending(conn) && handle_requests(conn);
+            }
+            if(keep && (fds[i+1].revents & POLLIN)){
+                ssize_t k = recv(conn.fd, &buf[0], buf.size(), 0);
+                if(k > 0){
+                    conn.in.insert(conn.in.end(), buf.begin(), buf.begin() + k);
+                    keep = handle_requests(conn);
+                }else if(k == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)){
+                    keep = false;
+                }
+            }
+            if(conn.closing && conn.out.empty()){
+                keep = false;
+            }
+            if(keep){
+                if(n_open != i){
+                    std::swap(conns[n_open], conn);
+                }
+                n_open++;
+            }else{
+                close(conn.fd);
+            }
+        }
+        conns.resize(n_open);
+
+        if(fds[0].revents & POLLIN){
+            int fd = accept(listen_fd, NULL, NULL);
+            if(fd >= 0){
+                if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0){
+                    close(fd);
+                    continue;
+                }
+                Connection conn;
+                conn.fd = fd;
+                conn.out_pos = 0;
+                conn.closing = false;
+                conns.push_back(conn);
+            }
+        }
+    }
+
+    for(unsigned int i = 0; i < conns.size(); ++i){
+        close(conns[i].fd);
+    }
+}
+
+
+std::string PolicyServer::stats(){
+    std::ostringstream out;
+    out << "requests: " << latency.count()
+        << "\tp50: " << latency.quantile(0.5)/1000.0 << " us"
+        << "\tp99: " << latency.quantile(0.99)/1000.0 << " us" << std::endl;
+    for(unsigned int i = 0; i < policies.size(); ++i){
+        Policy& policy = policies[i];
+        out << "policy " << i << " (" << policy.fname << "): "
+            << policy.n_requests << " requests, "
+            << policy.n_states << " states, "
+            << policy.n_hits << " cache hits"
+            << "\tp50: " << policy.latency.quantile(0.5)/1000.0 << " us"
+            << "\tp99: " << policy.latency.quantile(0.99)/1000.0 << " us" << std::endl;
+    }
+    return out.str();
+}
+
+
+////////////////////////////////
+// PolicyClient
+////////////////////////////////
+
+PolicyClient::PolicyClient(std::string socket_path){
+
+    struct sockaddr_un addr;
+    if(socket_path.size() >= sizeof(addr.sun_path)){
+        std::cerr << "`PolicyClient`: socket path too long: " << socket_path << std::endl;
+        throw 1;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0){
+        std::cerr << "`PolicyClient`: failed to connect to " << socket_path
+                  << " (" << std::strerror(errno) << ")" << std::endl;
+        if(fd >= 0){
+            close(fd);
+        }
+        throw 1;
+    }
+}
+
+
+PolicyClient::~PolicyClient(){
+    close(fd);
+}
+
+
+void PolicyClient::request(uint32_t op, uint32_t policy, uint32_t count,
+                           const std::vector<unsigned char>& body,
+                           std::vector<unsigned char>& reply){
+
+    std::vector<unsigned char> msg;
+    msg.reserve(12 + body.size());
+    put_u32(msg, op);
+    put_u32(msg, policy);
+    put_u32(msg, count);
+    msg.insert(msg.end(), body.begin(), body.end());
+
+    size_t sent = 0;
+    while(sent < msg.size()){
+        ssize_t k = send(fd, &msg[sent], msg.size() - sent, MSG_NOSIGNAL);
+        if(k < 0 && errno == EINTR){
+            continue;
+        }
+        if(k <= 0){
+            std::cerr << "`PolicyClient`: failed to send a request." << std::endl;
+            throw 1;
+        }
+        sent += k;
+    }
+
+    unsigned char header[8];
+    recv_all(fd, header, 8);
+    uint32_t status = get_u32(header);
+    uint32_t n = get_u32(header + 4);
+    if(status != POLICY_OK){
+        std::cerr << "`PolicyClient`: the server rejected the request ("
+                  << ((status == POLICY_BAD_POLICY) ? "no such policy" : "bad request")
+                  << ")." << std::endl;
+        throw 1;
+    }
+    size_t length = (op == POLICY_OP_LOOKUP) ? 8*size_t(n) : n;
+    reply.resize(length);
+    if(length > 0){
+        recv_all(fd, &reply[0], length);
+    }
+}
+
+
+void PolicyClient::lookup(int policy, const std::vector<ContingencyTable>& cts,
+                          std::vector<int>& block_size, std::vector<int>& a_allocation){
+
+    if(cts.size() > POLICY_MAX_BATCH){
+        std::cerr << "`PolicyClient`: at most " << POLICY_MAX_BATCH << " states per batch." << std::endl;
+        throw 1;
+    }
+    std::vector<unsigned char> body;
+    body.reserve(8*cts.size());
+    for(unsigned int k = 0; k < cts.size(); ++k){
+        put_u16(body, cts[k].a0);
+        put_u16(body, cts[k].a1);
+        put_u16(body, cts[k].b0);
+        put_u16(body, cts[k].b1);
+    }
+
+    std::vector<unsigned char> reply;
+    request(POLICY_OP_LOOKUP, policy, cts.size(), body, reply);
+
+    block_size.resize(cts.size());
+    a_allocation.resize(cts.size());
+    for(unsigned int k = 0; k < cts.size(); ++k){
+        block_size[k] = int32_t(get_u32(&reply[8*k]));
+        a_allocation[k] = int32_t(get_u32(&reply[8*k + 4]));
+    }
+}
+
+
+std::string PolicyClient::stats(){
+    std::vector<unsigned char> reply;
+    request(POLICY_OP_STATS, 0, 0, std::vector<unsigned char>(), reply);
+    return std::string(reply.begin(), reply.end());
+}
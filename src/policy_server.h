@@ -0,0 +1,164 @@
+// policy_server.h
+// (c) 2021-03 David Merrell
+//
+// A small server for looking up solved trial designs.
+//
+// Services that consult a design (randomization, monitoring,
+// simulation) can share one PolicyServer instead of each opening
+// the database. The server listens on a Unix domain socket, and
+// answers batches of state -> action lookups.
+//
+// Designs in the compact format (see CompactPolicy) are mapped
+// into memory; SQLite databases are read into a TrialMDPTable.
+// Each design also gets a small direct-mapped cache of recent
+// lookups, since clients tend to ask about the same few states
+// (e.g., the early tables of a trial).
+//
+// The protocol is little-endian. A request is three u32s
+// (op, policy, count) followed by, for POLICY_OP_LOOKUP, `count`
+// tables as four u16s (A0, A1, B0, B1). The reply is two u32s
+// (status, count), followed by `count` pairs of i32s
+// (BlockSize, AAllocation; -1 if the state is missing).
+// For POLICY_OP_STATS the reply's count is the length of a
+// text report (requests, cache hits, p50/p99 latency).
+//
+// The server is single-threaded: it polls its connections and
+// serves one request at a time, so its caches and counters need
+// no locks. Its sockets are non-blocking: replies wait in each
+// connection's output buffer until the client reads them, so a
+// slow client never stalls the others.
+
+#ifndef _POLICY_SERVER_H
+#define _POLICY_SERVER_H
+
+#include "contingency_table.h"
+#include "trial_mdp_table.h"
+#include "compact_policy.h"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+#define POLICY_OP_LOOKUP 1
+#define POLICY_OP_STATS 2
+
+#define POLICY_OK 0
+#define POLICY_BAD_POLICY 1
+#define POLICY_BAD_REQUEST 2
+
+// Largest batch the server accepts
+#define POLICY_MAX_BATCH (1 << 20)
+
+// Stop reading a connection's requests while this many
+// bytes of its replies are waiting to be sent
+#define POLICY_MAX_PENDING (1 << 24)
+
+// Cache entries per design (a power of 2)
+#define POLICY_CACHE_SIZE 4096
+
+// Latency histogram: LATENCY_PER_DOUBLING buckets per
+// factor of 2, from LATENCY_MIN_NS up
+#define LATENCY_MIN_NS 64.0
+#define LATENCY_PER_DOUBLING 8
+#define LATENCY_BUCKETS 256
+
+
+// Counts of durations, in logarithmically spaced buckets
+// (so quantiles are accurate to about 9 percent)
+class LatencyHistogram{
+
+    private:
+        std::vector<long> counts;
+        long total;
+
+    public:
+        LatencyHistogram();
+        void record(double nanoseconds);
+        long count() const { return total; }
+        // (In nanoseconds; 0 if nothing was recorded)
+        double quantile(double q) const;
+};
+
+
+class PolicyServer{
+
+    private:
+        struct CacheEntry{
+            bool valid;
+            ContingencyTable ct;
+            int block_size;
+            int a_allocation;
+        };
+
+        struct Policy{
+            std::string fname;
+            CompactPolicy* compact;
+            TrialMDPTable* table;
+            std::vector<CacheEntry> cache;
+            long n_requests;
+            long n_states;
+            long n_hits;
+            LatencyHistogram latency;
+        };
+
+        // Unsent replies are out[out_pos:]. A connection
+        // that sent a bad request is closed once they're sent.
+        struct Connection{
+            int fd;
+            std::vector<unsigned char> in;
+            std::vector<unsigned char> out;
+            size_t out_pos;
+            bool closing;
+        };
+
+        std::string socket_path;
+        int listen_fd;
+        std::vector<Policy> policies;
+        LatencyHistogram latency;
+        std::atomic<bool> stop_requested;
+
+        // Private methods
+        bool lookup(Policy& policy, const ContingencyTable& ct,
+                    int& block_size, int& a_allocation);
+        bool handle_requests(Connection& conn);
+        bool send_pending(Connection& conn);
+
+    public:
+        // Listen on `socket_path` (replacing a stale socket there)
+        PolicyServer(std::string socket_path);
+        ~PolicyServer();
+
+        // Serve a design; returns its policy number
+        // (0, 1, ... in the order they're added)
+        int add_policy(std::string fname);
+
+        // Serve until `stop` is called (e.g., from a signal handler)
+        void serve();
+        void stop(){ stop_requested = true; }
+
+        std::string stats();
+};
+
+
+// A connection to a PolicyServer
+class PolicyClient{
+
+    private:
+        int fd;
+
+        void request(uint32_t op, uint32_t policy, uint32_t count,
+                     const std::vector<unsigned char>& body,
+                     std::vector<unsigned char>& reply);
+
+    public:
+        PolicyClient(std::string socket_path);
+        ~PolicyClient();
+
+        // Look up a batch of states (-1 where the state is missing)
+        void lookup(int policy, const std::vector<ContingencyTable>& cts,
+                    std::vector<int>& block_size, std::vector<int>& a_allocation);
+
+        std::string stats();
+};
+
+#endif
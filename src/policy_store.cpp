@@ -0,0 +1,183 @@
+// policy_store.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the PolicyStore class.
+
+#include "policy_store.h"
+#include "trial_mdp.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+
+uint64_t fnv1a_64(const std::string& s){
+    uint64_t h = 14695981039346656037ull;
+    for(unsigned int i = 0; i < s.size(); ++i){
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+
+void copy_file_atomic(const std::string& src, const std::string& dest){
+
+    // A temporary name unique to this process and call
+    static long n_copies = 0;
+    std::ostringstream tmp;
+    tmp << dest << ".tmp-" << getpid() << "-" << n_copies++;
+
+    std::ifstream in(src.c_str(), std::ios::binary);
+    std::ofstream out(tmp.str().c_str(), std::ios::binary);
+    if(!in || !out){
+        std::cerr << "`copy_file_atomic`: failed to copy " << src << " to " << dest << std::endl;
+        std::remove(tmp.str().c_str());
+        throw 1;
+    }
+    out << in.rdbuf();
+    out.close();
+    if(!out || std::rename(tmp.str().c_str(), dest.c_str()) != 0){
+        std::cerr << "`copy_file_atomic`: failed to write " << dest << std::endl;
+        std::remove(tmp.str().c_str());
+        throw 1;
+    }
+}
+
+
+PolicyStore::PolicyStore(std::string store_dir){
+    dir = store_dir;
+    if(mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST){
+        std::cerr << "`PolicyStore`: failed to create " << dir
+                  << " (" << std::strerror(errno) << ")" << std::endl;
+        throw 1;
+    }
+}
+
+
+std::string PolicyStore::canonical_key(int n_patients, float failure_cost, float block_cost,
+                                       int min_size, int block_incr,
+                                       float prior_a0, float prior_a1,
+                                       float prior_b0, float prior_b1,
+                                       std::string transition_dist,
+                                       std::string test_statistic,
+                                       float act_l, float act_u, int act_n,
+                                       std::string act_search, int act_coarse,
+                                       float epsilon,
+                                       std::string backup){
+
+    // %.9g identifies a float exactly
+    char buf[1024];
+    std::snprintf(buf, sizeof(buf),
+                  "trial_mdp %d\n"
+                  "n_patients=%d\nfailure_cost=%.9g\nblock_cost=%.9g\n"
+                  "min_size=%d\nblock_incr=%d\n"
+                  "prior_a0=%.9g\nprior_a1=%.9g\nprior_b0=%.9g\nprior_b1=%.9g\n"
+                  "act_l=%.9g\nact_u=%.9g\nact_n=%d\n"
+                  "epsilon=%.9g\n",
+                  TRIAL_MDP_VERSION,
+                  n_patients, failure_cost, block_cost,
+                  min_size, block_incr,
+                  prior_a0, prior_a1, prior_b0, prior_b1,
+                  act_l, act_u, act_n,
+                  epsilon);
+    std::string key = buf;
+    key += "transition_dist=" + transition_dist + "\n";
+    key += "test_statistic=" + test_statistic + "\n";
+    key += "act_search=" + act_search + "\n";
+    // (Only the coarse-to-fine search uses act_coarse)
+    if(act_search != "exhaustive"){
+        key += "act_coarse=" + std::to_string(act_coarse) + "\n";
+    }
+    // (Action-major designs are identical to state-major ones;
+    //  factored ones can differ in near-ties)
+    if(backup == "factored"){
+        key += "backup=" + backup + "\n";
+    }
+    return key;
+}
+
+
+std::string PolicyStore::path(const std::string& key, const std::string& form){
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", (unsigned long long) fnv1a_64(key));
+    return dir + "/" + hash + "." + form;
+}
+
+
+bool PolicyStore::fetch(const std::string& key, const std::string& form, std::string dest_fname){
+
+    // The key file guards against hash collisions
+    std::ifstream key_in(path(key, "key").c_str(), std::ios::binary);
+    if(!key_in){
+        return false;
+    }
+    std::ostringstream stored_key;
+    stored_key << key_in.rdbuf();
+    if(stored_key.str() != key){
+        return false;
+    }
+
+    std::string fname = path(key, form);
+    if(access(fname.c_str(), R_OK) != 0){
+        return false;
+    }
+    copy_file_atomic(fname, dest_fname);
+    return true;
+}
+
+
+// Whether a design database is intact and has a non-empty RESULTS table
+static bool valid_sqlite_design(const std::string& fname){
+
+    sqlite3* db = NULL;
+    if(sqlite3_open_v2(fname.c_str(), &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK){
+        sqlite3_close(db);
+        return false;
+    }
+    bool valid = false;
+    sqlite3_stmt* stmt = NULL;
+    if(sqlite3_prepare_v2(db, "PRAGMA quick_check;", -1, &stmt, NULL) == SQLITE_OK
+       && sqlite3_step(stmt) == SQLITE_ROW){
+        const unsigned char* check = sqlite3_column_text(stmt, 0);
+        valid = (check != NULL && std::strcmp((const char*) check, "ok") == 0);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if(valid){
+        valid = (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM RESULTS;", -1, &stmt, NULL) == SQLITE_OK
+                 && sqlite3_step(stmt) == SQLITE_ROW
+                 && sqlite3_column_int64(stmt, 0) > 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return valid;
+}
+
+
+void PolicyStore::publish(const std::string& key, const std::string& form, std::string src_fname){
+
+    // Never share a broken design (e.g., one cut short by a full disk)
+    if(form.size() >= 6 && form.compare(form.size() - 6, 6, "sqlite") == 0
+       && !valid_sqlite_design(src_fname)){
+        std::cerr << "`PolicyStore`: " << src_fname << " isn't a complete design; not storing it." << std::endl;
+        throw 1;
+    }
+
+    std::string key_fname = path(key, "key");
+    std::string tmp_fname = key_fname + ".new-" + std::to_string(getpid());
+    std::ofstream key_out(tmp_fname.c_str(), std::ios::binary);
+    key_out << key;
+    key_out.close();
+    if(!key_out || std::rename(tmp_fname.c_str(), key_fname.c_str()) != 0){
+        std::cerr << "`PolicyStore`: failed to write " << key_fname << std::endl;
+        std::remove(tmp_fname.c_str());
+        throw 1;
+    }
+    copy_file_atomic(src_fname, path(key, form));
+}
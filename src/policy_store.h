@@ -0,0 +1,68 @@
+// policy_store.h
+// (c) 2021-03 David Merrell
+//
+// A local store of solved designs, so that nobody
+// solves the same problem twice.
+//
+// A design is filed under a hash of its canonical parameters:
+// the solver version (TRIAL_MDP_VERSION) and every parameter that
+// can change the solution, printed exactly and in a fixed order.
+// The directory holds, for each hash, a `<hash>.key` file with the
+// canonical parameters (checked on every fetch, so a hash
+// collision is a miss, not a wrong design) and one file per
+// stored form of the design, `<hash>.<form>` (e.g., "sqlite",
+// "reachable.sqlite", "tmdp").
+//
+// Files are published by writing a temporary file in the same
+// directory and renaming it into place. Renames are atomic, so
+// readers see either no file or a complete one, and concurrent
+// runs that solve the same problem just replace each other's
+// (identical) files.
+
+#ifndef _POLICY_STORE_H
+#define _POLICY_STORE_H
+
+#include <string>
+#include <stdint.h>
+
+// 64-bit FNV-1a hash
+uint64_t fnv1a_64(const std::string& s);
+
+class PolicyStore{
+
+    private:
+        std::string dir;
+
+        std::string path(const std::string& key, const std::string& form);
+
+    public:
+        // (Creates the directory if needed)
+        PolicyStore(std::string dir);
+
+        // The canonical parameters of a solve (the same
+        // parameters as TrialMDP's, and its solver settings;
+        // `backup` is the order the solve actually used)
+        static std::string canonical_key(int n_patients, float failure_cost, float block_cost,
+                                         int min_size, int block_incr,
+                                         float prior_a0, float prior_a1,
+                                         float prior_b0, float prior_b1,
+                                         std::string transition_dist,
+                                         std::string test_statistic,
+                                         float act_l, float act_u, int act_n,
+                                         std::string act_search, int act_coarse,
+                                         float epsilon,
+                                         std::string backup="state_major");
+
+        // If the store has the design in this form, copy it
+        // to dest_fname and return true
+        bool fetch(const std::string& key, const std::string& form, std::string dest_fname);
+
+        // Store a copy of a design file. SQLite designs are checked
+        // first (throws 1 if the file is damaged or has no results).
+        void publish(const std::string& key, const std::string& form, std::string src_fname);
+};
+
+// Copy a file, renaming the copy into place at the end
+void copy_file_atomic(const std::string& src, const std::string& dest);
+
+#endif
@@ -3,16 +3,50 @@
 //
 
 #include "trial_mdp.h"
+#include "trial_mdp_table.h"
+#include "contingency_iterator.h"
+#include "operating_characteristics.h"
+#include "trial_simulator.h"
+#include "approx_trial_mdp.h"
+#include "mcts_planner.h"
+#include "compact_policy.h"
+#include "policy_store.h"
+#include "solve_estimate.h"
+#include "solve_job.h"
+#include "sharded_solve.h"
 #include <string>
+#include <vector>
 #include <iostream>
+#include <cmath>
+#include <memory>
+#include <algorithm>
 #include <Rcpp.h>
 using namespace Rcpp;
 
-// [[Rcpp::depends(BH)]]
-
 // [[Rcpp::plugins("cpp11")]]
 
 
+// Whether the user has interrupted R (for long waits in C++;
+// R_CheckUserInterrupt itself would jump over our destructors)
+static void check_interrupt(void* unused){
+  R_CheckUserInterrupt();
+}
+
+static bool r_interrupted(){
+  return R_ToplevelExec(check_interrupt, NULL) == FALSE;
+}
+
+// A table we own, with its levels (see TrialMDPTable::release),
+// freed even if a step throws
+struct TableDeleter{
+  void operator()(TrialMDPTable* table) const {
+    table->release();
+    delete table;
+  }
+};
+typedef std::unique_ptr<TrialMDPTable, TableDeleter> TablePtr;
+
+
 //' Use TrialMDP to compute an optimal trial design
 //'
 //' Given the number of patients, failure cost, and stage cost, compute an optimal trial design and save it to a SQLite database. 
@@ -32,12 +66,24 @@ using namespace Rcpp;
 //' @param act_l smallest allocation fraction to treatment A. i.e., Phi = {act_l, ..., act_u}. Default=0.2
 //' @param act_u largest allocation fraction to treatment A. i.e., Phi = {act_l, ..., act_u}. Default=0.8
 //' @param act_n number of possible allocation fractions, uniformly spaced. i.e., |Phi| = act_n. Default=7
+//' @param act_search strategy for searching the allocations: "exhaustive" or "coarse_to_fine". Default="exhaustive"
+//' @param act_coarse number of allocations per block size tried in the coarse pass of "coarse_to_fine". Default=7
+//' @param act_validate if > 0, every act_validate-th state is also searched exhaustively, and disagreements are reported. Default=0
+//' @param coarse_factor if > 1, first solve with block increment coarse_factor*block_incr, and use that solution to guide the search. The design is unchanged. Default=1
+//' @param epsilon if > 0, ignore each arm's least likely outcomes (holding epsilon of the probability mass) in every block. Faster for large blocks; the solver reports a bound on the resulting error in the expected reward. Default=0
+//' @param reachable_only if TRUE, save only the states the optimal policy can reach from the empty table (and that have an action). The database is much smaller, and still works with trial_mdp_oc and trial_mdp_simulate; but not with trial_mdp_evaluate. Default=FALSE
+//' @param reach_prob if TRUE (with reachable_only), add a ReachProb column: each state's probability of being reached, under the transition distribution. Default=FALSE
+//' @param return_handle if TRUE, return the solved design as an in-memory handle (see trial_mdp_lookup, trial_mdp_columns and trial_mdp_save). With return_handle=TRUE, sqlite_fname may be "", and nothing is written to disk. Default=FALSE
+//' @param memory_budget_gb if > 0, refuse to start a solve that would need more memory than this (in GB); see trial_mdp_plan. Default=0
+//' @param cache_dir if not "", a directory of previously solved designs (created if needed). If it holds a design with exactly these parameters, it's copied to sqlite_fname instead of solving again; otherwise the new design is added to it. The directory can be shared by concurrent runs. (Not consulted with return_handle=TRUE.) Default=""
+//' @param n_processes if not 1, solve with this many worker processes (0 for one per NUMA node), which share each level of the solution in memory. For machines with several sockets. The design is unchanged. Default=1
+//' @param backup order of the Bellman backups: "state_major" searches each state's actions in turn; "action_major" evaluates each action at every state of a level at once (exhaustive, without pruning; often faster, and the design is unchanged). "factored" is "action_major" with each arm's outcomes summed separately, sharing sums among states: much faster for large blocks, with values equal up to rounding. Both need epsilon=0, and apply only with n_processes=1. Default="state_major"
 //'
-//' @return None. Trial design is written to disk.
+//' @return None (trial design is written to disk); or, with return_handle=TRUE, a handle to the solved design.
 // [[Rcpp::export]]
-void trial_mdp(int n_patients,
+SEXP trial_mdp(int n_patients,
                float failure_cost, float block_cost,
-               std::string sqlite_fname,
+               std::string sqlite_fname="",
                int min_size=4,
                int block_incr=2,
                float prior_a0 = 1.0,
@@ -46,39 +92,1106 @@ void trial_mdp(int n_patients,
                float prior_b1 = 1.0,
                std::string transition_dist="beta_binom",
                std::string test_statistic="scaled_cmh",
-               float act_l=0.2, float act_u=0.8, int act_n=7) {
+               float act_l=0.2, float act_u=0.8, int act_n=7,
+               std::string act_search="exhaustive",
+               int act_coarse=7, int act_validate=0,
+               int coarse_factor=1,
+               float epsilon=0.0,
+               bool reachable_only=false,
+               bool reach_prob=false,
+               bool return_handle=false,
+               std::string cache_dir="",
+               double memory_budget_gb=0.0,
+               int n_processes=1,
+               std::string backup="state_major") {
 
+  if(sqlite_fname.empty() && !return_handle){
+    stop("sqlite_fname is required (unless return_handle=TRUE)");
+  }
+  if(memory_budget_gb > 0.0){
+    int n_attr = ResultInterpreter(test_statistic, failure_cost, block_cost, n_patients).get_n_attr();
+    SolveEstimate est = estimate_solve(n_patients, min_size, block_incr, act_l, act_u, act_n, n_attr,
+                                       backup, coarse_factor, n_processes);
+    if(est.memory_bytes / 1e9 > memory_budget_gb){
+      stop("the solve needs about " + std::to_string(est.memory_bytes / 1e9) + " GB, more than memory_budget_gb; see trial_mdp_plan");
+    }
+  }
 
-  TrialMDP solver = TrialMDP(n_patients,
-                             failure_cost, block_cost,
-                             min_size, block_incr,
-                             prior_a0, prior_a1,
-                             prior_b0, prior_b1,
-                             transition_dist,
-                             test_statistic,
-                             act_l, act_u, act_n);
+  // Look for the design in the store first.
+  // (Everything allocated here is freed if a step throws)
+  std::unique_ptr<PolicyStore> store;
+  std::string cache_key;
+  std::string cache_form = reachable_only ? (reach_prob ? "reach_prob.sqlite" : "reachable.sqlite") : "sqlite";
+  if(!cache_dir.empty()){
+    store.reset(new PolicyStore(cache_dir));
+    // (A sharded solve's backups are state-major; see solve_sharded)
+    cache_key = PolicyStore::canonical_key(n_patients, failure_cost, block_cost,
+                                           min_size, block_incr,
+                                           prior_a0, prior_a1, prior_b0, prior_b1,
+                                           transition_dist, test_statistic,
+                                           act_l, act_u, act_n,
+                                           act_search, act_coarse, epsilon,
+                                           (n_processes == 1) ? backup : "state_major");
+    if(!return_handle && !sqlite_fname.empty()
+       && store->fetch(cache_key, cache_form, sqlite_fname)){
+      std::cout << "Found a stored design in " << cache_dir << std::endl;
+      std::cout << "Saved to file: " << sqlite_fname << std::endl;
+      return R_NilValue;
+    }
+  }
+
+  std::unique_ptr<TrialMDP> solver(new TrialMDP(n_patients,
+                                                failure_cost, block_cost,
+                                                min_size, block_incr,
+                                                prior_a0, prior_a1,
+                                                prior_b0, prior_b1,
+                                                transition_dist,
+                                                test_statistic,
+                                                act_l, act_u, act_n));
+  solver->set_action_search(act_search, act_coarse, act_validate);
+  solver->set_epsilon(epsilon);
+  solver->set_backup_order(backup);
+
+  // Multi-resolution: solve the same problem on a coarser grid first
+  std::unique_ptr<TrialMDP> coarse_solver;
+  if(coarse_factor > 1){
+    std::cout << "Solving on a coarse grid (block increment " << coarse_factor*block_incr << ")." << std::endl;
+    coarse_solver.reset(new TrialMDP(n_patients,
+                                     failure_cost, block_cost,
+                                     min_size, coarse_factor*block_incr,
+                                     prior_a0, prior_a1,
+                                     prior_b0, prior_b1,
+                                     transition_dist,
+                                     test_statistic,
+                                     act_l, act_u, act_n));
+    coarse_solver->solve();
+    solver->set_coarse_solution(coarse_solver->get_results_table());
+  }
   
   std::cout << "Solver initialized." << std::endl;
   std::cout << "\tN patients: " << n_patients << std::endl; 
   std::cout << "\tMin block size: " << min_size << std::endl;
   std::cout << "\tBlock increment: " << block_incr << std::endl;
   std::cout << "\tAllocations: {" << act_l << ", ..., " << act_u << "} (" << act_n << ")" << std::endl; 
+  std::cout << "\tAllocation search: " << act_search << std::endl; 
   std::cout << "\tFailure cost: " << failure_cost << std::endl; 
   std::cout << "\tBlock cost: " << block_cost << std::endl; 
   std::cout << "\tTest statistic: " << test_statistic << std::endl; 
   std::cout << "Solving." << std::endl;
   
-  solver.solve();
+  if(n_processes == 1){
+    solver->solve();
+  }else{
+    SolveControl control;
+    control.interrupted = r_interrupted;
+    try{
+      solve_sharded(*solver, n_processes, &control);
+    }
+    catch(int code){
+      stop((code == TRIAL_MDP_CANCELLED) ? "interrupted" : "the sharded solve failed");
+    }
+  }
   std::cout << "Solver completed." << std::endl;
+  coarse_solver.reset();
   
-  char* fname = new char[sqlite_fname.length() + 1];
-  strcpy(fname, sqlite_fname.c_str());
-  
-  solver.to_sqlite(fname, 10000);
+  if(!sqlite_fname.empty()){
+    std::vector<char> fname(sqlite_fname.begin(), sqlite_fname.end());
+    fname.push_back('\0');
+    try{
+      if(reachable_only){
+        solver->to_sqlite_reachable(&fname[0], 10000, reach_prob);
+      }else{
+        solver->to_sqlite(&fname[0], 10000);
+      }
+    }
+    catch(int code){
+      stop("couldn't save the design to " + sqlite_fname);
+    }
+    std::cout << "Saved to file: " << sqlite_fname << std::endl;
+
+    // (Only a design that was saved, and checks out, is shared)
+    if(store){
+      try{
+        store->publish(cache_key, cache_form, sqlite_fname);
+        std::cout << "Stored the design in " << cache_dir << std::endl;
+      }
+      catch(int code){
+        std::cerr << "The design was not stored in " << cache_dir << std::endl;
+      }
+    }
+  }
+
+  if(!return_handle){
+    return R_NilValue;
+  }
+
+  // The handle owns the solver (and so its results table);
+  // R's garbage collector deletes it
+  XPtr<TrialMDP> handle = XPtr<TrialMDP>(solver.release(), true);
+  handle.attr("class") = "trial_mdp_design";
+  return handle;
+}
+
+
+// The solver behind a handle returned by trial_mdp
+static TrialMDP* design_from_handle(SEXP design){
+  if(TYPEOF(design) != EXTPTRSXP){
+    stop("expected a design handle (see trial_mdp's return_handle)");
+  }
+  XPtr<TrialMDP> handle = XPtr<TrialMDP>(design);
+  if(handle.get() == NULL){
+    stop("the design handle is no longer valid (e.g., it was restored from a saved session)");
+  }
+  return handle.get();
+}
+
+
+//' Look up states in an in-memory trial design
+//'
+//' Vectorized lookup into a design returned by trial_mdp(..., return_handle=TRUE). States not in the design (e.g., those with a number of patients at which the trial cannot stop) get NA.
+//'
+//' @param design a handle returned by trial_mdp(..., return_handle=TRUE)
+//' @param a0 failures in treatment A (one per state)
+//' @param a1 successes in treatment A
+//' @param b0 failures in treatment B
+//' @param b1 successes in treatment B
+//'
+//' @return a data.frame with one row per state: the table, its action, and its expected values.
+// [[Rcpp::export]]
+DataFrame trial_mdp_lookup(SEXP design,
+                           IntegerVector a0, IntegerVector a1,
+                           IntegerVector b0, IntegerVector b1) {
+
+  TrialMDP* solver = design_from_handle(design);
+  TrialMDPTable& table = solver->get_results_table();
+  std::vector<std::string> names = solver->get_attr_names();
+
+  int n = a0.size();
+  if(a1.size() != n || b0.size() != n || b1.size() != n){
+    stop("a0, a1, b0 and b1 must have the same length");
+  }
+
+  IntegerVector block_size(n), a_allocation(n);
+  std::vector<NumericVector> values;
+  for(unsigned int i = 0; i < names.size(); ++i){
+    values.push_back(NumericVector(n));
+  }
+  for(int k = 0; k < n; ++k){
+    const StateResult* res = NULL;
+    if(ct_counts_fit(a0[k], a1[k], b0[k], b1[k])){
+      int idx = table.get_level_idx(a0[k] + a1[k] + b0[k] + b1[k]);
+      if(idx >= 0){
+        res = table.lookup(idx, ContingencyTable(a0[k], a1[k], b0[k], b1[k]));
+      }
+    }
+    if(res == NULL){
+      block_size[k] = NA_INTEGER;
+      a_allocation[k] = NA_INTEGER;
+    }else{
+      block_size[k] = res->block_size;
+      a_allocation[k] = res->a_allocation;
+    }
+    for(unsigned int i = 0; i < names.size(); ++i){
+      values[i][k] = (res == NULL) ? NA_REAL : res->values[i];
+    }
+  }
+
+  List columns = List::create(Named("A0") = a0, Named("A1") = a1,
+                              Named("B0") = b0, Named("B1") = b1,
+                              Named("BlockSize") = block_size,
+                              Named("AAllocation") = a_allocation);
+  for(unsigned int i = 0; i < names.size(); ++i){
+    columns[names[i]] = values[i];
+  }
+  return DataFrame(columns);
+}
+
+
+//' Get every state of an in-memory trial design
+//'
+//' The whole design as columns, in the same layout as the RESULTS table that trial_mdp writes to SQLite; states are ordered by number of patients, then by (A0, A1, B0). The design is read twice: once to count its states, then to fill each column in place.
+//'
+//' @param design a handle returned by trial_mdp(..., return_handle=TRUE)
+//'
+//' @return a data.frame with one row per state.
+// [[Rcpp::export]]
+DataFrame trial_mdp_columns(SEXP design) {
+
+  TrialMDP* solver = design_from_handle(design);
+  TrialMDPTable& table = solver->get_results_table();
+  std::vector<std::string> names = solver->get_attr_names();
+  std::vector<int>& n_vec = table.get_n_vec();
+
+  // Size the columns first
+  int n_rows = 0;
+  for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+    for(ContingencyIterator it(n_vec[idx]); it.in_range(); it.advance()){
+      if(table.lookup(idx, it.value()) != NULL){
+        n_rows++;
+      }
+    }
+  }
+
+  IntegerVector a0(n_rows), a1(n_rows), b0(n_rows), b1(n_rows);
+  IntegerVector block_size(n_rows), a_allocation(n_rows);
+  std::vector<NumericVector> values;
+  for(unsigned int i = 0; i < names.size(); ++i){
+    values.push_back(NumericVector(n_rows));
+  }
+
+  int k = 0;
+  for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+    for(ContingencyIterator it(n_vec[idx]); it.in_range(); it.advance()){
+      ContingencyTable ct = it.value();
+      const StateResult* res = table.lookup(idx, ct);
+      if(res == NULL){
+        continue;
+      }
+      a0[k] = ct.a0;
+      a1[k] = ct.a1;
+      b0[k] = ct.b0;
+      b1[k] = ct.b1;
+      block_size[k] = res->block_size;
+      a_allocation[k] = res->a_allocation;
+      for(unsigned int i = 0; i < names.size(); ++i){
+        values[i][k] = res->values[i];
+      }
+      k++;
+    }
+  }
+
+  List columns = List::create(Named("A0") = a0, Named("A1") = a1,
+                              Named("B0") = b0, Named("B1") = b1,
+                              Named("BlockSize") = block_size,
+                              Named("AAllocation") = a_allocation);
+  for(unsigned int i = 0; i < names.size(); ++i){
+    columns[names[i]] = values[i];
+  }
+  return DataFrame(columns);
+}
+
+
+//' Save an in-memory trial design
+//'
+//' Write a design returned by trial_mdp(..., return_handle=TRUE) to disk: as a SQLite database (the same file trial_mdp would have written), or in the compact format (see trial_mdp_compact).
+//'
+//' @param design a handle returned by trial_mdp(..., return_handle=TRUE)
+//' @param fname output filepath
+//' @param format "sqlite" or "compact". Default="sqlite"
+//' @param reachable_only (sqlite) save only the states the optimal policy can reach; see trial_mdp. Default=FALSE
+//' @param reach_prob (sqlite, with reachable_only) add a ReachProb column; see trial_mdp. Default=FALSE
+//' @param value_bits (compact) bits per stored expected value: 0, 8, 16, or 32. Default=16
+//'
+//' @return None. The design is written to disk.
+// [[Rcpp::export]]
+void trial_mdp_save(SEXP design, std::string fname,
+                    std::string format="sqlite",
+                    bool reachable_only=false,
+                    bool reach_prob=false,
+                    int value_bits=16) {
+
+  TrialMDP* solver = design_from_handle(design);
+
+  if(format == "sqlite"){
+    std::vector<char> db_fname(fname.begin(), fname.end());
+    db_fname.push_back('\0');
+    try{
+      if(reachable_only){
+        solver->to_sqlite_reachable(&db_fname[0], 10000, reach_prob);
+      }else{
+        solver->to_sqlite(&db_fname[0], 10000);
+      }
+    }
+    catch(int code){
+      stop("couldn't save the design to " + fname);
+    }
+    std::cout << "Saved to file: " << fname << std::endl;
+  }else if(format == "compact"){
+    CompactPolicy policy = CompactPolicy(solver->get_results_table(),
+                                         solver->get_attr_names(), value_bits);
+    policy.save(fname);
+    std::cout << "Saved to file: " << fname << " (" << policy.size_bytes() << " bytes)" << std::endl;
+  }else{
+    stop("format must be \"sqlite\" or \"compact\"");
+  }
+}
+
+
+// What an R job handle owns: a share of the job.
+// (When R drops the handle, the job is cancelled.)
+struct JobHandle{
+  std::shared_ptr<SolveJob> job;
+  ~JobHandle(){ job->cancel(); }
+};
+
+
+static SolveJob* job_from_handle(SEXP job){
+  if(TYPEOF(job) != EXTPTRSXP){
+    stop("expected a job handle (see trial_mdp_async)");
+  }
+  XPtr<JobHandle> handle = XPtr<JobHandle>(job);
+  if(handle.get() == NULL){
+    stop("the job handle is no longer valid (e.g., it was restored from a saved session)");
+  }
+  return handle->job.get();
+}
+
+
+//' Start computing an optimal trial design in the background
+//'
+//' Like trial_mdp, but returns at once: the solve runs on a background thread, and the R session stays responsive. Follow the job with trial_mdp_job_status, wait for it with trial_mdp_job_wait, stop it with trial_mdp_job_cancel, and get the solved design with trial_mdp_job_result. Jobs run in the order they're started, at most n_workers at a time; the others wait in a queue.
+//'
+//' @param n_patients the number of patients in the trial
+//' @param failure_cost parameter representing the cost of patient failures
+//' @param block_cost parameter representing the cost of each additional trial stage
+//' @param sqlite_fname if not "", save the design to this SQLite database when the solve finishes. Default=""
+//' @param min_size minimum size for a trial stage. Default=4
+//' @param block_incr require trial stage sizes to be multiples of this number. Default=2
+//' @param prior_a0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_a1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param transition_dist name of transition probability distribution. Default="beta_binom"
+//' @param test_statistic name of test statistic for which to optimize. Default="scaled_cmh"
+//' @param act_l smallest allocation fraction to treatment A. Default=0.2
+//' @param act_u largest allocation fraction to treatment A. Default=0.8
+//' @param act_n number of possible allocation fractions. Default=7
+//' @param act_search strategy for searching the allocations; see trial_mdp. Default="exhaustive"
+//' @param act_coarse number of allocations per block size tried in the coarse pass; see trial_mdp. Default=7
+//' @param epsilon tail truncation of the transitions; see trial_mdp. Default=0
+//' @param reachable_only save only the reachable states; see trial_mdp. Default=FALSE
+//' @param reach_prob with reachable_only, add a ReachProb column; see trial_mdp. Default=FALSE
+//' @param n_workers the number of solves that may run at once. Default=1
+//'
+//' @return a job handle.
+// [[Rcpp::export]]
+SEXP trial_mdp_async(int n_patients,
+                     float failure_cost, float block_cost,
+                     std::string sqlite_fname="",
+                     int min_size=4,
+                     int block_incr=2,
+                     float prior_a0 = 1.0,
+                     float prior_a1 = 1.0,
+                     float prior_b0 = 1.0,
+                     float prior_b1 = 1.0,
+                     std::string transition_dist="beta_binom",
+                     std::string test_statistic="scaled_cmh",
+                     float act_l=0.2, float act_u=0.8, int act_n=7,
+                     std::string act_search="exhaustive",
+                     int act_coarse=7,
+                     float epsilon=0.0,
+                     bool reachable_only=false,
+                     bool reach_prob=false,
+                     int n_workers=1) {
+
+  TrialMDP* solver = new TrialMDP(n_patients,
+                                  failure_cost, block_cost,
+                                  min_size, block_incr,
+                                  prior_a0, prior_a1,
+                                  prior_b0, prior_b1,
+                                  transition_dist,
+                                  test_statistic,
+                                  act_l, act_u, act_n);
+  solver->set_action_search(act_search, act_coarse, 0);
+  solver->set_epsilon(epsilon);
+
+  JobHandle* handle = new JobHandle();
+  handle->job = std::shared_ptr<SolveJob>(new SolveJob(solver, sqlite_fname,
+                                                       reachable_only, reach_prob));
+  solve_queue().submit(handle->job, (n_workers < 1) ? 1 : n_workers);
+
+  XPtr<JobHandle> job = XPtr<JobHandle>(handle, true);
+  job.attr("class") = "trial_mdp_job";
+  return job;
+}
+
+
+//' Check on a background trial design solve
+//'
+//' @param job a handle returned by trial_mdp_async
+//'
+//' @return a list: "state" ("queued", "running", "done", "failed" or "cancelled") and "progress" (the fraction of states solved).
+// [[Rcpp::export]]
+List trial_mdp_job_status(SEXP job) {
+  SolveJob* solve_job = job_from_handle(job);
+  return List::create(Named("state") = SolveJob::state_name(solve_job->get_state()),
+                      Named("progress") = solve_job->progress());
+}
+
+
+//' Wait for a background trial design solve
+//'
+//' Wait until the job finishes (successfully or not), or until the timeout. The wait can be interrupted from the console.
+//'
+//' @param job a handle returned by trial_mdp_async
+//' @param timeout the longest wait, in seconds; negative means no limit. Default=-1
+//'
+//' @return TRUE if the job has finished.
+// [[Rcpp::export]]
+bool trial_mdp_job_wait(SEXP job, double timeout=-1.0) {
+  SolveJob* solve_job = job_from_handle(job);
+  double waited = 0.0;
+  while(timeout < 0.0 || waited < timeout){
+    double slice = (timeout < 0.0) ? 0.1 : std::min(0.1, timeout - waited);
+    if(solve_job->wait(slice)){
+      return true;
+    }
+    waited += slice;
+    checkUserInterrupt();
+  }
+  return solve_job->wait(0.0);
+}
+
+
+//' Cancel a background trial design solve
+//'
+//' A queued job is cancelled at once; a running one stops shortly.
+//'
+//' @param job a handle returned by trial_mdp_async
+//'
+//' @return None.
+// [[Rcpp::export]]
+void trial_mdp_job_cancel(SEXP job) {
+  job_from_handle(job)->cancel();
+}
+
+
+//' Get the design computed by a background solve
+//'
+//' @param job a handle returned by trial_mdp_async, whose state is "done"
+//'
+//' @return a design handle, as returned by trial_mdp(..., return_handle=TRUE); see trial_mdp_lookup, trial_mdp_columns and trial_mdp_save.
+// [[Rcpp::export]]
+SEXP trial_mdp_job_result(SEXP job) {
+  SolveJob* solve_job = job_from_handle(job);
+  TrialMDP* solver = solve_job->get_solver();
+  if(solver == NULL){
+    stop("the job is " + SolveJob::state_name(solve_job->get_state()) + ", not done");
+  }
+  // The job owns the solver; the design handle keeps the job alive
+  XPtr<TrialMDP> design = XPtr<TrialMDP>(solver, false, R_NilValue, job);
+  design.attr("class") = "trial_mdp_design";
+  return design;
+}
+
+
+//' Estimate the cost of a trial design solve
+//'
+//' Count the work trial_mdp would do with these parameters, without doing it: the number of states, actions and transitions at each level, the solver's peak memory and the size of its SQLite output, and (after timing a small solve of a similar problem on this machine) its running time. Use it to choose parameters (and a machine) before a long solve.
+//'
+//' @param n_patients the number of patients in the trial
+//' @param failure_cost parameter representing the cost of patient failures
+//' @param block_cost parameter representing the cost of each additional trial stage
+//' @param min_size minimum size for a trial stage. Default=4
+//' @param block_incr require trial stage sizes to be multiples of this number. Default=2
+//' @param prior_a0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_a1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param transition_dist name of transition probability distribution. Default="beta_binom"
+//' @param test_statistic name of test statistic for which to optimize. Default="scaled_cmh"
+//' @param act_l smallest allocation fraction to treatment A. Default=0.2
+//' @param act_u largest allocation fraction to treatment A. Default=0.8
+//' @param act_n number of possible allocation fractions. Default=7
+//' @param memory_budget_gb if > 0, the memory available to the solve (in GB); see "backend" below. Default=0
+//' @param calibrate if TRUE, time a small solve (about a second) to predict the running time. Default=TRUE
+//' @param backup order of the Bellman backups, as for trial_mdp (action-major backups keep a dense copy of every level's values). Default="state_major"
+//' @param coarse_factor as for trial_mdp (the coarse solution stays in memory through the solve). Default=1
+//' @param n_processes as for trial_mdp (a sharded solve's levels are shared by its worker processes while they run). Default=1
+//'
+//' @return a list: "levels", a data.frame with each level's number of patients, states, actions per state and transitions; and "summary", a list of totals, the predicted memory (GB), SQLite file size (GB) and seconds, and "backend": "in_memory" if the solve fits the memory budget, or "none" if it doesn't (consider trial_mdp_approx or trial_mdp_mcts instead). The running time ignores action pruning and the epsilon and act_search options, which only make the solve faster.
+// [[Rcpp::export]]
+List trial_mdp_plan(int n_patients,
+                    float failure_cost, float block_cost,
+                    int min_size=4,
+                    int block_incr=2,
+                    float prior_a0 = 1.0,
+                    float prior_a1 = 1.0,
+                    float prior_b0 = 1.0,
+                    float prior_b1 = 1.0,
+                    std::string transition_dist="beta_binom",
+                    std::string test_statistic="scaled_cmh",
+                    float act_l=0.2, float act_u=0.8, int act_n=7,
+                    double memory_budget_gb=0.0,
+                    bool calibrate=true,
+                    std::string backup="state_major",
+                    int coarse_factor=1,
+                    int n_processes=1) {
+
+  int n_attr = ResultInterpreter(test_statistic, failure_cost, block_cost, n_patients).get_n_attr();
+  SolveEstimate est = estimate_solve(n_patients, min_size, block_incr,
+                                     act_l, act_u, act_n, n_attr,
+                                     backup, coarse_factor, n_processes);
+  if(calibrate){
+    est.ns_per_transition = calibrate_solve(failure_cost, block_cost,
+                                            min_size, block_incr,
+                                            prior_a0, prior_a1, prior_b0, prior_b1,
+                                            transition_dist, test_statistic,
+                                            act_l, act_u, act_n);
+    est.seconds = est.ns_per_transition * est.n_transitions * 1e-9;
+  }
+
+  int n_levels = est.levels.size();
+  IntegerVector n_total(n_levels), n_actions(n_levels);
+  NumericVector n_states(n_levels), n_transitions(n_levels);
+  for(int i = 0; i < n_levels; ++i){
+    n_total[i] = est.levels[i].n_total;
+    n_states[i] = est.levels[i].n_states;
+    n_actions[i] = est.levels[i].n_actions;
+    n_transitions[i] = est.levels[i].n_transitions;
+  }
+
+  double memory_gb = est.memory_bytes / 1e9;
+  std::string backend = "in_memory";
+  if(memory_budget_gb > 0.0 && memory_gb > memory_budget_gb){
+    backend = "none";
+    std::cout << "The solve needs about " << memory_gb << " GB; more than the budget of "
+              << memory_budget_gb << " GB." << std::endl;
+  }
+
+  List summary = List::create(Named("states") = double(est.n_states),
+                              Named("state_actions") = double(est.n_state_actions),
+                              Named("transitions") = double(est.n_transitions),
+                              Named("memory_gb") = memory_gb,
+                              Named("sqlite_gb") = est.sqlite_bytes / 1e9,
+                              Named("ns_per_transition") = calibrate ? est.ns_per_transition : NA_REAL,
+                              Named("seconds") = calibrate ? est.seconds : NA_REAL,
+                              Named("backend") = backend);
+  DataFrame levels = DataFrame::create(Named("NPatients") = n_total,
+                                       Named("States") = n_states,
+                                       Named("Actions") = n_actions,
+                                       Named("Transitions") = n_transitions);
+  return List::create(Named("levels") = levels, Named("summary") = summary);
+}
+
+
+//' Compute exact operating characteristics of a trial design
+//'
+//' Given a trial design SQLite database and a set of "true" response rates, compute the exact probability of rejecting the null hypothesis p_A = p_B, along with the expected number of patients, failures, and stages. This is computed by propagating probability forward through the design; there is no Monte Carlo error. The null hypothesis is rejected when the Wald (chi-square) statistic of the final contingency table exceeds the 1-alpha quantile of a chi-square(1) distribution.
+//'
+//' @param sqlite_fname path to trial design SQLite database (or compact policy file; see trial_mdp_compact)
+//' @param p_a vector of true response rates for treatment A (one per scenario)
+//' @param p_b vector of true response rates for treatment B (one per scenario)
+//' @param alpha significance level of the final test. Default=0.05
+//'
+//' @return a data.frame with one row per scenario. When p_a = p_b, "RejectProb" is the type-I error; otherwise it is the power.
+// [[Rcpp::export]]
+DataFrame trial_mdp_oc(std::string sqlite_fname,
+                       NumericVector p_a, NumericVector p_b,
+                       float alpha=0.05) {
+
+  if(p_a.size() != p_b.size()){
+    stop("p_a and p_b must have the same length");
+  }
+
+  TablePtr policy(load_policy_table(sqlite_fname));
+
+  float crit_value = R::qchisq(1.0 - alpha, 1.0, 1, 0);
+  OperatingCharacteristics oc = OperatingCharacteristics(*policy, crit_value);
+  std::vector<OCResult> res = oc.compute(std::vector<float>(p_a.begin(), p_a.end()),
+                                         std::vector<float>(p_b.begin(), p_b.end()));
+  policy.reset();
+
+  NumericVector reject_prob(res.size());
+  NumericVector expected_n_a(res.size());
+  NumericVector expected_n_b(res.size());
+  NumericVector expected_failures(res.size());
+  NumericVector expected_stages(res.size());
+  for(unsigned int i = 0; i < res.size(); ++i){
+    reject_prob[i] = res[i].reject_prob;
+    expected_n_a[i] = res[i].expected_n_a;
+    expected_n_b[i] = res[i].expected_n_b;
+    expected_failures[i] = res[i].expected_failures;
+    expected_stages[i] = res[i].expected_stages;
+  }
+
+  return DataFrame::create(Named("p_a") = p_a,
+                           Named("p_b") = p_b,
+                           Named("RejectProb") = reject_prob,
+                           Named("ExpectedNA") = expected_n_a,
+                           Named("ExpectedNB") = expected_n_b,
+                           Named("ExpectedFailures") = expected_failures,
+                           Named("ExpectedStages") = expected_stages);
+}
+
+
+//' Simulate trials under a trial design
+//'
+//' Simulate many trials that follow the design stored in a trial design SQLite database, under "true" response rates p_a and p_b. The simulation runs natively on multiple threads. Trial i always uses random stream i, so results for a given seed don't depend on the number of threads. At the end of each trial we apply (i) the Wald (chi-square) test to the final contingency table and (ii) the Cochran-Mantel-Haenszel test, stratified by stage.
+//'
+//' @param sqlite_fname path to trial design SQLite database (or compact policy file; see trial_mdp_compact)
+//' @param p_a true response rate for treatment A
+//' @param p_b true response rate for treatment B
+//' @param n_trials number of trials to simulate. Default=10000
+//' @param n_threads number of threads. Default=0 (use all available cores)
+//' @param seed random seed. Default=1
+//' @param alpha significance level of the final tests. Default=0.05
+//' @param return_traces if TRUE, also return the outcome of every simulated trial. Default=FALSE
+//'
+//' @return a list containing a one-row data.frame of summary statistics ("summary") and, if requested, a data.frame with one row per trial ("traces").
+// [[Rcpp::export]]
+List trial_mdp_simulate(std::string sqlite_fname,
+                        float p_a, float p_b,
+                        int n_trials=10000,
+                        int n_threads=0,
+                        int seed=1,
+                        float alpha=0.05,
+                        bool return_traces=false) {
+
+  TablePtr policy(load_policy_table(sqlite_fname));
+
+  float crit_value = R::qchisq(1.0 - alpha, 1.0, 1, 0);
+  TrialSimulator sim = TrialSimulator(*policy, crit_value, n_threads);
+
+  std::vector<SimTrace> traces;
+  SimSummary s = sim.simulate(p_a, p_b, n_trials, seed,
+                              return_traces ? &traces : NULL);
+  policy.reset();
+
+  DataFrame summary = DataFrame::create(Named("NTrials") = s.n_trials,
+                                        Named("RejectWald") = s.reject_wald,
+                                        Named("RejectCMH") = s.reject_cmh,
+                                        Named("MeanNA") = s.mean_n_a,
+                                        Named("MeanNB") = s.mean_n_b,
+                                        Named("MeanFailures") = s.mean_failures,
+                                        Named("MeanStages") = s.mean_stages,
+                                        Named("SdNA") = s.sd_n_a,
+                                        Named("SdFailures") = s.sd_failures,
+                                        Named("SdStages") = s.sd_stages);
+  if(!return_traces){
+    return List::create(Named("summary") = summary);
+  }
+
+  IntegerVector a0(traces.size()), a1(traces.size()), b0(traces.size()), b1(traces.size());
+  IntegerVector n_stages(traces.size());
+  NumericVector wald(traces.size()), cmh(traces.size());
+  for(unsigned int i = 0; i < traces.size(); ++i){
+    a0[i] = traces[i].final_table.a0;
+    a1[i] = traces[i].final_table.a1;
+    b0[i] = traces[i].final_table.b0;
+    b1[i] = traces[i].final_table.b1;
+    n_stages[i] = traces[i].n_stages;
+    wald[i] = traces[i].wald_stat;
+    cmh[i] = traces[i].cmh_stat;
+  }
+  DataFrame trace_df = DataFrame::create(Named("A0") = a0, Named("A1") = a1,
+                                         Named("B0") = b0, Named("B1") = b1,
+                                         Named("Stages") = n_stages,
+                                         Named("Wald") = wald,
+                                         Named("CMH") = cmh);
+
+  return List::create(Named("summary") = summary,
+                      Named("traces") = trace_df);
+}
+
+
+//' Evaluate an existing trial design under new costs
+//'
+//' Load the policy (BlockSize and AAllocation for each state) from a trial design SQLite database (or compact policy file) and compute its expected values under the given costs and test statistic, without re-optimizing the policy. Save the results to a new SQLite database. This is much faster than a full solve. The table sizes implied by n_patients, min_size and block_incr must match those of the original design.
+//'
+//' @param policy_fname path to the SQLite database of the trial design to evaluate (or compact policy file; see trial_mdp_compact)
+//' @param n_patients the number of patients in the trial
+//' @param failure_cost parameter representing the cost of patient failures
+//' @param block_cost parameter representing the cost of each additional trial stage
+//' @param sqlite_fname output filepath for the evaluated design's SQLite database
+//' @param min_size minimum size for a trial stage. Default=4
+//' @param block_incr require trial stage sizes to be multiples of this number. Default=2
+//' @param prior_a0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_a1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param transition_dist name of transition probability distribution. Default="beta_binom". We do not recommend changing this.
+//' @param test_statistic name of test statistic. Default="scaled_cmh". We do not recommend changing this.
+//'
+//' @return None. The evaluated design is written to disk.
+// [[Rcpp::export]]
+void trial_mdp_evaluate(std::string policy_fname,
+                        int n_patients,
+                        float failure_cost, float block_cost,
+                        std::string sqlite_fname,
+                        int min_size=4,
+                        int block_incr=2,
+                        float prior_a0 = 1.0,
+                        float prior_a1 = 1.0,
+                        float prior_b0 = 1.0,
+                        float prior_b1 = 1.0,
+                        std::string transition_dist="beta_binom",
+                        std::string test_statistic="scaled_cmh") {
+
+  TablePtr policy(load_policy_table(policy_fname));
+
+  // The allocation fractions play no role when
+  // the policy is fixed
+  TrialMDP solver = TrialMDP(n_patients,
+                             failure_cost, block_cost,
+                             min_size, block_incr,
+                             prior_a0, prior_a1,
+                             prior_b0, prior_b1,
+                             transition_dist,
+                             test_statistic);
+
+  std::cout << "Evaluating policy from: " << policy_fname << std::endl;
+  std::cout << "\tFailure cost: " << failure_cost << std::endl; 
+  std::cout << "\tBlock cost: " << block_cost << std::endl; 
+  std::cout << "\tTest statistic: " << test_statistic << std::endl; 
+
+  solver.evaluate(*policy);
+  std::cout << "Evaluation completed." << std::endl;
+  policy.reset();
+
+  std::vector<char> fname(sqlite_fname.begin(), sqlite_fname.end());
+  fname.push_back('\0');
+  try{
+    solver.to_sqlite(&fname[0], 10000);
+  }
+  catch(int code){
+    stop("couldn't save the design to " + sqlite_fname);
+  }
   std::cout << "Saved to file: " << sqlite_fname << std::endl;
-  
-  delete[] fname;
-  
 }
 
 
+//' Compute an approximate trial design, for large trials
+//'
+//' Aggregate each stage's contingency tables onto a grid of posterior summaries (arm A's sample size, and each arm's posterior mean success rate), and solve the dynamic program on that grid, interpolating between grid points. The cost grows with the grid, rather than with the cube of the number of patients. The design is saved in the same format as trial_mdp's, but contains only the grid's representative tables.
+//'
+//' @param n_patients the number of patients in the trial
+//' @param failure_cost parameter representing the cost of patient failures
+//' @param block_cost parameter representing the cost of each additional trial stage
+//' @param sqlite_fname output filepath for the trial design's SQLite database
+//' @param min_size minimum size for a trial stage. Default=4
+//' @param block_incr require trial stage sizes to be multiples of this number. Default=2
+//' @param prior_a0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_a1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param transition_dist name of transition probability distribution. Default="beta_binom". We do not recommend changing this.
+//' @param test_statistic name of test statistic for which to optimize. Default="scaled_cmh". We do not recommend changing this.
+//' @param act_l smallest allocation fraction to treatment A. Default=0.2
+//' @param act_u largest allocation fraction to treatment A. Default=0.8
+//' @param act_n number of possible allocation fractions, uniformly spaced. Default=7
+//' @param grid_n number of grid points for arm A's sample size, in each stage. Default=21
+//' @param grid_p number of grid points for each arm's posterior mean. Default=21
+//' @param epsilon if > 0, ignore each arm's least likely outcomes (holding epsilon of the probability mass) in every block. Default=0
+//' @param exact_fname optional path to an exact design (from trial_mdp) for the same problem. If given, report how closely the approximation agrees with it. Default=""
+//'
+//' @return None. Trial design is written to disk.
+// [[Rcpp::export]]
+void trial_mdp_approx(int n_patients,
+                      float failure_cost, float block_cost,
+                      std::string sqlite_fname,
+                      int min_size=4,
+                      int block_incr=2,
+                      float prior_a0 = 1.0,
+                      float prior_a1 = 1.0,
+                      float prior_b0 = 1.0,
+                      float prior_b1 = 1.0,
+                      std::string transition_dist="beta_binom",
+                      std::string test_statistic="scaled_cmh",
+                      float act_l=0.2, float act_u=0.8, int act_n=7,
+                      int grid_n=21, int grid_p=21,
+                      float epsilon=0.0,
+                      std::string exact_fname="") {
+
+  ApproxTrialMDP solver = ApproxTrialMDP(n_patients,
+                                         failure_cost, block_cost,
+                                         min_size, block_incr,
+                                         prior_a0, prior_a1,
+                                         prior_b0, prior_b1,
+                                         transition_dist,
+                                         test_statistic,
+                                         act_l, act_u, act_n,
+                                         grid_n, grid_p);
+  solver.set_epsilon(epsilon);
+
+  std::cout << "Approximate solver initialized." << std::endl;
+  std::cout << "\tN patients: " << n_patients << std::endl; 
+  std::cout << "\tGrid: " << grid_n << " sample sizes x " << grid_p << " x " << grid_p << " posterior means" << std::endl;
+  std::cout << "Solving." << std::endl;
+
+  solver.solve();
+  std::cout << "Solver completed." << std::endl;
+
+  if(exact_fname != ""){
+    TrialMDPTable* exact = TrialMDPTable::from_sqlite(exact_fname);
+    ApproxValidation v = solver.validate(*exact);
+    exact->release();
+    delete exact;
+
+    std::cout << "Compared with exact design: " << exact_fname << std::endl;
+    std::cout << "\tStates compared: " << v.n_states << std::endl;
+    std::cout << "\tSame action: " << 100.0*v.action_agreement << "%" << std::endl;
+    std::cout << "\tTotalReward error: max " << v.max_reward_error 
+              << ", mean " << v.mean_reward_error 
+              << ", first move " << v.first_move_error << std::endl;
+  }
+
+  std::vector<char> fname(sqlite_fname.begin(), sqlite_fname.end());
+  fname.push_back('\0');
+  try{
+    solver.to_sqlite(&fname[0], 10000);
+  }
+  catch(int code){
+    stop("couldn't save the design to " + sqlite_fname);
+  }
+  std::cout << "Saved to file: " << sqlite_fname << std::endl;
+}
+
+
+//' Find the optimal next stage from an interim state
+//'
+//' Solve only the states reachable from the given contingency table, and return its optimal next stage. This is much faster than a full solve, late in a trial. The table's number of patients needn't be one the design planned for (e.g., after dropouts, or an over-enrolled stage).
+//'
+//' @param n_patients the number of patients in the trial
+//' @param failure_cost parameter representing the cost of patient failures
+//' @param block_cost parameter representing the cost of each additional trial stage
+//' @param a0 failures so far in treatment A
+//' @param a1 successes so far in treatment A
+//' @param b0 failures so far in treatment B
+//' @param b1 successes so far in treatment B
+//' @param min_size minimum size for a trial stage. Default=4
+//' @param block_incr require trial stage sizes to be multiples of this number. Default=2
+//' @param prior_a0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_a1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param transition_dist name of transition probability distribution. Default="beta_binom". We do not recommend changing this.
+//' @param test_statistic name of test statistic for which to optimize. Default="scaled_cmh". We do not recommend changing this.
+//' @param act_l smallest allocation fraction to treatment A. Default=0.2
+//' @param act_u largest allocation fraction to treatment A. Default=0.8
+//' @param act_n number of possible allocation fractions, uniformly spaced. Default=7
+//' @param sqlite_fname optional filepath; if given, every state solved along the way is saved there (in the same format as trial_mdp's output) for later queries. Default=""
+//'
+//' @return A one-row data frame, with the same columns as fetch_result.
+// [[Rcpp::export]]
+DataFrame trial_mdp_solve_from(int n_patients,
+                               float failure_cost, float block_cost,
+                               int a0, int a1, int b0, int b1,
+                               int min_size=4,
+                               int block_incr=2,
+                               float prior_a0 = 1.0,
+                               float prior_a1 = 1.0,
+                               float prior_b0 = 1.0,
+                               float prior_b1 = 1.0,
+                               std::string transition_dist="beta_binom",
+                               std::string test_statistic="scaled_cmh",
+                               float act_l=0.2, float act_u=0.8, int act_n=7,
+                               std::string sqlite_fname="") {
+
+  TrialMDP solver = TrialMDP(n_patients,
+                             failure_cost, block_cost,
+                             min_size, block_incr,
+                             prior_a0, prior_a1,
+                             prior_b0, prior_b1,
+                             transition_dist,
+                             test_statistic,
+                             act_l, act_u, act_n);
+
+  if(!ct_counts_fit(a0, a1, b0, b1)){
+    stop("a0, a1, b0 and b1 must be nonnegative, with at most " + std::to_string(CT_MAX_COUNT) + " patients in all");
+  }
+  StateResult res = solver.solve_from(ContingencyTable(a0, a1, b0, b1), sqlite_fname != "");
+
+  List columns = List::create(Named("A0") = a0, Named("A1") = a1,
+                              Named("B0") = b0, Named("B1") = b1,
+                              Named("BlockSize") = res.block_size,
+                              Named("AAllocation") = res.a_allocation);
+  std::vector<std::string> names = solver.get_attr_names();
+  for(unsigned int i = 0; i < names.size(); ++i){
+    columns[names[i]] = res.values[i];
+  }
+
+  if(sqlite_fname != ""){
+    std::vector<char> fname(sqlite_fname.begin(), sqlite_fname.end());
+    fname.push_back('\0');
+    try{
+      solver.to_sqlite(&fname[0], 10000);
+    }
+    catch(int code){
+      stop("couldn't save the design to " + sqlite_fname);
+    }
+    std::cout << "Saved to file: " << sqlite_fname << std::endl;
+  }
+
+  return DataFrame(columns);
+}
+
+
+//' Plan the next stage by Monte Carlo tree search
+//'
+//' An anytime alternative to trial_mdp_solve_from, for trials too large to solve exactly. Starting from the given contingency table, search for the best next stage by Monte Carlo tree search (UCT) for a fixed amount of wall-clock time, on multiple threads. Each iteration samples a trial's outcomes from the transition distribution, and finishes the trial with one last stage favoring the arm that looks better; so the estimated rewards are (noisy, somewhat conservative) estimates of the optimal TotalReward. With one thread and max_iter > 0, results for a given seed are reproducible.
+//'
+//' @param n_patients the number of patients in the trial
+//' @param failure_cost parameter representing the cost of patient failures
+//' @param block_cost parameter representing the cost of each additional trial stage
+//' @param a0 failures so far in treatment A
+//' @param a1 successes so far in treatment A
+//' @param b0 failures so far in treatment B
+//' @param b1 successes so far in treatment B
+//' @param seconds wall-clock time budget. Default=5
+//' @param n_threads number of threads. Default=0 (use all available cores)
+//' @param seed random seed. Default=1
+//' @param max_iter if positive, stop after this many iterations (with seconds <= 0, run until then). Default=0
+//' @param exploration UCB exploration constant, relative to the range of observed rewards. Default=0.1
+//' @param min_size minimum size for a trial stage. Default=4
+//' @param block_incr require trial stage sizes to be multiples of this number. Default=2
+//' @param prior_a0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_a1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b0 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param prior_b1 smoothing/pseudocount hyperparameter for computing transition probabilities. Default=1.0
+//' @param transition_dist name of transition probability distribution. Default="beta_binom". We do not recommend changing this.
+//' @param test_statistic name of test statistic for which to optimize. Default="scaled_cmh". We do not recommend changing this.
+//' @param act_l smallest allocation fraction to treatment A. Default=0.2
+//' @param act_u largest allocation fraction to treatment A. Default=0.8
+//' @param act_n number of possible allocation fractions, uniformly spaced. Default=7
+//'
+//' @return a list containing a one-row data.frame with the recommended (most visited) stage, its estimated TotalReward with a standard error and 95 percent confidence interval, and search statistics ("recommendation"); and a data.frame with the search statistics of every candidate stage ("actions").
+// [[Rcpp::export]]
+List trial_mdp_mcts(int n_patients,
+                    float failure_cost, float block_cost,
+                    int a0, int a1, int b0, int b1,
+                    double seconds=5.0,
+                    int n_threads=0,
+                    int seed=1,
+                    double max_iter=0,
+                    float exploration=0.1,
+                    int min_size=4,
+                    int block_incr=2,
+                    float prior_a0 = 1.0,
+                    float prior_a1 = 1.0,
+                    float prior_b0 = 1.0,
+                    float prior_b1 = 1.0,
+                    std::string transition_dist="beta_binom",
+                    std::string test_statistic="scaled_cmh",
+                    float act_l=0.2, float act_u=0.8, int act_n=7) {
+
+  MCTSPlanner planner(n_patients,
+                      failure_cost, block_cost,
+                      min_size, block_incr,
+                      prior_a0, prior_a1,
+                      prior_b0, prior_b1,
+                      transition_dist,
+                      test_statistic,
+                      act_l, act_u, act_n);
+  planner.set_exploration(exploration);
+
+  if(!ct_counts_fit(a0, a1, b0, b1)){
+    stop("a0, a1, b0 and b1 must be nonnegative, with at most " + std::to_string(CT_MAX_COUNT) + " patients in all");
+  }
+  MCTSResult res = planner.plan(ContingencyTable(a0, a1, b0, b1), seconds,
+                                n_threads, seed, long(max_iter));
+
+  DataFrame recommendation = DataFrame::create(Named("A0") = a0, Named("A1") = a1,
+                                               Named("B0") = b0, Named("B1") = b1,
+                                               Named("BlockSize") = res.block_size,
+                                               Named("AAllocation") = res.a_allocation,
+                                               Named("TotalReward") = res.mean_reward,
+                                               Named("StdErr") = res.std_err,
+                                               Named("CILower") = res.mean_reward - 1.96*res.std_err,
+                                               Named("CIUpper") = res.mean_reward + 1.96*res.std_err,
+                                               Named("Iterations") = res.n_iterations,
+                                               Named("Nodes") = res.n_nodes,
+                                               Named("Threads") = res.n_threads,
+                                               Named("Seconds") = res.seconds);
+
+  IntegerVector block_size(res.actions.size()), a_allocation(res.actions.size());
+  NumericVector visits(res.actions.size()), reward(res.actions.size()), std_err(res.actions.size());
+  for(unsigned int k = 0; k < res.actions.size(); ++k){
+    block_size[k] = res.actions[k].block_size;
+    a_allocation[k] = res.actions[k].a_allocation;
+    visits[k] = res.actions[k].visits;
+    reward[k] = res.actions[k].mean_reward;
+    std_err[k] = res.actions[k].std_err;
+  }
+  DataFrame actions = DataFrame::create(Named("BlockSize") = block_size,
+                                        Named("AAllocation") = a_allocation,
+                                        Named("Visits") = visits,
+                                        Named("TotalReward") = reward,
+                                        Named("StdErr") = std_err);
+
+  return List::create(Named("recommendation") = recommendation,
+                      Named("actions") = actions);
+}
+
+
+//' Save a trial design in a compact binary format
+//'
+//' Convert a trial design SQLite database into a much smaller binary file, for shipping to systems with little storage or for holding many designs in memory. Each state's action takes 1-2 bytes (an index into a per-level dictionary of actions), stored in rank order and run-length coded in blocks, so any state can still be looked up directly (see trial_mdp_compact_lookup). The expected values can be kept as 8- or 16-bit codes (linear over each level's range), kept exactly, or dropped. trial_mdp_oc and trial_mdp_simulate accept the compact file in place of the database.
+//'
+//' @param sqlite_fname path to trial design SQLite database
+//' @param compact_fname output filepath for the compact design
+//' @param value_bits bits per stored expected value: 0 (drop them), 8, 16, or 32 (exact). Default=16
+//'
+//' @return None. The compact design is written to disk.
+// [[Rcpp::export]]
+void trial_mdp_compact(std::string sqlite_fname, std::string compact_fname,
+                       int value_bits=16) {
+
+  std::vector<std::string> names;
+  TrialMDPTable* table = TrialMDPTable::from_sqlite(sqlite_fname, &names);
+
+  CompactPolicy policy = CompactPolicy(*table, names, value_bits);
+  table->release();
+  delete table;
+
+  policy.save(compact_fname);
+  std::cout << "Saved to file: " << compact_fname << " (" << policy.size_bytes() << " bytes)" << std::endl;
+}
+
+
+//' Look up states in a compact trial design
+//'
+//' Random access into a design saved by trial_mdp_compact, for many states at once. States missing from the design get NA actions; a BlockSize of 0 means the trial is over.
+//'
+//' @param compact_fname path to the compact design
+//' @param a0 failures in treatment A (one per state)
+//' @param a1 successes in treatment A
+//' @param b0 failures in treatment B
+//' @param b1 successes in treatment B
+//'
+//' @return a data.frame with one row per state: the table, its action, and its (decoded) expected values.
+// [[Rcpp::export]]
+DataFrame trial_mdp_compact_lookup(std::string compact_fname,
+                                   IntegerVector a0, IntegerVector a1,
+                                   IntegerVector b0, IntegerVector b1) {
+
+  int n = a0.size();
+  if(a1.size() != n || b0.size() != n || b1.size() != n){
+    stop("a0, a1, b0 and b1 must have the same length");
+  }
+
+  CompactPolicy* policy = CompactPolicy::load(compact_fname);
+  std::vector<std::string> names = policy->get_attr_names();
+
+  IntegerVector block_size(n), a_allocation(n);
+  std::vector<NumericVector> values;
+  for(unsigned int i = 0; i < names.size(); ++i){
+    values.push_back(NumericVector(n));
+  }
+  for(int k = 0; k < n; ++k){
+    ContingencyTable ct = ContingencyTable(a0[k], a1[k], b0[k], b1[k]);
+    bool fits = ct_counts_fit(a0[k], a1[k], b0[k], b1[k]);
+    int bs, aa;
+    if(fits && policy->lookup(ct, bs, aa)){
+      block_size[k] = bs;
+      a_allocation[k] = aa;
+    }else{
+      block_size[k] = NA_INTEGER;
+      a_allocation[k] = NA_INTEGER;
+    }
+    for(unsigned int i = 0; i < names.size(); ++i){
+      float v = fits ? policy->value(ct, i) : NAN;
+      values[i][k] = std::isnan(v) ? NA_REAL : v;
+    }
+  }
+  delete policy;
+
+  List columns = List::create(Named("A0") = a0, Named("A1") = a1,
+                              Named("B0") = b0, Named("B1") = b1,
+                              Named("BlockSize") = block_size,
+                              Named("AAllocation") = a_allocation);
+  for(unsigned int i = 0; i < names.size(); ++i){
+    columns[names[i]] = values[i];
+  }
+  return DataFrame(columns);
+}
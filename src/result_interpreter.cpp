@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <cstdio>
 
 ResultInterpreter::ResultInterpreter(std::string test_statistic,
                                      float failure_cost,
@@ -98,6 +99,28 @@ void ResultInterpreter::compute_lookaheads(ContingencyTable& current_state,
 }
 
 
+void ResultInterpreter::lookahead_bounds(ContingencyTable& current_state,
+                                         int a_A, int a_B,
+                                         float mean_n_A, float mean_n_B,
+                                         std::vector<float>& lo,
+                                         std::vector<float>& hi){
+    for(unsigned int i=0; i < lookahead_rules.size(); ++i){
+        (*(lookahead_rules[i])).increment_bounds(lo, hi, current_state, a_A, a_B, 
+                                                 mean_n_A, mean_n_B, i); 
+    }
+}
+
+
+void ResultInterpreter::lookahead_range(ContingencyTable& current_state,
+                                        int a_A, int a_B,
+                                        std::vector<float>& lo,
+                                        std::vector<float>& hi){
+    for(unsigned int i=0; i < lookahead_rules.size(); ++i){
+        (*(lookahead_rules[i])).increment_range(lo, hi, current_state, a_A, a_B, i); 
+    }
+}
+
+
 void ResultInterpreter::clear_lookaheads(){
     for(unsigned int i=0; i < lookahead_rules.size(); ++i){
         lookahead_values[i] = 0.0;
@@ -133,7 +156,7 @@ std::string ResultInterpreter::pretty_print_result(StateResult& res){
 }
 
 
-std::string ResultInterpreter::sql_create_table(){
+std::string ResultInterpreter::sql_create_table(bool reach_prob){
 
     std::string query = "CREATE TABLE RESULTS("\
     "A0 INT, A1 INT, B0 INT, B1 INT, "\
@@ -142,13 +165,17 @@ std::string ResultInterpreter::sql_create_table(){
     for(unsigned int i=0; i < n_attr; ++i){ 
         query += attr_names[i] + " REAL, "; 
     }
+    if(reach_prob){
+        query += "ReachProb REAL, ";
+    }
     query += "PRIMARY KEY (A0, A1, B0, B1));";
 
     return query;    
 }
 
 
-std::string ResultInterpreter::sql_insert_tuple(StateResult& res, ContingencyTable& ct){
+std::string ResultInterpreter::sql_insert_tuple(StateResult& res, ContingencyTable& ct,
+                                                const double* reach_prob){
 
     std::string query = "INSERT INTO RESULTS VALUES (";
     query += std::to_string(ct.a0) + ", ";  
@@ -162,6 +189,12 @@ std::string ResultInterpreter::sql_insert_tuple(StateResult& res, ContingencyTab
         query += fl_to_str(res.values[i]) + ", ";
     }
     query += fl_to_str(res.values[n_attr-1]);
+    if(reach_prob != NULL){
+        // (full precision: most of these are tiny)
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", *reach_prob);
+        query += std::string(", ") + buf;
+    }
     query += ");\n";
  
     return query;
@@ -57,8 +57,10 @@ class ResultInterpreter{
         std::string pretty_print_result(StateResult& res);
 
         // Functions for saving results to a SQLite database
-        std::string sql_create_table();
-        std::string sql_insert_tuple(StateResult& res, ContingencyTable& ct);
+        // (optionally with a ReachProb column)
+        std::string sql_create_table(bool reach_prob=false);
+        std::string sql_insert_tuple(StateResult& res, ContingencyTable& ct,
+                                     const double* reach_prob=NULL);
 
         // These functions encode how we compute results for
         // this state from the results of a future state; 
@@ -68,6 +70,17 @@ class ResultInterpreter{
         void clear_lookaheads();
         float look_ahead(int idx);
 
+        // Bounds on the expected change in each attribute between
+        // the current state and the next, under the action (a_A, a_B),
+        // given the expected numbers of successes in each arm
+        void lookahead_bounds(ContingencyTable& current_state, int a_A, int a_B,
+                              float mean_n_A, float mean_n_B,
+                              std::vector<float>& lo, std::vector<float>& hi);
+
+        // Bounds on that change, over every possible outcome
+        void lookahead_range(ContingencyTable& current_state, int a_A, int a_B,
+                             std::vector<float>& lo, std::vector<float>& hi);
+
 };
 
 #endif
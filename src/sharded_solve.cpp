@@ -0,0 +1,414 @@
+// sharded_solve.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the multi-process solve.
+
+#include "sharded_solve.h"
+#include "trial_mdp_table.h"
+#include "state_result.h"
+#include "contingency_table.h"
+#include "contingency_iterator.h"
+#include "level_bounds.h"
+#include "solve_job.h"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <new>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+
+////////////////////////////////
+// NUMA topology
+////////////////////////////////
+
+// Parse a CPU list like "0-63,128-191"
+static std::vector<int> parse_cpulist(std::string list){
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        size_t dash = item.find('-');
+        int lo = std::atoi(item.substr(0, dash).c_str());
+        int hi = (dash == std::string::npos) ? lo : std::atoi(item.substr(dash + 1).c_str());
+        for(int c=lo; c <= hi; ++c){
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+
+std::vector< std::vector<int> > numa_nodes(){
+
+    std::vector< std::vector<int> > nodes;
+    for(int k=0; ; ++k){
+        std::ifstream f(("/sys/devices/system/node/node" + std::to_string(k) + "/cpulist").c_str());
+        if(!f){
+            break;
+        }
+        std::string list;
+        std::getline(f, list);
+        std::vector<int> cpus = parse_cpulist(list);
+        // (Skip memory-only nodes)
+        if(!cpus.empty()){
+            nodes.push_back(cpus);
+        }
+    }
+    if(nodes.empty()){
+        nodes.push_back(std::vector<int>());
+    }
+    return nodes;
+}
+
+
+static void pin_to_cpus(const std::vector<int>& cpus){
+#ifdef __linux__
+    if(cpus.empty()){
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(unsigned int i=0; i < cpus.size(); ++i){
+        if(cpus[i] < CPU_SETSIZE){
+            CPU_SET(cpus[i], &set);
+        }
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+
+
+////////////////////////////////
+// Shared memory
+////////////////////////////////
+
+// A barrier for processes (spinning, then sleeping)
+struct ShardBarrier{
+    std::atomic<int> waiting;
+    std::atomic<int> generation;
+};
+
+static void barrier_wait(ShardBarrier* barrier, int n){
+    int gen = barrier->generation.load();
+    if(barrier->waiting.fetch_add(1) == n - 1){
+        barrier->waiting.store(0);
+        barrier->generation.fetch_add(1);
+        return;
+    }
+    int spins = 0;
+    while(barrier->generation.load() == gen){
+        if(++spins > 1000){
+            usleep(50);
+        }
+    }
+}
+
+// What the workers share besides the levels: the barrier,
+// each worker's error bound for each level, its counts, and
+// the sparse tables of each level's bounds (see LevelBounds;
+// empty if the solve doesn't prune)
+struct ShardShared{
+    ShardBarrier* barrier;
+    float* level_error;
+    SolveCounts* counts;
+    std::vector<float*> bounds;
+};
+
+static void* map_shared(size_t n_bytes){
+    void* ptr = mmap(NULL, std::max(n_bytes, size_t(1)), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+// The bytes of a dense level: records, then their values
+static size_t level_bytes(int64_t n_states, int n_attr){
+    return n_states*(sizeof(StateResult) + n_attr*sizeof(float));
+}
+
+// The bytes of a level's bounds
+static size_t bounds_bytes(int n){
+    return LevelBounds::table_size(n)*sizeof(float);
+}
+
+// Give back the whole pages in [begin, end) of a shared
+// mapping (it reads as zeros afterward)
+static void free_pages(char* begin, char* end){
+#ifdef MADV_REMOVE
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t lo = ((uintptr_t(begin) + page - 1)/page)*page;
+    uintptr_t hi = (uintptr_t(end)/page)*page;
+    if(hi > lo){
+        madvise((void*) lo, hi - lo, MADV_REMOVE);
+    }
+#endif
+}
+
+
+////////////////////////////////
+// Workers
+////////////////////////////////
+
+static int64_t shard_begin(int64_t n_states, int worker, int n_workers){
+    return (n_states * worker) / n_workers;
+}
+
+
+static void run_worker(TrialMDP& solver, int worker, int n_workers,
+                       const std::vector<int>& cpus,
+                       std::vector<StateResult*>& levels, ShardShared& shared){
+
+    pin_to_cpus(cpus);
+
+    TrialMDPTable& table = solver.get_results_table();
+    std::vector<int>& n_vec = table.get_n_vec();
+    int n_levels = n_vec.size();
+    int n_attr = solver.get_attr_names().size();
+
+    // Touch this worker's shard of every level first
+    for(int idx=0; idx < n_levels; ++idx){
+        int64_t n_states = n_tables(n_vec[idx]);
+        float* arena = (float*) (levels[idx] + n_states);
+        int64_t lo = shard_begin(n_states, worker, n_workers);
+        int64_t hi = shard_begin(n_states, worker + 1, n_workers);
+        for(int64_t rank=lo; rank < hi; ++rank){
+            StateResult* rec = new (&levels[idx][rank]) StateResult();
+            rec->n_values = n_attr;
+            rec->values = arena + rank*n_attr;
+            for(int i=0; i < n_attr; ++i){
+                rec->values[i] = 0.0;
+            }
+        }
+    }
+    barrier_wait(shared.barrier, n_workers);
+
+    solver.begin_levels();
+    for(int idx=n_levels-1; idx >= 0; --idx){
+        int64_t n_states = n_tables(n_vec[idx]);
+        int64_t lo = shard_begin(n_states, worker, n_workers);
+        int64_t hi = shard_begin(n_states, worker + 1, n_workers);
+        solver.solve_level(idx, lo, hi);
+        shared.level_error[worker*n_levels + idx] = solver.get_level_error(idx);
+
+        barrier_wait(shared.barrier, n_workers);
+
+        float error = 0.0;
+        for(int w=0; w < n_workers; ++w){
+            error = std::max(error, shared.level_error[w*n_levels + idx]);
+        }
+        if(shared.bounds.empty()){
+            solver.finish_level(idx, error);
+            continue;
+        }
+
+        // One copy of the level's bounds, for every worker: each
+        // enters its shard's rewards, then builds some of the rows
+        LevelBounds bounds = LevelBounds(n_vec[idx], shared.bounds[idx]);
+        for(ContingencyIterator it(n_vec[idx], lo, hi); it.in_range(); it.advance()){
+            bounds.set(it.value(), levels[idx][it.get_rank()].values[n_attr - 1]);
+        }
+        barrier_wait(shared.barrier, n_workers);
+        bounds.build_rows(worker, n_workers);
+        barrier_wait(shared.barrier, n_workers);
+        solver.finish_level(idx, error, &bounds);
+    }
+    shared.counts[worker] = solver.get_counts();
+}
+
+
+// Stop the remaining workers
+static void kill_workers(std::vector<pid_t>& pids){
+    for(unsigned int w=0; w < pids.size(); ++w){
+        if(pids[w] > 0){
+            kill(pids[w], SIGKILL);
+            waitpid(pids[w], NULL, 0);
+            pids[w] = 0;
+        }
+    }
+}
+
+
+////////////////////////////////
+// Coordinator
+////////////////////////////////
+
+void solve_sharded(TrialMDP& solver, int n_workers, SolveControl* control){
+
+    // A child of a process with other busy threads could find 
+    // a lock (e.g., malloc's) held forever
+    if(solve_queue().busy()){
+        std::cerr << "`solve_sharded`: can't start worker processes while background solves are running." << std::endl;
+        throw 1;
+    }
+
+    std::vector< std::vector<int> > nodes = numa_nodes();
+    if(n_workers <= 0){
+        n_workers = nodes.size();
+    }
+
+    TrialMDPTable& table = solver.get_results_table();
+    std::vector<int> n_vec = table.get_n_vec();
+    int n_levels = n_vec.size();
+    int n_attr = solver.get_attr_names().size();
+
+    // (The workers' backups are state-major, whatever the
+    //  solver was set to; so pruning applies to them)
+    solver.set_backup_order("state_major");
+
+    // Map the levels and their bounds (untouched, so the
+    // workers place them) and the shared state
+    std::vector<StateResult*> levels(n_levels, (StateResult*) NULL);
+    ShardShared shared;
+    if(solver.needs_level_bounds()){
+        shared.bounds = std::vector<float*>(n_levels, (float*) NULL);
+    }
+    size_t shared_bytes = sizeof(ShardBarrier) + sizeof(SolveCounts)*n_workers
+                          + sizeof(float)*n_workers*n_levels;
+    void* shared_mem = map_shared(shared_bytes);
+    bool mapped = (shared_mem != NULL);
+    for(int idx=0; idx < n_levels && mapped; ++idx){
+        levels[idx] = (StateResult*) map_shared(level_bytes(n_tables(n_vec[idx]), n_attr));
+        mapped = (levels[idx] != NULL);
+        if(mapped && !shared.bounds.empty()){
+            shared.bounds[idx] = (float*) map_shared(bounds_bytes(n_vec[idx]));
+            mapped = (shared.bounds[idx] != NULL);
+        }
+    }
+    if(!mapped){
+        std::cerr << "`solve_sharded`: couldn't map the shared levels." << std::endl;
+        for(int idx=0; idx < n_levels; ++idx){
+            if(levels[idx] != NULL){
+                munmap(levels[idx], level_bytes(n_tables(n_vec[idx]), n_attr));
+            }
+            if(!shared.bounds.empty() && shared.bounds[idx] != NULL){
+                munmap(shared.bounds[idx], bounds_bytes(n_vec[idx]));
+            }
+        }
+        if(shared_mem != NULL){
+            munmap(shared_mem, shared_bytes);
+        }
+        throw 1;
+    }
+    shared.barrier = new (shared_mem) ShardBarrier();
+    shared.barrier->waiting = 0;
+    shared.barrier->generation = 0;
+    shared.counts = (SolveCounts*) ((char*) shared_mem + sizeof(ShardBarrier));
+    shared.level_error = (float*) (shared.counts + n_workers);
+
+    for(int idx=0; idx < n_levels; ++idx){
+        table.set_dense(idx, levels[idx]);
+    }
+
+    std::cout << "Sharded solve: " << n_workers << " worker processes on "
+              << nodes.size() << " NUMA node(s)" << std::endl;
+    // (Don't let the workers inherit unwritten output)
+    std::cout.flush();
+    std::cerr.flush();
+
+    std::vector<pid_t> pids(n_workers, 0);
+    bool failed = false;
+    for(int w=0; w < n_workers && !failed; ++w){
+        pid_t pid = fork();
+        if(pid == 0){
+            int status = 0;
+            try{
+                run_worker(solver, w, n_workers, nodes[w % nodes.size()], levels, shared);
+            }
+            catch(...){
+                status = 1;
+            }
+            std::cout.flush();
+            _exit(status);
+        }
+        if(pid < 0){
+            std::cerr << "`solve_sharded`: couldn't start worker " << w << "." << std::endl;
+            failed = true;
+        }
+        pids[w] = pid;
+    }
+
+    // Wait for the workers; if one fails (or the
+    // solve is cancelled), stop the others
+    int n_running = 0;
+    for(int w=0; w < n_workers; ++w){
+        if(pids[w] > 0){
+            n_running++;
+        }
+    }
+    bool cancelled = false;
+    while(n_running > 0 && !failed && !cancelled){
+        for(int w=0; w < n_workers; ++w){
+            int status;
+            if(pids[w] <= 0 || waitpid(pids[w], &status, WNOHANG) == 0){
+                continue;
+            }
+            pids[w] = 0;
+            n_running--;
+            if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+                std::cerr << "`solve_sharded`: worker " << w << " failed." << std::endl;
+                failed = true;
+            }
+        }
+        if(control != NULL && control->interrupted != NULL && control->interrupted()){
+            control->cancel = true;
+        }
+        if(control != NULL && control->cancel.load()){
+            cancelled = true;
+        }
+        if(n_running > 0){
+            usleep(10000);
+        }
+    }
+    kill_workers(pids);
+    for(unsigned int idx=0; idx < shared.bounds.size(); ++idx){
+        munmap(shared.bounds[idx], bounds_bytes(n_vec[idx]));
+    }
+
+    // Keep the solution (in the coordinator's own memory).
+    // Each chunk of a level's pages is given back once it's 
+    // copied, so the peak is about the hash maps alone.
+    if(!failed && !cancelled){
+        solver.begin_levels();
+        for(int w=0; w < n_workers; ++w){
+            solver.add_counts(shared.counts[w]);
+        }
+    }
+    const int64_t chunk = 1 << 16;
+    for(int idx=n_levels-1; idx >= 0; --idx){
+        int64_t n_states = n_tables(n_vec[idx]);
+        if(!failed && !cancelled){
+            float error = 0.0;
+            for(int w=0; w < n_workers; ++w){
+                error = std::max(error, shared.level_error[w*n_levels + idx]);
+            }
+            solver.set_level_error(idx, error);
+            float* arena = (float*) (levels[idx] + n_states);
+            for(int64_t lo=0; lo < n_states; lo += chunk){
+                int64_t hi = std::min(lo + chunk, n_states);
+                table.copy_dense(idx, lo, hi);
+                free_pages((char*) (levels[idx] + lo), (char*) (levels[idx] + hi));
+                free_pages((char*) (arena + lo*n_attr), (char*) (arena + hi*n_attr));
+            }
+        }
+        table.set_dense(idx, NULL);
+        munmap(levels[idx], level_bytes(n_tables(n_vec[idx]), n_attr));
+    }
+    munmap(shared_mem, shared_bytes);
+
+    if(cancelled){
+        throw TRIAL_MDP_CANCELLED;
+    }
+    if(failed){
+        throw 1;
+    }
+    solver.end_levels();
+}
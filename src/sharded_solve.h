@@ -0,0 +1,44 @@
+// sharded_solve.h
+// (c) 2021-03 David Merrell
+//
+// Solve a TrialMDP with several worker processes, for machines
+// with many sockets: one process's threads and allocator stop
+// scaling once they're spread across NUMA nodes.
+//
+// The coordinator maps every level of the results table into
+// shared memory, densely (one StateResult per table, in rank
+// order; see TrialMDPTable::set_dense), and forks the workers.
+// Each worker is pinned to one NUMA node's CPUs, and owns a
+// contiguous shard of every level's ranks; it touches its shard
+// first, so the shard's pages live on its own node. The workers
+// solve the levels from last to first, meeting at a barrier (in
+// shared memory) after each one; they read successor levels
+// from every shard. When the solve prunes actions, the workers
+// also share one copy of each level's bounds (see LevelBounds),
+// which they build together. Finally the coordinator copies the
+// levels into its own results table, giving back each part of a
+// level once it's copied, so saving and querying the solution
+// work as they do after TrialMDP::solve.
+//
+// The solution is the same as TrialMDP::solve's.
+
+#ifndef _SHARDED_SOLVE_H
+#define _SHARDED_SOLVE_H
+
+#include "trial_mdp.h"
+#include <vector>
+
+// The CPUs of each NUMA node (from /sys/devices/system/node).
+// A single node with no CPUs listed if there's no NUMA information.
+std::vector< std::vector<int> > numa_nodes();
+
+// Solve with n_workers processes (0 for one per NUMA node),
+// in place of solver.solve(). The solver's backups become
+// state-major (see TrialMDP::set_backup_order). If `control` 
+// is set, cancelling it (or its `interrupted` returning true)
+// stops the workers, throwing TRIAL_MDP_CANCELLED.
+// Throws if a worker fails, or if the process's SolveQueue
+// is busy (forking it then isn't safe).
+void solve_sharded(TrialMDP& solver, int n_workers, SolveControl* control=NULL);
+
+#endif
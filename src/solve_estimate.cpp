@@ -0,0 +1,144 @@
+// solve_estimate.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the solve cost estimates.
+
+#include "solve_estimate.h"
+#include "trial_mdp.h"
+#include "trial_mdp_table.h"
+#include "action_iterator.h"
+#include "contingency_table.h"
+#include "level_bounds.h"
+#include "state_result.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+// The calibration solve's size (in transitions)
+#define CALIBRATION_TRANSITIONS 5e6
+
+
+SolveEstimate estimate_solve(int n_patients, int min_size, int block_incr,
+                             float act_l, float act_u, int act_n, int n_attr,
+                             std::string backup, int coarse_factor, int n_processes){
+
+    SolveEstimate est;
+    est.n_states = 0;
+    est.n_state_actions = 0;
+    est.n_transitions = 0;
+
+    std::vector<int> n_vec = build_n_vec(n_patients, min_size, block_incr);
+    ActionIterator action_iterator = ActionIterator(act_l, act_u, act_n, n_vec, min_size, 0);
+
+    for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+        LevelEstimate lev;
+        lev.n_total = n_vec[idx];
+        lev.n_states = n_tables(n_vec[idx]);
+        lev.n_actions = 0;
+        lev.n_transitions = 0;
+
+        // (The last level is terminal)
+        if(idx + 1 < n_vec.size()){
+            std::vector<BlockAction> actions = action_iterator.all_actions(idx);
+            lev.n_actions = actions.size();
+            int64_t per_state = 0;
+            for(unsigned int i = 0; i < actions.size(); ++i){
+                per_state += int64_t(actions[i].a_A + 1) * (actions[i].a_B + 1);
+            }
+            lev.n_transitions = per_state * lev.n_states;
+        }
+
+        est.n_states += lev.n_states;
+        est.n_state_actions += lev.n_states * lev.n_actions;
+        est.n_transitions += lev.n_transitions;
+        est.levels.push_back(lev);
+    }
+
+    // A hash map node per table, and its values array
+    // (rounded up to the allocator's 16-byte chunks)
+    double values_bytes = 16.0 * ((4*n_attr + 8 + 15) / 16);
+    est.table_bytes = est.n_states * (ESTIMATE_MAP_OVERHEAD + values_bytes);
+    est.sqlite_bytes = est.n_states * ESTIMATE_SQLITE_ROW;
+
+    // The range maxima of every level, and of those that level 0's
+    // actions (at least min_size patients) can reach; and the
+    // levels as dense arrays of records and values
+    double bounds_bytes = 0.0;
+    double reachable_bounds_bytes = 0.0;
+    double dense_bytes = 0.0;
+    for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+        double b = LevelBounds::table_size(n_vec[idx]) * double(sizeof(float));
+        bounds_bytes += b;
+        if(n_vec[idx] - n_vec[0] >= min_size){
+            reachable_bounds_bytes += b;
+        }
+        dense_bytes += est.levels[idx].n_states * double(sizeof(StateResult) + n_attr*sizeof(float));
+    }
+
+    if(n_processes != 1){
+        // (Sharded solves are state-major.) The workers share the
+        // dense levels and every level's range maxima; the table
+        // is filled as they're freed.
+        est.memory_bytes = std::max(dense_bytes + bounds_bytes, est.table_bytes);
+    }else if(backup == "state_major"){
+        est.memory_bytes = est.table_bytes + reachable_bounds_bytes;
+    }else{
+        est.memory_bytes = est.table_bytes + est.n_states * double(n_attr*sizeof(float));
+    }
+
+    // The coarse solve comes first, and its table
+    // stays in memory until the solve is done
+    if(coarse_factor > 1){
+        SolveEstimate coarse = estimate_solve(n_patients, min_size, coarse_factor*block_incr,
+                                              act_l, act_u, act_n, n_attr);
+        est.memory_bytes = std::max(coarse.memory_bytes, coarse.table_bytes + est.memory_bytes);
+    }
+
+    est.ns_per_transition = 0.0;
+    est.seconds = 0.0;
+    return est;
+}
+
+
+double calibrate_solve(float failure_cost, float block_cost,
+                       int min_size, int block_incr,
+                       float prior_a0, float prior_a1,
+                       float prior_b0, float prior_b1,
+                       std::string transition_dist,
+                       std::string test_statistic,
+                       float act_l, float act_u, int act_n){
+
+    // The largest problem within the calibration budget
+    // (but with at least two stages)
+    int n_attr = ResultInterpreter(test_statistic, failure_cost, block_cost, 2*min_size).get_n_attr();
+    int n_cal = 2*min_size;
+    while(estimate_solve(n_cal + block_incr, min_size, block_incr,
+                         act_l, act_u, act_n, n_attr).n_transitions < CALIBRATION_TRANSITIONS){
+        n_cal += block_incr;
+    }
+    SolveEstimate est = estimate_solve(n_cal, min_size, block_incr, act_l, act_u, act_n, n_attr);
+
+    TrialMDP solver = TrialMDP(n_cal, failure_cost, block_cost,
+                               min_size, block_incr,
+                               prior_a0, prior_a1, prior_b0, prior_b1,
+                               transition_dist, test_statistic,
+                               act_l, act_u, act_n);
+
+    // (Keep the solver's report out of the way)
+    std::streambuf* cout_buf = std::cout.rdbuf();
+    std::ostringstream quiet;
+    std::cout.rdbuf(quiet.rdbuf());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try{
+        solver.solve();
+    }
+    catch(int code){
+        std::cout.rdbuf(cout_buf);
+        throw code;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::cout.rdbuf(cout_buf);
+
+    return ns / est.n_transitions;
+}
@@ -0,0 +1,84 @@
+// solve_estimate.h
+// (c) 2021-03 David Merrell
+//
+// What will a solve cost? Before committing a machine for hours,
+// count the work TrialMDP::solve would do, without doing it:
+//
+//   * every level (see build_n_vec) holds all C(n+3,3) tables
+//     of its size n (see n_tables);
+//   * every table of a level considers the level's actions
+//     (see ActionIterator::all_actions);
+//   * an action allocating (a_A, a_B) patients has
+//     (a_A + 1)(a_B + 1) outcomes, each a transition.
+//
+// The solver keeps every level's results in memory (one hash
+// map entry per table, see TrialMDPTable), so its peak memory
+// follows from the state count, plus what each kind of solve
+// keeps beside it: the range maxima of the levels that actions
+// can still reach, for pruning (state-major backups; see
+// LevelBounds); a dense copy of every level's values
+// (action-major and factored backups); the coarse solution
+// (coarse_factor > 1); or, for a sharded solve, the dense levels
+// and range maxima the worker processes share, which are freed
+// as the solution is copied out. The time follows from the
+// transition count, given a per-machine cost per transition:
+// `calibrate_solve` measures it by timing a small solve of a
+// similar problem. (Action pruning skips some transitions; the
+// calibration solve prunes too, so the estimate accounts for it
+// roughly.)
+
+#ifndef _SOLVE_ESTIMATE_H
+#define _SOLVE_ESTIMATE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Approximate sizes (bytes) of a stored table
+// with the default allocator, and of its SQLite row
+#define ESTIMATE_MAP_OVERHEAD 100.0
+#define ESTIMATE_SQLITE_ROW 64.0
+
+struct LevelEstimate{
+    int n_total;
+    int64_t n_states;
+    int n_actions;
+    int64_t n_transitions;
+};
+
+struct SolveEstimate{
+    std::vector<LevelEstimate> levels;
+    int64_t n_states;
+    int64_t n_state_actions;
+    int64_t n_transitions;
+
+    // Peak memory of the solve (bytes), that of its results
+    // table alone, and size of the full SQLite export
+    double memory_bytes;
+    double table_bytes;
+    double sqlite_bytes;
+
+    // Per-transition cost (from calibrate_solve;
+    // 0 if not calibrated) and predicted run time
+    double ns_per_transition;
+    double seconds;
+};
+
+// (backup, coarse_factor, n_processes: as for trial_mdp)
+SolveEstimate estimate_solve(int n_patients, int min_size, int block_incr,
+                             float act_l, float act_u, int act_n, int n_attr,
+                             std::string backup="state_major",
+                             int coarse_factor=1, int n_processes=1);
+
+// Time a small solve of a problem with the same costs, priors,
+// test statistic and allocations; return its time per transition
+// (in nanoseconds)
+double calibrate_solve(float failure_cost, float block_cost,
+                       int min_size, int block_incr,
+                       float prior_a0, float prior_a1,
+                       float prior_b0, float prior_b1,
+                       std::string transition_dist,
+                       std::string test_statistic,
+                       float act_l, float act_u, int act_n);
+
+#endif
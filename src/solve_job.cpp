@@ -0,0 +1,212 @@
+// solve_job.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the SolveJob and SolveQueue classes.
+
+#include "solve_job.h"
+#include "contingency_table.h"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+
+////////////////////////////////
+// SolveJob
+////////////////////////////////
+
+SolveJob::SolveJob(TrialMDP* solver, std::string sqlite_fname,
+                   bool reachable_only, bool reach_prob){
+    this->solver = solver;
+    this->sqlite_fname = sqlite_fname;
+    this->reachable_only = reachable_only;
+    this->reach_prob = reach_prob;
+
+    solver->set_control(&control);
+    n_states = 0;
+    std::vector<int>& n_vec = solver->get_results_table().get_n_vec();
+    for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+        n_states += n_tables(n_vec[idx]);
+    }
+    state = JOB_QUEUED;
+}
+
+
+SolveJob::~SolveJob(){
+    delete solver;
+}
+
+
+void SolveJob::set_state(JobState s){
+    std::lock_guard<std::mutex> lock(state_mutex);
+    state = s;
+    state_changed.notify_all();
+}
+
+
+void SolveJob::run(){
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if(state != JOB_QUEUED){
+            return;
+        }
+        state = JOB_RUNNING;
+    }
+
+    try{
+        solver->solve();
+        if(control.cancel){
+            throw TRIAL_MDP_CANCELLED;
+        }
+        if(!sqlite_fname.empty()){
+            std::vector<char> fname(sqlite_fname.begin(), sqlite_fname.end());
+            fname.push_back('\0');
+            if(reachable_only){
+                solver->to_sqlite_reachable(&fname[0], 10000, reach_prob);
+            }else{
+                solver->to_sqlite(&fname[0], 10000);
+            }
+            std::cout << "Saved to file: " << sqlite_fname << std::endl;
+        }
+        set_state(JOB_DONE);
+    }
+    catch(int code){
+        set_state((code == TRIAL_MDP_CANCELLED) ? JOB_CANCELLED : JOB_FAILED);
+    }
+    catch(std::exception& e){
+        std::cerr << "`SolveJob`: " << e.what() << std::endl;
+        set_state(JOB_FAILED);
+    }
+}
+
+
+void SolveJob::cancel(){
+    control.cancel = true;
+    std::lock_guard<std::mutex> lock(state_mutex);
+    if(state == JOB_QUEUED){
+        state = JOB_CANCELLED;
+        state_changed.notify_all();
+    }
+}
+
+
+JobState SolveJob::get_state(){
+    std::lock_guard<std::mutex> lock(state_mutex);
+    return state;
+}
+
+
+std::string SolveJob::state_name(JobState s){
+    switch(s){
+        case JOB_QUEUED: return "queued";
+        case JOB_RUNNING: return "running";
+        case JOB_DONE: return "done";
+        case JOB_FAILED: return "failed";
+        case JOB_CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+
+double SolveJob::progress(){
+    if(get_state() == JOB_DONE){
+        return 1.0;
+    }
+    return double(control.n_solved) / n_states;
+}
+
+
+bool SolveJob::wait(double seconds){
+    std::unique_lock<std::mutex> lock(state_mutex);
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+        + std::chrono::microseconds(long(seconds * 1e6));
+    while(state == JOB_QUEUED || state == JOB_RUNNING){
+        if(state_changed.wait_until(lock, deadline) == std::cv_status::timeout){
+            return state != JOB_QUEUED && state != JOB_RUNNING;
+        }
+    }
+    return true;
+}
+
+
+TrialMDP* SolveJob::get_solver(){
+    return (get_state() == JOB_DONE) ? solver : NULL;
+}
+
+
+////////////////////////////////
+// SolveQueue
+////////////////////////////////
+
+void SolveQueue::work(){
+    while(true){
+        std::shared_ptr<SolveJob> job;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            while(pending.empty() && !stopping){
+                job_added.wait(lock);
+            }
+            if(stopping){
+                return;
+            }
+            job = pending.front();
+            pending.pop_front();
+            n_running++;
+        }
+        job->run();
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        n_running--;
+    }
+}
+
+
+bool SolveQueue::busy(){
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return n_running > 0 || !pending.empty();
+}
+
+
+void SolveQueue::submit(std::shared_ptr<SolveJob> job, int n_workers){
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    pending.push_back(job);
+
+    // (Forget the jobs nobody holds anymore)
+    std::vector< std::weak_ptr<SolveJob> > live;
+    for(unsigned int i = 0; i < submitted.size(); ++i){
+        if(!submitted[i].expired()){
+            live.push_back(submitted[i]);
+        }
+    }
+    live.push_back(job);
+    submitted.swap(live);
+
+    while(int(workers.size()) < n_workers){
+        workers.push_back(std::thread(&SolveQueue::work, this));
+    }
+    job_added.notify_one();
+}
+
+
+SolveQueue::~SolveQueue(){
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        for(unsigned int i = 0; i < submitted.size(); ++i){
+            std::shared_ptr<SolveJob> job = submitted[i].lock();
+            if(job){
+                job->cancel();
+            }
+        }
+        pending.clear();
+        job_added.notify_all();
+    }
+    for(unsigned int i = 0; i < workers.size(); ++i){
+        workers[i].join();
+    }
+}
+
+
+SolveQueue& solve_queue(){
+    static SolveQueue queue;
+    return queue;
+}
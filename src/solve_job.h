@@ -0,0 +1,109 @@
+// solve_job.h
+// (c) 2021-03 David Merrell
+//
+// Solves that run in the background.
+//
+// A SolveJob wraps a TrialMDP (set up, but not yet solved), and
+// what to do with the solution: save it to SQLite, or just keep it.
+// Jobs are queued in a SolveQueue, whose worker threads solve them
+// in order; meanwhile the caller can check a job's state and
+// progress, wait for it (with a timeout), or cancel it.
+//
+// Jobs are shared (std::shared_ptr) between the caller and the
+// queue, so a caller can drop a job at any time; a running job
+// is only deleted once its worker is done with it.
+
+#ifndef _SOLVE_JOB_H
+#define _SOLVE_JOB_H
+
+#include "trial_mdp.h"
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+enum JobState { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED, JOB_CANCELLED };
+
+class SolveJob{
+
+    private:
+        TrialMDP* solver;
+        std::string sqlite_fname;
+        bool reachable_only;
+        bool reach_prob;
+
+        SolveControl control;
+        int64_t n_states;
+
+        JobState state;
+        std::mutex state_mutex;
+        std::condition_variable state_changed;
+
+        void set_state(JobState s);
+
+    public:
+        // The job owns the solver. If sqlite_fname isn't
+        // empty, the solution is saved there.
+        SolveJob(TrialMDP* solver, std::string sqlite_fname,
+                 bool reachable_only, bool reach_prob);
+        ~SolveJob();
+
+        // Solve (and save); called by a worker thread
+        void run();
+
+        // A queued job is cancelled at once; a running
+        // one stops at its next state
+        void cancel();
+
+        JobState get_state();
+        static std::string state_name(JobState s);
+
+        // The fraction of states solved
+        double progress();
+
+        // Wait up to `seconds` for the job to finish
+        // (successfully or not); true if it has
+        bool wait(double seconds);
+
+        // The solved problem (NULL unless the job is done)
+        TrialMDP* get_solver();
+};
+
+
+class SolveQueue{
+
+    private:
+        std::deque< std::shared_ptr<SolveJob> > pending;
+        std::vector< std::weak_ptr<SolveJob> > submitted;
+        std::vector<std::thread> workers;
+        std::mutex queue_mutex;
+        std::condition_variable job_added;
+        bool stopping;
+        int n_running;
+
+        void work();
+
+    public:
+        SolveQueue(){ stopping = false; n_running = 0; }
+
+        // Cancels every unfinished job, and waits for the workers
+        ~SolveQueue();
+
+        // Queue a job. At most n_workers jobs run at once
+        // (the queue keeps every worker it has started).
+        void submit(std::shared_ptr<SolveJob> job, int n_workers);
+
+        // Whether a job is queued or running. (The idle workers
+        // wait for jobs without holding any lock, so it's safe
+        // to fork() unless the queue is busy.)
+        bool busy();
+};
+
+// The process's job queue
+SolveQueue& solve_queue();
+
+#endif
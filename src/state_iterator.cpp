@@ -14,7 +14,7 @@
 StateIterator::StateIterator(TrialMDPTable tab){
     n_vec = tab.get_n_vec();
     cur_idx = n_vec.size()-1;
-    cur_iter = new ContingencyIterator(n_vec[cur_idx]);
+    cur_iter = ContingencyIterator(n_vec[cur_idx]);
     cur_count = 1;
 }
 
@@ -22,7 +22,7 @@ StateIterator::StateIterator(TrialMDPTable tab){
 StateIterator::StateIterator(){
     n_vec = std::vector<int>();
     cur_idx = 0;
-    cur_iter = NULL;
+    cur_iter = ContingencyIterator();
     cur_count = 0;
 }
 
@@ -36,20 +36,19 @@ StateIterator::StateIterator(const StateIterator& other){
 
 
 ContingencyTable StateIterator::value(){
-    return cur_iter->value();
+    return cur_iter.value();
 }
 
 
 void StateIterator::advance(){
-    if(cur_iter->not_finished()){
-        cur_iter->advance();
+    if(cur_iter.not_finished()){
+        cur_iter.advance();
         cur_count++;
     }
     else{
         --cur_idx;
 	if (cur_idx >= 0){
-            delete cur_iter;
-            cur_iter = new ContingencyIterator(n_vec[cur_idx]);
+            cur_iter = ContingencyIterator(n_vec[cur_idx]);
             cur_count = 1;
 	}
     }
@@ -63,7 +62,3 @@ bool StateIterator::not_finished(){
     return (cur_idx >= 0);
 }	
 
-
-StateIterator::~StateIterator(){
-    delete cur_iter;
-}
@@ -20,7 +20,7 @@ class StateIterator{
     private:
         std::vector<int> n_vec;
         int cur_idx;
-        ContingencyIterator* cur_iter;
+        ContingencyIterator cur_iter;
 	int cur_count;
 
     public:
@@ -33,7 +33,6 @@ class StateIterator{
 	int get_cur_idx();
         void advance();
         bool not_finished();
-        ~StateIterator();	
 
 };
 
@@ -37,6 +37,10 @@ struct StateResult{
     }   
 
     StateResult& operator=(const StateResult& other){
+        if(this == &other){
+            return *this;
+        }
+        delete[] values;
         block_size = other.block_size;
         a_allocation = other.a_allocation;
         n_values = other.n_values;
@@ -59,7 +63,7 @@ struct StateResult{
 
 
     ~StateResult(){
-        delete values;
+        delete[] values;
     }
  
 };
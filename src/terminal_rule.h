@@ -25,6 +25,7 @@ class TerminalRule {
     public:
 
       TerminalRule(){ return; }
+      virtual ~TerminalRule(){}
 
       static TerminalRule* make_terminal_rule(std::string name, float f_cost);
 
@@ -32,6 +33,40 @@ class TerminalRule {
 };
 
 
+/**
+ * The Wald statistic for the test p_a = p_b, computed
+ * from a (terminal) contingency table.
+ */
+inline float wald_statistic(const ContingencyTable& ct){
+
+    // some useful row sums:
+    float N_a = ct.a0 + ct.a1;
+    float N_b = ct.b0 + ct.b1;
+    float N = N_a + N_b;
+    float p_a = 0.5;
+    if (N_a != 0.0){
+        p_a = float(ct.a1) / N_a;
+    } 
+    float p_b = 0.5;
+    if (N_b != 0.0){
+        p_b = float(ct.b1) / N_b;
+    }
+    float P = 0.5;
+    if (N != 0.0){
+        P = float(ct.a1 + ct.b1) / N;
+    }
+
+    float W = 0.0;
+    if (N_a == 0.0 || N_b == 0.0){
+        W = -std::numeric_limits<float>::infinity();
+    }
+    if (P != 0.0 && P != 1.0){
+        W = ( pow(p_a - p_b, 2.0) / (P * (1.0 - P)) ) * N_a*N_b / N;
+    }
+    return W;
+}
+
+
 /**
  * This reward has two parts:
  * (1) A Wald statistic for superiority test p_a > p_b
@@ -56,31 +91,8 @@ class WaldFailureTerminalRule : public TerminalRule {
 
       StateResult operator()(ResultInterpreter interp, ContingencyTable ct){
     
-          // some useful row sums:
-          float N_a = ct.a0 + ct.a1;
-          float N_b = ct.b0 + ct.b1;
-          float N = N_a + N_b;
-          float p_a = 0.5;
-          if (N_a != 0.0){
-              p_a = float(ct.a1) / N_a;
-          } 
-          float p_b = 0.5;
-          if (N_b != 0.0){
-              p_b = float(ct.b1) / N_b;
-          }
-          float P = 0.5;
-          if (N != 0.0){
-              P = float(ct.a1 + ct.b1) / N;
-          }
-
           // The Wald statistic
-          float W = 0.0;
-          if (N_a == 0.0 || N_b == 0.0){
-              W = -std::numeric_limits<float>::infinity();
-          }
-          if (P != 0.0 && P != 1.0){
-              W = ( pow(p_a - p_b, 2.0) / (P * (1.0 - P)) ) * N_a*N_b / N;
-          }
+          float W = wald_statistic(ct);
           // (is asymptotically chi-squared(df=1) under null hypothesis)
           // For now, just use the Wald statistic.
           // We probably ought to return a transformed quantity
@@ -4,42 +4,109 @@
 // Implementation of TransitionDist class
 // and its subclasses.
 
-#define __STDCPP_WANT_MATH_SPEC_FUNCS__ 1
-
 #include "transition_dist.h"
 #include "contingency_table.h"
 #include <cmath>
+#include <iostream>
 #include <string>
 
-//// If we're on __linux__, use the std::beta function
-//#ifdef __linux__
-//
-//float my_beta(float a, float b){
-//    return std::beta(a,b);
-//}
-//
-//// If we're on __APPLE__ or _WIN32, use the boost::math::beta function
-//// (which seems to be slower...)
-//#else
 
-#include <boost/math/special_functions/beta.hpp>
-float my_beta(float a, float b){
-    return boost::math::beta(a,b);
+////////////////////////////////
+// Tail truncation
+////////////////////////////////
+
+/**
+ * Find the shortest interval [lo, hi] around the mode holding 
+ * 1 - epsilon of the (unimodal) distribution's mass, by growing
+ * it toward the larger neighbor. Zero the probabilities outside 
+ * it, and rescale the rest to the original total.
+ * Returns the fraction of mass dropped.
+ */
+float truncate_probs(std::vector<float>& probs, float epsilon, int& lo, int& hi){
+
+    int N = probs.size();
+    float total = 0.0;
+    int mode = 0;
+    for(int i=0; i < N; ++i){
+        total += probs[i];
+        if(probs[i] > probs[mode]){
+            mode = i;
+        }
+    }
+
+    lo = mode;
+    hi = mode;
+    float kept = probs[mode];
+    while(kept < (1.0 - epsilon)*total && (lo > 0 || hi < N-1)){
+        if(hi == N-1 || (lo > 0 && probs[lo-1] >= probs[hi+1])){
+            lo--;
+            kept += probs[lo];
+        }else{
+            hi++;
+            kept += probs[hi];
+        }
+    }
+
+    if(kept <= 0.0 || hi - lo == N-1){
+        lo = 0;
+        hi = N-1;
+        return 0.0;
+    }
+
+    float scale = total / kept;
+    for(int i=0; i < N; ++i){
+        if(i < lo || i > hi){
+            probs[i] = 0.0;
+        }else{
+            probs[i] *= scale;
+        }
+    }
+    return 1.0 - kept/total;
 }
 
-//#endif 
+
+void TransitionDist::truncate_tails(){
+
+    a_lo = 0;
+    a_hi = a_probs.size() - 1;
+    b_lo = 0;
+    b_hi = b_probs.size() - 1;
+    dropped_mass = 0.0;
+    if(epsilon <= 0.0){
+        return;
+    }
+
+    float a_dropped = truncate_probs(a_probs, epsilon, a_lo, a_hi);
+    float b_dropped = truncate_probs(b_probs, epsilon, b_lo, b_hi);
+    dropped_mass = 1.0 - (1.0 - a_dropped)*(1.0 - b_dropped);
+}
 
 
 ////////////////////////////////
 // Beta distribution
 ////////////////////////////////
 
-float binom_coeff(int n, int k){
-    return 1.0/((n+1.0)*my_beta(n-k+1,k+1));
+// log B(a,b), in double precision. (Beta functions of a few
+// hundred patients' counts underflow a float.)
+double log_beta(double a, double b){
+    return std::lgamma(a) + std::lgamma(b) - std::lgamma(a + b);
+}
+
+double log_binom_coeff(int n, int k){
+    return -std::log(n + 1.0) - log_beta(n - k + 1, k + 1);
 }
 
+// (Skipping the terms with no counts: at p = 0 or 1,
+//  0*log(0) would make the probability NaN)
 float binom_prob(int N, float p, int x){
-    return binom_coeff(N,x) * pow(p,x) * pow(1.0 - p, N-x);
+    double log_prob = log_binom_coeff(N,x);
+    if(x > 0){
+        log_prob += x*std::log(double(p));
+    }
+    if(N - x > 0){
+        log_prob += (N-x)*std::log(1.0 - p);
+    }
+    return std::exp(log_prob);
 }
 
 std::vector<float> initialize_binom_probs(int N, float p){
@@ -59,19 +126,20 @@ BinomTransitionDist::BinomTransitionDist(float pr_a0, float pr_a1,
     prior_b1 = pr_b1;
 }
 
+std::vector<float> BinomTransitionDist::arm_probs(int n_0, int n_1, int size, bool arm_a){
+    // compute a smoothed point estimate
+    float pr_0 = arm_a ? prior_a0 : prior_b0;
+    float pr_1 = arm_a ? prior_a1 : prior_b1;
+    float p = (float(n_1) + pr_1) / (float(n_0 + n_1) + (pr_0 + pr_1));
+    return initialize_binom_probs(size, p);
+}
+
 void BinomTransitionDist::set_state_action(ContingencyTable ct, 
                                            short unsigned int a_size,
                                            short unsigned int b_size){
-    // compute smoothed point estimates
-    float a_smoothing = prior_a0 + prior_a1;
-    float b_smoothing = prior_b0 + prior_b1;
-
-    float p_a = (float(ct.a1) + prior_a1) / (float(ct.a0 + ct.a1) + a_smoothing);
-    a_probs = initialize_binom_probs(a_size, p_a);
-
-    float p_b = (float(ct.b1) + prior_b1) / (float(ct.b0 + ct.b1) + b_smoothing);
-    b_probs = initialize_binom_probs(b_size, p_b);
-
+    a_probs = arm_probs(ct.a0, ct.a1, a_size, true);
+    b_probs = arm_probs(ct.b0, ct.b1, b_size, false);
+    truncate_tails();
 }
 
 
@@ -80,7 +148,7 @@ void BinomTransitionDist::set_state_action(ContingencyTable ct,
 ////////////////////////////////
 
 float beta_binom_prob(int N, float pr_0, float pr_1, int x){
-    return binom_coeff(N,x) * my_beta(x+pr_1, N - x + pr_0) / my_beta(pr_1, pr_0);
+    return std::exp(log_binom_coeff(N,x) + log_beta(x+pr_1, N - x + pr_0) - log_beta(pr_1, pr_0));
 }
 
 
@@ -102,16 +170,19 @@ BetaBinomTransitionDist::BetaBinomTransitionDist(float pr_a0, float pr_a1,
 }
 
 
+std::vector<float> BetaBinomTransitionDist::arm_probs(int n_0, int n_1, int size, bool arm_a){
+    if(arm_a){
+        return initialize_beta_binom_probs(size, n_0 + prior_a0, n_1 + prior_a1);
+    }
+    return initialize_beta_binom_probs(size, n_0 + prior_b0, n_1 + prior_b1);
+}
+
 void BetaBinomTransitionDist::set_state_action(ContingencyTable ct, 
                                           short unsigned int size_a,
                                           short unsigned int size_b){
-    a_probs = initialize_beta_binom_probs(size_a, 
-                                          ct.a0 + prior_a0,
-                                          ct.a1 + prior_a1);
-
-    b_probs = initialize_beta_binom_probs(size_b, 
-                                          ct.b0 + prior_b0,
-                                          ct.b1 + prior_b1);
+    a_probs = arm_probs(ct.a0, ct.a1, size_a, true);
+    b_probs = arm_probs(ct.b0, ct.b1, size_b, false);
+    truncate_tails();
 }
 
 /////////////////////////////////
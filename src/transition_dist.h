@@ -9,12 +9,42 @@
 
 #include "contingency_table.h"
 #include <vector>
+#include <string>
+
+// Binomial(N, p) probabilities of 0, ..., N successes
+std::vector<float> initialize_binom_probs(int N, float p);
 
 class TransitionDist{
 
+    protected:
+        // Probabilities of each outcome in arms A and B,
+        // for the current state and action
+        std::vector<float> a_probs;
+        std::vector<float> b_probs;
+
+        // Tail truncation: each arm keeps only the outcomes
+        // [lo, hi] holding 1 - epsilon of its mass
+        float epsilon;
+        int a_lo;
+        int a_hi;
+        int b_lo;
+        int b_hi;
+        float dropped_mass;
+
+        // Call at the end of `set_state_action`
+        void truncate_tails();
+
     public:
         // empty constructor
-        TransitionDist(){ return; }
+        TransitionDist(){ 
+            epsilon = 0.0;
+            a_lo = 0;
+            a_hi = -1;
+            b_lo = 0;
+            b_hi = -1;
+            dropped_mass = 0.0;
+        }
+        virtual ~TransitionDist(){}
         
         // factory method
         static TransitionDist* make_transition_dist(std::string tr_dist_type,
@@ -22,10 +52,33 @@ class TransitionDist{
                                                     float pr_b0, float pr_b1);
         
         virtual float prob(int a, int b) = 0;
+
+        // The probabilities of 0, ..., size successes in one arm,
+        // given its failures and successes so far. (What
+        // set_state_action computes for each arm, before truncation.)
+        virtual std::vector<float> arm_probs(int n_0, int n_1, int size, bool arm_a) = 0;
         
         virtual void set_state_action(ContingencyTable state, 
                                       short unsigned int size_a,
                                       short unsigned int size_b) = 0;
+
+        // Marginal probabilities of a successes in arm A
+        // (resp. b successes in arm B)
+        float a_prob(int a){ return a_probs[a]; }
+        float b_prob(int b){ return b_probs[b]; }
+
+        // If epsilon > 0, drop each arm's tails: keep the shortest
+        // interval of outcomes around the mode holding 1 - epsilon 
+        // of the mass, and renormalize. (Default: epsilon = 0)
+        void set_epsilon(float eps){ epsilon = eps; }
+
+        // The outcomes kept in each arm, and the joint
+        // probability mass dropped for the current state and action
+        int a_lower(){ return a_lo; }
+        int a_upper(){ return a_hi; }
+        int b_lower(){ return b_lo; }
+        int b_upper(){ return b_hi; }
+        float get_dropped_mass(){ return dropped_mass; }
         
 
 };
@@ -40,9 +93,6 @@ class BinomTransitionDist : public TransitionDist{
         float prior_b0;
         float prior_b1;
 
-        std::vector<float> a_probs;
-        std::vector<float> b_probs;
-
     public:
         BinomTransitionDist(float pr_a0, float pr_a1,
                             float pr_b0, float pr_b1); 
@@ -53,6 +103,8 @@ class BinomTransitionDist : public TransitionDist{
         float prob(int a, int b){
             return a_probs[a]*b_probs[b];
         }
+
+        std::vector<float> arm_probs(int n_0, int n_1, int size, bool arm_a);
         
 };
 
@@ -64,9 +116,6 @@ class BetaBinomTransitionDist : public TransitionDist{
         float prior_a1;
         float prior_b0;
         float prior_b1;
-        
-        std::vector<float> a_probs;
-        std::vector<float> b_probs;
 
     public:
         BetaBinomTransitionDist(float pr_a0, float pr_a1,
@@ -79,6 +128,8 @@ class BetaBinomTransitionDist : public TransitionDist{
         float prob(int a, int b){
             return a_probs[a]*b_probs[b];
         }
+
+        std::vector<float> arm_probs(int n_0, int n_1, int size, bool arm_a);
 };
 
 #endif
@@ -20,31 +20,54 @@ TransitionIterator::TransitionIterator(ContingencyTable ct, int size_a, int size
     a_counter = 0;
     b_counter = 0;
 
+    a_first = 0;
+    a_last = size_a;
+    b_first = 0;
+    b_last = size_b;
+}
+
+
+TransitionIterator::TransitionIterator(ContingencyTable ct, int size_a, int size_b,
+                                       int a_lo, int a_hi, int b_lo, int b_hi){
+
+    cur_table = ct;
+
+    a_size = size_a;
+    b_size = size_b;
+
+    a_first = a_lo;
+    a_last = a_hi;
+    b_first = b_lo;
+    b_last = b_hi;
+
+    a_counter = a_first;
+    b_counter = b_first;
 }
 
 
 ContingencyTable TransitionIterator::value(){
-    short unsigned int a0 = cur_table.a0 + a_size - a_counter;
-    short unsigned int a1 = cur_table.a1 + a_counter;
-    short unsigned int b0 = cur_table.b0 + b_size - b_counter;
-    short unsigned int b1 = cur_table.b1 + b_counter;
+    // (In range as long as the trial is; see check_trial_size)
+    int a0 = cur_table.a0 + a_size - a_counter;
+    int a1 = cur_table.a1 + a_counter;
+    int b0 = cur_table.b0 + b_size - b_counter;
+    int b1 = cur_table.b1 + b_counter;
     return ContingencyTable(a0, a1, b0, b1);
 
 }
 
 
 bool TransitionIterator::not_finished(){
-    return (a_counter <= a_size);
+    return (a_counter <= a_last);
 }
 
 
 void TransitionIterator::advance(){
-    if (b_counter < b_size){
+    if (b_counter < b_last){
         b_counter++;
     }
     else{
         a_counter++;
-        b_counter = 0;
+        b_counter = b_first;
     }
 }
 
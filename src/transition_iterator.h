@@ -24,21 +24,31 @@ class TransitionIterator {
 
     private:
         ContingencyTable cur_table;
-	short unsigned int a_size;
-	short unsigned int b_size;
-	short unsigned int a_counter;
-	short unsigned int b_counter;
+        // (ints, so the counters can't wrap at CT_MAX_COUNT)
+	int a_size;
+	int b_size;
+	int a_counter;
+	int b_counter;
+        int a_first;
+        int a_last;
+        int b_first;
+        int b_last;
         TransitionDist* transition_distribution;
 
     public:
         TransitionIterator(ContingencyTable ct, int a_A, int a_B);
+
+        // Only yield outcomes with [a_lo, a_hi] successes in arm A
+        // and [b_lo, b_hi] in arm B
+        TransitionIterator(ContingencyTable ct, int a_A, int a_B,
+                           int a_lo, int a_hi, int b_lo, int b_hi);
 	float prob();
 	ContingencyTable value();
 	bool not_finished();
 	void advance();
 
-        short unsigned int get_a_counter(){ return a_counter; }
-        short unsigned int get_b_counter(){ return b_counter; }
+        int get_a_counter(){ return a_counter; }
+        int get_b_counter(){ return b_counter; }
 
 };
 
@@ -10,94 +10,656 @@
 #include "transition_dist.h"
 #include "state_iterator.h"
 #include "terminal_rule.h"
+#include "contingency_iterator.h"
 #include <iostream>
 #include <cstring>
 #include <string>
 #include <sqlite3.h>
 #include <cmath>
 #include <limits>
+#include <algorithm>
+#include <vector>
 
 
 
 /**
- * For a given state, find the action that maximizes
- * expected reward. Return the result (including the 
- * value of the maximized reward, and the terms of the
- * objective function)
+ * Compute the expected values (reward and the terms of the
+ * objective function) of taking action (a_A, a_B) in a given
+ * state, w.r.t. the randomness of the transition. The block
+ * leads to tables of size index result_size_idx. 
+ * If dist_ready, the transition distribution is already set 
+ * for this state and action.
  */
-StateResult TrialMDP::max_expected_reward(int cur_idx, ContingencyTable ct){
+void TrialMDP::expected_reward(int cur_idx, ContingencyTable ct,
+                               int result_size_idx, int a_A, int a_B,
+                               StateResult& expected_values,
+                               bool dist_ready){
+
+    float prob = 0.0;
+    // Initialize expected reward (and other values):
+    for (unsigned int i=0; i < n_attr; ++i){
+        expected_values.values[i] = 0.0;
+    }
+
+    if(!dist_ready){
+        transition_dist->set_state_action(ct, a_A, a_B);
+    }
+    // (Only the outcomes kept by tail truncation, if any)
+    TransitionIterator tr_it = TransitionIterator(ct, a_A, a_B,
+                                                  transition_dist->a_lower(), 
+                                                  transition_dist->a_upper(),
+                                                  transition_dist->b_lower(), 
+                                                  transition_dist->b_upper());
+    n_transitions += (a_A + 1)*(a_B + 1);
+    n_transitions_kept += (transition_dist->a_upper() - transition_dist->a_lower() + 1)
+                          *(transition_dist->b_upper() - transition_dist->b_lower() + 1);
+    while(tr_it.not_finished()){
+        
+        int n_A = tr_it.get_a_counter();
+        int n_B = tr_it.get_b_counter();
+
+        // Get the result struct associated with this state
+        StateResult tr_res = (*results_table)(result_size_idx, tr_it.value());
+
+        // Get the probability of this transition
+        // and update the expected values:
+        prob = transition_dist->prob(n_A, n_B);
+        result_interpreter.compute_lookaheads(ct, a_A, a_B, n_A, n_B, tr_res);
+        for(unsigned int i=0; i < n_attr; ++i){
+            expected_values.values[i] += (prob * result_interpreter.look_ahead(i));
+        } 
+        result_interpreter.clear_lookaheads();
+
+        tr_it.advance();
+    }
+}
+
+
+/**
+ * An upper bound on the expected reward of an action.
+ * For each outcome in arm A, the successor's reward is at most 
+ * the largest reward in its row of the next level; and the 
+ * lookahead rules bound the expected change in reward.
+ */
+float TrialMDP::action_reward_bound(int cur_idx, ContingencyTable& ct, BlockAction& act){
+
+    transition_dist->set_state_action(ct, act.a_A, act.a_B);
+    LevelBounds& next_bounds = level_bounds[act.next_size_idx];
+    int next_n_a = ct.a0 + ct.a1 + act.a_A;
+
+    float succ_bound = 0.0;
+    float mean_n_a = 0.0;
+    for(int n_A = 0; n_A <= act.a_A; ++n_A){
+        float p = transition_dist->a_prob(n_A);
+        if(p > 0.0){
+            mean_n_a += p*n_A;
+            succ_bound += p*next_bounds.row_max(next_n_a, ct.a1 + n_A, ct.b1, ct.b1 + act.a_B);
+        }
+    }
+    float mean_n_b = 0.0;
+    for(int n_B = 0; n_B <= act.a_B; ++n_B){
+        mean_n_b += transition_dist->b_prob(n_B)*n_B;
+    }
+
+    result_interpreter.lookahead_bounds(ct, act.a_A, act.a_B, mean_n_a, mean_n_b, inc_lo, inc_hi);
+    return succ_bound + inc_hi[n_attr - 1];
+}
+
+
+/**
+ * A bound on how far tail truncation can move an action's
+ * expected reward (call it while the transition distribution
+ * is set for this action). Dropping mass delta and renormalizing
+ * moves the expectation by at most delta times the range of the
+ * per-outcome reward; and the successors' own values may be off
+ * by their level's error bound.
+ */
+float TrialMDP::truncation_error(ContingencyTable& ct, BlockAction& act){
+
+    int rwd_idx = n_attr - 1;
+    float delta = transition_dist->get_dropped_mass();
+    float next_error = level_error[act.next_size_idx];
+    if(delta <= 0.0){
+        return next_error;
+    }
+
+    result_interpreter.lookahead_range(ct, act.a_A, act.a_B, inc_lo, inc_hi);
+    if(!std::isfinite(inc_lo[rwd_idx]) || !std::isfinite(inc_hi[rwd_idx])){
+        // (This action's reward is -infinity regardless)
+        return next_error;
+    }
+    float range = (level_max[act.next_size_idx] - level_min[act.next_size_idx])
+                  + (inc_hi[rwd_idx] - inc_lo[rwd_idx]);
+
+    return delta*range + next_error;
+}
+
+
+/**
+ * Evaluate one action and update the best choice.
+ * Returns the action's expected reward; or, if it was pruned,
+ * its upper bound. Callers that compare the returned values
+ * with something less than the best choice (see search_actions)
+ * pass that as prune_below: actions are pruned only if they
+ * can't beat it either.
+ */
+float TrialMDP::consider_action(int cur_idx, ContingencyTable& ct, BlockAction& act,
+                                StateResult& best_choice, int& best_order,
+                                StateResult& expected_values, float prune_below){
+
+    int rwd_idx = n_attr - 1;
+    n_actions_total++;
+
+    // Skip actions that can't beat the best one -- or the value
+    // the coarse solution guarantees for this state.
+    // (The tolerance absorbs rounding error in the expectations.
+    //  We always evaluate the first action, so that some action wins.)
+    bool dist_ready = false;
+    if(pruning_active() && best_order >= 0 && prune_below > -std::numeric_limits<float>::infinity()){
+        act.bound = action_reward_bound(cur_idx, ct, act);
+        dist_ready = true;
+        float incumbent = std::min(std::max(best_choice.values[rwd_idx], reward_floor), prune_below);
+        float tol = PRUNING_TOL * (1.0 + fabs(incumbent));
+        if(act.bound < incumbent - tol){
+            n_actions_pruned++;
+            if(epsilon > 0.0){
+                state_error = std::max(state_error, truncation_error(ct, act));
+            }
+            return act.bound;
+        }
+    }
+
+    // Compute the expected reward for this action,
+    // w.r.t. the randomness of the transition.
+    // (Computing the bound already set up the transition distribution)
+    expected_reward(cur_idx, ct, act.next_size_idx, act.a_A, act.a_B, 
+                    expected_values, dist_ready);
+    if(epsilon > 0.0){
+        state_error = std::max(state_error, truncation_error(ct, act));
+    }
+
+    // Compare expected reward vs. best_choice.
+    // (Among equally good actions, prefer the earliest in 
+    //  iteration order, regardless of evaluation order)
+    float rwd = expected_values.values[rwd_idx];
+    if (rwd > best_choice.values[rwd_idx] ||
+        (best_order >= 0 && rwd == best_choice.values[rwd_idx] && act.order < best_order)){
+
+        best_choice.block_size = act.block_size;
+        best_choice.a_allocation = act.a_A;
+        best_order = act.order;
+
+        for(unsigned int i=0; i < n_attr; ++i){
+            best_choice.values[i] = expected_values.values[i];
+        }
+    }
+    return rwd;
+}
+
+
+/**
+ * Search for the best action in a given state. 
+ * If `exhaustive`, consider every action; otherwise, 
+ * use the solver's action search strategy.
+ */
+StateResult TrialMDP::search_actions(int cur_idx, ContingencyTable ct, bool exhaustive){
 
     float FLOAT_NEG_INF = -std::numeric_limits<float>::infinity();
+    float FLOAT_NAN = std::numeric_limits<float>::quiet_NaN();
     int rwd_idx = n_attr - 1;
  
     // Track the best action we've seen thus far
     StateResult best_choice = StateResult(n_attr); 
     best_choice.values[rwd_idx] = FLOAT_NEG_INF;
+    int best_order = -1;
 
     // Use this StateResult to represent the expected
     // value of the current action
     StateResult expected_values = StateResult(n_attr);
 
-    // Iterate through the possible actions
-    action_iterator->reset(cur_idx);
-    while (action_iterator->not_finished()){
+    // (NaN marks actions we haven't considered yet)
+    std::vector<BlockAction> actions = action_iterator->all_actions(cur_idx);
+    std::vector<float> action_values = std::vector<float>(actions.size(), FLOAT_NAN);
 
-        // Get the size index of the resulting contingency table
-	int result_size_idx = action_iterator->get_next_size_idx();
-
-        float prob = 0.0;
-        // Initialize expected reward (and other values):
-        for (unsigned int i=0; i < n_attr; ++i){
-            expected_values.values[i] = 0.0;
+    // Try the hinted action (or the one nearest to it) first:
+    // the previous state's best action, or the coarse solution's.
+    // It usually wins, and gives a good incumbent.
+    int hint_k = -1;
+    int hint_dist = 0;
+    for(unsigned int k=0; k < actions.size(); ++k){
+        int dist = abs(actions[k].block_size - hint_block_size)*(n_patients + 1)
+                   + abs(actions[k].a_A - hint_a_allocation);
+        if(hint_k < 0 || dist < hint_dist){
+            hint_k = k;
+            hint_dist = dist;
         }
+    }
+    if(hint_k >= 0){
+        action_values[hint_k] = consider_action(cur_idx, ct, actions[hint_k], best_choice, best_order, expected_values);
+    }
 
-	// Compute the expected reward for this action,
-	// w.r.t. the randomness of the transition
-        int a_A = action_iterator->action_a();
-        int a_B = action_iterator->action_b();
+    if(exhaustive || action_search == "exhaustive"){
+        for(unsigned int k=0; k < actions.size(); ++k){
+            if(std::isnan(action_values[k])){
+                action_values[k] = consider_action(cur_idx, ct, actions[k], best_choice, best_order, expected_values);
+            }
+        }
+        return best_choice;
+    }
 
-	TransitionIterator tr_it = TransitionIterator(ct, a_A, a_B);
-	transition_dist->set_state_action(ct, a_A, a_B);
-        while(tr_it.not_finished()){
-            
-            int n_A = tr_it.get_a_counter();
-            int n_B = tr_it.get_b_counter();
+    // Coarse-to-fine: for each block size, try every `stride`-th 
+    // allocation; then repeatedly halve the stride, trying the
+    // neighbors of the best allocation found so far.
+    // (Which allocation is best within the block size steers the
+    //  search, so actions are pruned only if they can't beat it:
+    //  a pruned action's bound is never mistaken for its value.)
+    unsigned int g_start = 0;
+    while(g_start < actions.size()){
+        unsigned int g_end = g_start;
+        while(g_end < actions.size() && actions[g_end].block_size == actions[g_start].block_size){
+            g_end++;
+        }
+        int m = g_end - g_start;
+        int stride = m;
+        if(act_coarse > 1){
+            stride = std::max(1, (m - 1 + act_coarse - 2) / (act_coarse - 1));
+        }
 
-	    // Get the result struct associated with this state
-            StateResult tr_res = (*results_table)(result_size_idx, tr_it.value());
+        std::vector<int> coarse;
+        for(int j = 0; j < m; j += stride){
+            coarse.push_back(g_start + j);
+        }
+        if(coarse.back() != int(g_end) - 1){
+            coarse.push_back(g_end - 1);
+        }
 
-	    // Get the probability of this transition
-	    // and update the expected values:
-	    prob = transition_dist->prob(n_A, n_B);
-            result_interpreter.compute_lookaheads(ct, a_A, a_B, n_A, n_B, tr_res);
-            for(unsigned int i=0; i < n_attr; ++i){
-                expected_values.values[i] += (prob * result_interpreter.look_ahead(i));
-            } 
-            result_interpreter.clear_lookaheads();
+        int best_k = -1;
+        for(unsigned int c = 0; c < coarse.size(); ++c){
+            int k = coarse[c];
+            if(std::isnan(action_values[k])){
+                float prune_below = (best_k < 0) ? FLOAT_NEG_INF : action_values[best_k];
+                action_values[k] = consider_action(cur_idx, ct, actions[k], best_choice, best_order,
+                                                   expected_values, prune_below);
+            }
+            if(best_k < 0 || action_values[k] > action_values[best_k]){
+                best_k = k;
+            }
+        }
 
-            tr_it.advance();
+        while(stride > 1){
+            stride = (stride + 1)/2;
+            int center = best_k;
+            int nbrs[2] = {center - stride, center + stride};
+            for(int j = 0; j < 2; ++j){
+                int k = nbrs[j];
+                if(k < int(g_start) || k >= int(g_end)){ continue; }
+                if(std::isnan(action_values[k])){
+                    action_values[k] = consider_action(cur_idx, ct, actions[k], best_choice, best_order,
+                                                       expected_values, action_values[best_k]);
+                }
+                if(action_values[k] > action_values[best_k]){
+                    best_k = k;
+                }
+            }
         }
 
+        g_start = g_end;
+    }
 
-	// Compare expected reward vs. best_choice
-	if (expected_values.values[rwd_idx] > best_choice.values[rwd_idx]){
+    return best_choice;
+}
 
-            best_choice.block_size = action_iterator->get_block_size();
-	    best_choice.a_allocation = action_iterator->action_a();
 
-            for(unsigned int i=0; i < n_attr; ++i){
-                best_choice.values[i] = expected_values.values[i];
+/**
+ * For a given state, find the action that maximizes
+ * expected reward. Return the result (including the 
+ * value of the maximized reward, and the terms of the
+ * objective function)
+ */
+StateResult TrialMDP::max_expected_reward(int cur_idx, ContingencyTable ct){
+
+    bool coarse_hinted = false;
+    if(coarse_table != NULL){
+        coarse_hinted = coarse_hint(cur_idx, ct);
+    }
+    int suggested_size = hint_block_size;
+    int suggested_a = hint_a_allocation;
+
+    state_error = 0.0;
+    StateResult best_choice = search_actions(cur_idx, ct, false);
+    level_error[cur_idx] = std::max(level_error[cur_idx], state_error);
+
+    // Occasionally check a non-exhaustive search against 
+    // the exhaustive one
+    if(action_search != "exhaustive" && validate_every > 0){
+        n_states_searched++;
+        if(n_states_searched % validate_every == 0){
+
+            long saved_total = n_actions_total;
+            long saved_pruned = n_actions_pruned;
+            StateResult exact_choice = search_actions(cur_idx, ct, true);
+            n_actions_total = saved_total;
+            n_actions_pruned = saved_pruned;
+
+            int rwd_idx = n_attr - 1;
+            n_validated++;
+            if(exact_choice.block_size != best_choice.block_size || 
+               exact_choice.a_allocation != best_choice.a_allocation){
+                n_suboptimal++;
+                float gap = exact_choice.values[rwd_idx] - best_choice.values[rwd_idx];
+                if(gap > max_reward_gap){
+                    max_reward_gap = gap;
+                }
             }
-	}
+        }
+    }
 
-        action_iterator->advance();
-    
+    if(coarse_hinted){
+        n_coarse_hints++;
+        if(best_choice.block_size == suggested_size && best_choice.a_allocation == suggested_a){
+            n_coarse_hits++;
+        }
     }
+    reward_floor = -std::numeric_limits<float>::infinity();
+
+    hint_block_size = best_choice.block_size;
+    hint_a_allocation = best_choice.a_allocation;
+
     // Return the best action (and corresponding results)
     return best_choice;
 }
 
 
+/**
+ * Use the coarse solution to suggest an action for this state.
+ *
+ * At levels the two grids share, the coarse policy's action is
+ * feasible here, and the coarse value is a lower bound on this
+ * state's value (the fine problem has a superset of the actions).
+ * Elsewhere, we scale the table down to the nearest coarse level
+ * below, take that state's action, and stretch the block so that
+ * it ends on the same coarse level. (That suggestion only orders
+ * the search; it doesn't bound anything.)
+ *
+ * Returns false if the coarse solution has nothing to suggest.
+ */
+bool TrialMDP::coarse_hint(int cur_idx, ContingencyTable& ct){
+
+    int n = results_table->get_n_vec()[cur_idx];
+    int rwd_idx = n_attr - 1;
+
+    int c_idx = coarse_table->get_level_idx(n);
+    if(c_idx >= 0){
+        const StateResult* coarse_result = coarse_table->lookup(c_idx, ct);
+        if(coarse_result == NULL || coarse_result->block_size <= 0){ 
+            return false; 
+        }
+        hint_block_size = coarse_result->block_size;
+        hint_a_allocation = coarse_result->a_allocation;
+        if(!std::isnan(coarse_result->values[rwd_idx])){
+            reward_floor = coarse_result->values[rwd_idx];
+        }
+        return true;
+    }
+
+    // Nearest coarse level below this one
+    const std::vector<int>& coarse_n_vec = coarse_table->get_n_vec();
+    c_idx = int(std::lower_bound(coarse_n_vec.begin(), coarse_n_vec.end(), n) 
+                - coarse_n_vec.begin()) - 1;
+    if(c_idx < 0){ return false; }
+    int c = coarse_n_vec[c_idx];
+
+    // Scale the table down, preserving each arm's 
+    // share of patients and success rate
+    int n_A = ct.a0 + ct.a1;
+    int n_B = ct.b0 + ct.b1;
+    int c_A = int(round(float(n_A) * c / n));
+    int c_B = c - c_A;
+    int c_a1 = (n_A > 0) ? int(round(float(ct.a1) * c_A / n_A)) : 0;
+    int c_b1 = (n_B > 0) ? int(round(float(ct.b1) * c_B / n_B)) : 0;
+    ContingencyTable coarse_ct = ContingencyTable(c_A - c_a1, c_a1, c_B - c_b1, c_b1);
+
+    const StateResult* coarse_result = coarse_table->lookup(c_idx, coarse_ct);
+    if(coarse_result == NULL || coarse_result->block_size <= 0){ 
+        return false; 
+    }
+
+    int block_size = c + coarse_result->block_size - n;
+    if(block_size <= 0){
+        block_size = coarse_result->block_size;
+    }
+    hint_block_size = block_size;
+    hint_a_allocation = int(round(float(coarse_result->a_allocation) * block_size 
+                                  / coarse_result->block_size));
+    return true;
+}
+
+
+/**
+ * Index the rewards of a (solved) level for 
+ * range-maximum queries; or use the given index of them.
+ */
+void TrialMDP::update_level_bounds(int idx, const LevelBounds* given){
+
+    // (Only pruning reads the range maxima, and only 
+    //  tail truncation reads the value range)
+    bool prune = pruning_active();
+    if(prune && given != NULL){
+        level_bounds[idx] = *given;
+        prune = false;
+    }
+    if(!prune && epsilon <= 0.0){
+        drop_level_bounds(idx);
+        return;
+    }
+
+    int n = results_table->get_n_vec()[idx];
+    LevelBounds& bounds = level_bounds[idx];
+    if(prune){
+        bounds = LevelBounds(n);
+    }
+    float v_min = std::numeric_limits<float>::infinity();
+    float v_max = -std::numeric_limits<float>::infinity();
+
+    ContingencyIterator it = ContingencyIterator(n);
+    while(true){
+        ContingencyTable ct = it.value();
+        float v = (*results_table)(idx, ct).values[n_attr - 1];
+        if(prune){
+            bounds.set(ct, v);
+        }
+        if(std::isfinite(v)){
+            v_min = std::min(v_min, v);
+            v_max = std::max(v_max, v);
+        }
+        if(!it.not_finished()){ break; }
+        it.advance();
+    }
+    if(prune){
+        bounds.build();
+    }
+    level_min[idx] = v_min;
+    level_max[idx] = v_max;
+
+    drop_level_bounds(idx);
+}
+
+
+/**
+ * Free the range maxima that no action of the levels 
+ * before idx (still to be solved) can read. Level 0 has
+ * the most patients to go, so its actions reach every 
+ * level at least min_size patients on.
+ */
+void TrialMDP::drop_level_bounds(int idx){
+
+    std::vector<int>& n_vec = results_table->get_n_vec();
+    for(unsigned int k=idx; k < level_bounds.size(); ++k){
+        if(idx == 0 || n_vec[k] - n_vec[0] < min_size){
+            level_bounds[k] = LevelBounds();
+        }
+    }
+}
+
+
+/**
+ * Make sure every successor of a state, under any of the given 
+ * actions, is solved (and stored in the results table).
+ * Newly solved states are appended to `added`.
+ */
+void TrialMDP::solve_successors(ContingencyTable& ct, std::vector<BlockAction>& actions,
+                                std::vector< std::pair<int, ContingencyTable> >& added){
+
+    for(unsigned int k=0; k < actions.size(); ++k){
+        BlockAction& act = actions[k];
+
+        // (Only the outcomes kept by tail truncation, if any.
+        //  Read them now; the recursion resets the distribution.)
+        transition_dist->set_state_action(ct, act.a_A, act.a_B);
+        int a_lo = transition_dist->a_lower();
+        int a_hi = transition_dist->a_upper();
+        int b_lo = transition_dist->b_lower();
+        int b_hi = transition_dist->b_upper();
+
+        for(int n_A = a_lo; n_A <= a_hi; ++n_A){
+            for(int n_B = b_lo; n_B <= b_hi; ++n_B){
+                ContingencyTable next_ct = ContingencyTable(ct.a0 + act.a_A - n_A, ct.a1 + n_A,
+                                                            ct.b0 + act.a_B - n_B, ct.b1 + n_B);
+                solve_subtree(act.next_size_idx, next_ct, added);
+            }
+        }
+    }
+}
+
+
+/**
+ * Solve a state, top-down: first its successors (recursively),
+ * then the state itself. States already in the results table
+ * are reused.
+ */
+void TrialMDP::solve_subtree(int idx, ContingencyTable ct,
+                             std::vector< std::pair<int, ContingencyTable> >& added){
+
+    if(results_table->lookup(idx, ct) != NULL){
+        return;
+    }
+
+    if(idx == int(results_table->get_n_vec().size()) - 1){
+        (*results_table)(idx, ct) = (*terminal_rule)(result_interpreter, ct);
+    }else{
+        std::vector<BlockAction> actions = action_iterator->all_actions(idx);
+        solve_successors(ct, actions, added);
+        (*results_table)(idx, ct) = max_expected_reward(idx, ct);
+    }
+    added.push_back(std::make_pair(idx, ct));
+}
+
+
+StateResult TrialMDP::solve_from(ContingencyTable ct, bool keep_memo){
+
+    std::vector<int>& n_vec = results_table->get_n_vec();
+    int n_total = ct.a0 + ct.a1 + ct.b0 + ct.b1;
+    if(n_total > n_vec.back()){
+        std::cerr << "`solve_from`: the table has more than " << n_vec.back() << " patients." << std::endl;
+        throw 1;
+    }
+
+    // (The range maxima behind pruning need whole levels)
+    bool prune = use_pruning;
+    use_pruning = false;
+
+    std::vector< std::pair<int, ContingencyTable> > added;
+    StateResult result;
+
+    int idx = results_table->get_level_idx(n_total);
+    if(idx >= 0){
+        solve_subtree(idx, ct, added);
+        result = *(results_table->lookup(idx, ct));
+    }else{
+        // The table's size isn't one of the design's levels 
+        // (e.g., a stage over-enrolled). Its next block may end at
+        // any later level; or, if none is at least min_size away,
+        // at the end of the trial.
+        int first_later = int(std::upper_bound(n_vec.begin(), n_vec.end(), n_total) - n_vec.begin());
+        std::vector<int> sub_vec = std::vector<int>(1, n_total);
+        sub_vec.insert(sub_vec.end(), n_vec.begin() + first_later, n_vec.end());
+        int root_min = std::min(min_size, n_vec.back() - n_total);
+
+        ActionIterator root_iterator = ActionIterator(act_l, act_u, act_n, sub_vec, root_min, 0);
+        std::vector<BlockAction> actions = root_iterator.all_actions(0);
+        for(unsigned int k=0; k < actions.size(); ++k){
+            actions[k].next_size_idx += first_later - 1;
+        }
+        solve_successors(ct, actions, added);
+
+        result = StateResult(n_attr);
+        result.values[n_attr - 1] = -std::numeric_limits<float>::infinity();
+        int best_order = -1;
+        StateResult expected_values = StateResult(n_attr);
+        for(unsigned int k=0; k < actions.size(); ++k){
+            // (-1: this state isn't on any level)
+            consider_action(-1, ct, actions[k], result, best_order, expected_values);
+        }
+    }
+
+    std::cout << "Top-down solve: " << added.size() << " new states" << std::endl;
+
+    if(!keep_memo){
+        for(unsigned int i=0; i < added.size(); ++i){
+            results_table->erase(added[i].first, added[i].second);
+        }
+    }
+    use_pruning = prune;
+
+    return result;
+}
+
+
+std::vector<std::string> TrialMDP::get_attr_names(){
+    std::vector<std::string> names;
+    for(int i=0; i < n_attr; ++i){
+        names.push_back(result_interpreter.name_from_idx(i));
+    }
+    return names;
+}
+
+
+/**
+ * For a given state, compute the expected values of
+ * the action prescribed by a fixed policy.
+ */
+StateResult TrialMDP::policy_expected_reward(int cur_idx, ContingencyTable ct,
+                                             TrialMDPTable& policy){
+
+    StateResult result = StateResult(n_attr);
+
+    const StateResult* action = policy.lookup(cur_idx, ct);
+    if(action == NULL){
+        std::cerr << "`evaluate`: the policy has no entry for one of the states." << std::endl;
+        throw 1;
+    }
+
+    // The policy never found a finite-reward action here
+    if(action->block_size == 0){
+        for(unsigned int i=0; i < n_attr; ++i){
+            result.values[i] = 0.0;
+        }
+        result.values[n_attr - 1] = -std::numeric_limits<float>::infinity();
+        return result;
+    }
+
+    int result_size_idx = results_table->get_level_idx(results_table->get_n_vec()[cur_idx] + action->block_size);
+    int a_A = action->a_allocation;
+    int a_B = action->block_size - a_A;
+    expected_reward(cur_idx, ct, result_size_idx, a_A, a_B, result);
+
+    result.block_size = action->block_size;
+    result.a_allocation = a_A;
+
+    return result;
+}
+
+
 // Constructor
 TrialMDP::TrialMDP(int n_patients, float failure_cost, float block_cost,
                          int min_size, int block_incr, 
@@ -107,6 +669,14 @@ TrialMDP::TrialMDP(int n_patients, float failure_cost, float block_cost,
                          std::string test_statistic,
                          float act_l, float act_u, int act_n){
 
+    check_trial_size(n_patients, "TrialMDP");
+    this->n_patients = n_patients;
+    this->block_incr = block_incr;
+    this->min_size = min_size;
+    this->act_l = act_l;
+    this->act_u = act_u;
+    this->act_n = act_n;
+
     result_interpreter = ResultInterpreter(test_statistic, failure_cost, block_cost, n_patients);
 
     n_attr = result_interpreter.get_n_attr();
@@ -124,12 +694,126 @@ TrialMDP::TrialMDP(int n_patients, float failure_cost, float block_cost,
 
     terminal_rule = TerminalRule::make_terminal_rule(test_statistic, failure_cost);
 
+    // Branch-and-bound bookkeeping
+    use_pruning = true;
+    level_bounds = std::vector<LevelBounds>(results_table->get_n_vec().size());
+    level_min = std::vector<float>(results_table->get_n_vec().size(), 0.0);
+    level_max = std::vector<float>(results_table->get_n_vec().size(), 0.0);
+    inc_lo = std::vector<float>(n_attr);
+    inc_hi = std::vector<float>(n_attr);
+    hint_block_size = 0;
+    hint_a_allocation = 0;
+    n_actions_total = 0;
+    n_actions_pruned = 0;
+
+    // Exhaustive action search, unless told otherwise
+    action_search = "exhaustive";
+    act_coarse = act_n;
+    validate_every = 0;
+    n_states_searched = 0;
+    n_validated = 0;
+    n_suboptimal = 0;
+    max_reward_gap = 0.0;
+
+    // State-major backups, unless told otherwise
+    backup_order = "state_major";
+
+    // Nobody is watching the solve
+    control = NULL;
+
+    // No coarse solution, unless we're given one
+    coarse_table = NULL;
+    reward_floor = -std::numeric_limits<float>::infinity();
+    n_coarse_hints = 0;
+    n_coarse_hits = 0;
+
+    // No tail truncation, unless told otherwise
+    epsilon = 0.0;
+    level_error = std::vector<float>(results_table->get_n_vec().size(), 0.0);
+    state_error = 0.0;
+    n_transitions = 0;
+    n_transitions_kept = 0;
+}
+
+
+void TrialMDP::set_epsilon(float eps){
+    if(eps < 0.0 || eps >= 1.0){
+        std::cerr << "epsilon must lie in [0, 1)." << std::endl;
+        throw 1;
+    }
+    epsilon = eps;
+    transition_dist->set_epsilon(eps);
+}
+
+
+void TrialMDP::set_coarse_solution(TrialMDPTable& coarse){
+
+    // The coarse policy must be feasible in this problem:
+    // every coarse level must also be one of ours
+    const std::vector<int>& n_vec = results_table->get_n_vec();
+    const std::vector<int>& coarse_n_vec = coarse.get_n_vec();
+    for(unsigned int i=0; i < coarse_n_vec.size(); ++i){
+        if(!std::binary_search(n_vec.begin(), n_vec.end(), coarse_n_vec[i])){
+            std::cerr << "`set_coarse_solution`: coarse level " << coarse_n_vec[i] 
+                      << " is not a level of this problem. The coarse block_incr must be a multiple of this one." << std::endl;
+            throw 1;
+        }
+    }
+    coarse_table = &coarse;
+}
+
+
+void TrialMDP::set_action_search(std::string strategy, int n_coarse, int validate){
+    if(strategy != "exhaustive" && strategy != "coarse_to_fine"){
+        std::cerr << strategy << " not a valid value for action search strategy." << std::endl;
+        throw 1;
+    }
+    action_search = strategy;
+    act_coarse = n_coarse;
+    validate_every = validate;
+}
+
 
+void TrialMDP::set_backup_order(std::string order){
+    if(order != "state_major" && order != "action_major" && order != "factored"){
+        std::cerr << "`set_backup_order`: " << order << " isn't one of \"state_major\", \"action_major\", \"factored\"." << std::endl;
+        throw 1;
+    }
+    backup_order = order;
+}
+
+
+void TrialMDP::check_control(){
+    if(control == NULL){
+        return;
+    }
+    if(control->cancel){
+        std::cerr << "`solve`: cancelled." << std::endl;
+        throw TRIAL_MDP_CANCELLED;
+    }
+    control->n_solved++;
 }
 
 
 void TrialMDP::solve(){
 
+    begin_levels();
+
+    if(backup_order != "state_major"){
+        if(epsilon > 0.0){
+            std::cerr << "`solve`: action-major backups need epsilon = 0." << std::endl;
+            throw 1;
+        }
+        int n_levels = results_table->get_n_vec().size();
+        level_values = std::vector< std::vector<float> >(n_levels);
+        for(int idx=n_levels-1; idx >= 0; --idx){
+            backup_level(idx);
+        }
+        level_values.clear();
+        end_levels();
+        return;
+    }
+
     // Iterate through the terminal states;
     // set the terminal rewards
     int terminal_idx = state_iterator->get_cur_idx();
@@ -140,6 +824,7 @@ void TrialMDP::solve(){
 
     while(cur_idx == terminal_idx){
 	
+        check_control();
 	(*results_table)(terminal_idx, cur_table) = (*terminal_rule)(result_interpreter, cur_table);
 	
 	state_iterator->advance();
@@ -147,109 +832,478 @@ void TrialMDP::solve(){
 	cur_table = state_iterator->value();
 
     }
+    update_level_bounds(terminal_idx);
     
     // Move on to the earlier states. 
     // compute the maximal action for each one.
     while(state_iterator->not_finished()){
 
+        check_control();
         cur_table = state_iterator->value();
         (*results_table)(cur_idx, cur_table) = max_expected_reward(cur_idx, cur_table);
 
+        int prev_idx = cur_idx;
         state_iterator->advance();
 	cur_idx = state_iterator->get_cur_idx();
+        if(cur_idx != prev_idx){
+            update_level_bounds(prev_idx);
+        }
     }
 
-    StateResult first_move = (*results_table)(0, cur_table);
+    end_levels();
+}
+
+
+void TrialMDP::begin_levels(){
+    n_actions_total = 0;
+    n_actions_pruned = 0;
+    n_states_searched = 0;
+    n_validated = 0;
+    n_suboptimal = 0;
+    max_reward_gap = 0.0;
+    n_coarse_hints = 0;
+    n_coarse_hits = 0;
+    n_transitions = 0;
+    n_transitions_kept = 0;
+    level_error = std::vector<float>(results_table->get_n_vec().size(), 0.0);
+}
+
+
+void TrialMDP::solve_level(int idx, int64_t rank_lo, int64_t rank_hi){
+
+    int n = results_table->get_n_vec()[idx];
+    bool terminal = (idx == int(results_table->get_n_vec().size()) - 1);
+    for(ContingencyIterator it(n, rank_lo, rank_hi); it.in_range(); it.advance()){
+        check_control();
+        ContingencyTable ct = it.value();
+        if(terminal){
+            results_table->store(idx, ct, (*terminal_rule)(result_interpreter, ct));
+        }else{
+            results_table->store(idx, ct, max_expected_reward(idx, ct));
+        }
+    }
+}
+
+
+/**
+ * Keep an action-major backup's best action for a state. (The actions
+ * come in iteration order, so a tie keeps the earlier one.)
+ */
+void TrialMDP::update_best(BlockAction& act, const std::vector<float>& expected,
+                           float* best, int& best_size, int& best_a){
+    int rwd_idx = n_attr - 1;
+    if(expected[rwd_idx] > best[rwd_idx]){
+        best_size = act.block_size;
+        best_a = act.a_A;
+        for(int i=0; i < n_attr; ++i){
+            best[i] = expected[i];
+        }
+    }
+}
+
+
+/**
+ * The arm-B half of an action's expectations, for a factored backup:
+ *     partial(a0', a1', b0, b1) = sum_{n_B} b_prob(n_B | b0, b1)
+ *                                  * f(a0', a1', b0 + a_B - n_B, b1 + n_B)
+ * where f is the lookahead values of the successor (see lookahead_rule.h;
+ * for a given action they depend on the successor alone). Every state
+ * with arm-B counts (b0, b1) whose arm-A outcome leads to (a0', a1')
+ * shares this sum. The partials are stored by the states' number of
+ * arm-A patients, m: from offsets[m], the table over a1' in [0, m + a_A]
+ * and b1 in [0, n - m], with n_attr values each.
+ */
+void TrialMDP::partial_contractions(int idx, BlockAction& act,
+                                    const std::vector<float>& b_table,
+                                    std::vector<float>& partials,
+                                    std::vector<int64_t>& offsets){
+
+    int n = results_table->get_n_vec()[idx];
+    int n_b = act.a_B + 1;
+    const float* next_values = &level_values[act.next_size_idx][0];
+
+    offsets.resize(n + 2);
+    offsets[0] = 0;
+    for(int m=0; m <= n; ++m){
+        offsets[m + 1] = offsets[m] + int64_t(m + act.a_A + 1)*(n - m + 1);
+    }
+    partials.resize(offsets[n + 1]*n_attr);
+
+    StateResult next_res = StateResult(n_attr);
+    std::vector<float> succ_values;
+
+    for(int m=0; m <= n; ++m){
+        int a_total = m + act.a_A;
+        int b_total = n - m;
+        int row_len = b_total + act.a_B + 1;
+        succ_values.resize(row_len*n_attr);
+
+        for(int a1=0; a1 <= a_total; ++a1){
+            int a0 = a_total - a1;
+
+            // The lookahead values of the successors (a0, a1, *, *),
+            // evaluated from any state and outcome that lead there.
+            // (Each arm-B success is the previous rank.)
+            int n_A = std::min(a1, act.a_A);
+            int64_t top_rank = table_rank(ContingencyTable(a0, a1, b_total + act.a_B, 0));
+            for(int b1=0; b1 < row_len; ++b1){
+                int n_B = std::min(b1, act.a_B);
+                ContingencyTable ct(a0 - (act.a_A - n_A), a1 - n_A,
+                                    b_total + act.a_B - b1 - (act.a_B - n_B), b1 - n_B);
+                std::copy(next_values + (top_rank - b1)*n_attr,
+                          next_values + (top_rank - b1 + 1)*n_attr, next_res.values);
+                result_interpreter.compute_lookaheads(ct, act.a_A, act.a_B, n_A, n_B, next_res);
+                for(int i=0; i < n_attr; ++i){
+                    succ_values[i*row_len + b1] = result_interpreter.look_ahead(i);
+                }
+                result_interpreter.clear_lookaheads();
+            }
+
+            float* part = &partials[(offsets[m] + int64_t(a1)*(b_total + 1))*n_attr];
+            for(int b1=0; b1 <= b_total; ++b1){
+                const float* pb = &b_table[(int64_t(b_total)*(b_total + 1)/2 + b1)*n_b];
+                for(int i=0; i < n_attr; ++i){
+                    const float* row = &succ_values[i*row_len + b1];
+                    float sum = 0.0;
+                    for(int n_B=0; n_B < n_b; ++n_B){
+                        sum += pb[n_B]*row[n_B];
+                    }
+                    part[b1*n_attr + i] = sum;
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * An action-major backup of a level: take the level's actions in
+ * turn, and evaluate each one at every state of the level; keep
+ * each state's best. The arm probabilities of an action depend only
+ * on that arm's counts, so they're tabulated once per action, for
+ * every (n_0, n_1) with n_0 + n_1 <= n. The successors of a state
+ * with the same arm-A outcome are consecutive ranks of the next 
+ * level, read from level_values. Each state's expectation is taken 
+ * exactly as in expected_reward, and ties go to the earliest action,
+ * so the solution is the same as the state-major one.
+ *
+ * A factored backup takes each state's expectation as a sum over 
+ * arm A of the arm-B partial sums (see partial_contractions): 
+ * O(a_A + a_B) per state and action, rather than O(a_A * a_B).
+ */
+void TrialMDP::backup_level(int idx){
+
+    int n = results_table->get_n_vec()[idx];
+    int64_t n_states = n_tables(n);
+    int rwd_idx = n_attr - 1;
+    std::vector<float>& values = level_values[idx];
+    values = std::vector<float>(n_states*n_attr, 0.0);
+
+    if(idx == int(level_values.size()) - 1){
+        for(ContingencyIterator it(n); it.in_range(); it.advance()){
+            check_control();
+            ContingencyTable ct = it.value();
+            StateResult res = (*terminal_rule)(result_interpreter, ct);
+            for(int i=0; i < n_attr; ++i){
+                values[it.get_rank()*n_attr + i] = res.values[i];
+            }
+            results_table->store(idx, ct, res);
+        }
+        return;
+    }
+
+    std::vector<int> best_size(n_states, 0);
+    std::vector<int> best_a(n_states, 0);
+    for(int64_t rank=0; rank < n_states; ++rank){
+        values[rank*n_attr + rwd_idx] = -std::numeric_limits<float>::infinity();
+    }
+
+    // (One arm's counts, (n_0, n_1), index its probabilities)
+    int64_t n_arm = int64_t(n + 1)*(n + 2)/2;
+    std::vector<float> a_table;
+    std::vector<float> b_table;
+    std::vector<float> expected(n_attr);
+
+    StateResult next_res = StateResult(n_attr);
+    bool factored = (backup_order == "factored");
+    std::vector<float> partials;
+    std::vector<int64_t> offsets;
+
+    std::vector<BlockAction> actions = action_iterator->all_actions(idx);
+    for(unsigned int k=0; k < actions.size(); ++k){
+
+        if(control != NULL && control->cancel){
+            std::cerr << "`solve`: cancelled." << std::endl;
+            throw TRIAL_MDP_CANCELLED;
+        }
+        BlockAction& act = actions[k];
+        int n_a = act.a_A + 1;
+        int n_b = act.a_B + 1;
+        const float* next_values = &level_values[act.next_size_idx][0];
+
+        a_table.resize(n_arm*n_a);
+        b_table.resize(n_arm*n_b);
+        for(int m=0; m <= n; ++m){
+            for(int n_1=0; n_1 <= m; ++n_1){
+                int64_t j = int64_t(m)*(m + 1)/2 + n_1;
+                std::vector<float> pa = transition_dist->arm_probs(m - n_1, n_1, act.a_A, true);
+                std::vector<float> pb = transition_dist->arm_probs(m - n_1, n_1, act.a_B, false);
+                std::copy(pa.begin(), pa.end(), a_table.begin() + j*n_a);
+                std::copy(pb.begin(), pb.end(), b_table.begin() + j*n_b);
+            }
+        }
+
+        int64_t n_outcomes = int64_t(n_a)*n_b;
+        n_actions_total += n_states;
+        n_transitions += n_states*n_outcomes;
+        n_transitions_kept += n_states*n_outcomes;
+        if(factored){
+            partial_contractions(idx, act, b_table, partials, offsets);
+        }
+
+        for(ContingencyIterator it(n); it.in_range(); it.advance()){
+
+            ContingencyTable ct = it.value();
+            int64_t m_a = ct.a0 + ct.a1;
+            const float* pa = &a_table[(m_a*(m_a + 1)/2 + ct.a1)*n_a];
+
+            if(factored){
+                int m = m_a;
+                int b_total = ct.b0 + ct.b1;
+                const float* part = &partials[(offsets[m] + int64_t(ct.a1)*(b_total + 1) + ct.b1)*n_attr];
+                int64_t stride = int64_t(b_total + 1)*n_attr;
+                for(int i=0; i < n_attr; ++i){
+                    float sum = 0.0;
+                    for(int n_A=0; n_A < n_a; ++n_A){
+                        sum += pa[n_A]*part[n_A*stride + i];
+                    }
+                    expected[i] = sum;
+                }
+                update_best(act, expected, &values[it.get_rank()*n_attr],
+                            best_size[it.get_rank()], best_a[it.get_rank()]);
+                continue;
+            }
+
+            int64_t m_b = ct.b0 + ct.b1;
+            const float* pb = &b_table[(m_b*(m_b + 1)/2 + ct.b1)*n_b];
+            std::fill(expected.begin(), expected.end(), 0.0);
+            for(int n_A=0; n_A < n_a; ++n_A){
+                // (The successor with no arm-B successes; each
+                //  further success is the previous rank)
+                int64_t succ_rank = table_rank(ContingencyTable(ct.a0 + act.a_A - n_A, ct.a1 + n_A,
+                                                                ct.b0 + act.a_B, ct.b1));
+                for(int n_B=0; n_B < n_b; ++n_B){
+                    std::copy(next_values + (succ_rank - n_B)*n_attr,
+                              next_values + (succ_rank - n_B + 1)*n_attr, next_res.values);
+                    float prob = pa[n_A]*pb[n_B];
+                    result_interpreter.compute_lookaheads(ct, act.a_A, act.a_B, n_A, n_B, next_res);
+                    for(int i=0; i < n_attr; ++i){
+                        expected[i] += (prob * result_interpreter.look_ahead(i));
+                    }
+                    result_interpreter.clear_lookaheads();
+                }
+            }
+            update_best(act, expected, &values[it.get_rank()*n_attr],
+                        best_size[it.get_rank()], best_a[it.get_rank()]);
+        }
+    }
+
+    StateResult res = StateResult(n_attr);
+    for(ContingencyIterator it(n); it.in_range(); it.advance()){
+        check_control();
+        int64_t rank = it.get_rank();
+        res.block_size = best_size[rank];
+        res.a_allocation = best_a[rank];
+        for(int i=0; i < n_attr; ++i){
+            res.values[i] = values[rank*n_attr + i];
+        }
+        results_table->store(idx, it.value(), res);
+    }
+}
+
+
+void TrialMDP::finish_level(int idx, float error, const LevelBounds* bounds){
+    level_error[idx] = error;
+    update_level_bounds(idx, bounds);
+}
+
+
+SolveCounts TrialMDP::get_counts(){
+    SolveCounts counts;
+    counts.n_actions_total = n_actions_total;
+    counts.n_actions_pruned = n_actions_pruned;
+    counts.n_transitions = n_transitions;
+    counts.n_transitions_kept = n_transitions_kept;
+    return counts;
+}
+
+
+void TrialMDP::add_counts(const SolveCounts& counts){
+    n_actions_total += counts.n_actions_total;
+    n_actions_pruned += counts.n_actions_pruned;
+    n_transitions += counts.n_transitions;
+    n_transitions_kept += counts.n_transitions_kept;
+}
+
+
+void TrialMDP::end_levels(){
+
+    // (No more actions read the range maxima)
+    drop_level_bounds(0);
+
+    StateResult first_move = (*results_table)(0, ContingencyTable());
 
     std::cout << result_interpreter.pretty_print_result(first_move);
 
+    if(pruning_active() && n_actions_total > 0){
+        std::cout << "Action pruning: skipped " << n_actions_pruned << " of " 
+                  << n_actions_total << " actions (" 
+                  << (100.0 * n_actions_pruned) / n_actions_total << "%)" << std::endl;
+    }
+    if(n_validated > 0){
+        std::cout << "Action search validation: " << n_suboptimal << " of " 
+                  << n_validated << " sampled states differ from exhaustive search; "
+                  << "largest reward gap: " << max_reward_gap << std::endl;
+    }
+    if(n_coarse_hints > 0){
+        std::cout << "Coarse solution: suggested the best action in " << n_coarse_hits 
+                  << " of " << n_coarse_hints << " states" << std::endl;
+    }
+    if(epsilon > 0.0 && !level_error.empty()){
+        float max_error = *std::max_element(level_error.begin(), level_error.end());
+        if(n_transitions > 0){
+            std::cout << "Tail truncation (epsilon=" << epsilon << "): evaluated " 
+                      << n_transitions_kept << " of " << n_transitions << " transitions (" 
+                      << (100.0 * n_transitions_kept) / n_transitions << "%)" << std::endl;
+        }
+        std::cout << "\tReward error bound: " << level_error[0] << " at the first move; " 
+                  << max_error << " at any state" << std::endl;
+    }
+
 }
 
 
 
+void TrialMDP::evaluate(TrialMDPTable& policy){
+
+    if(policy.get_n_vec() != results_table->get_n_vec()){
+        std::cerr << "`evaluate`: the policy's table sizes don't match this problem's. Check n_patients, min_size and block_incr." << std::endl;
+        throw 1;
+    }
+
+    // Set the terminal rewards, exactly as in `solve`
+    int terminal_idx = state_iterator->get_cur_idx();
+    int cur_idx = terminal_idx;
+    ContingencyTable cur_table; 
+    cur_table = state_iterator->value();
+
+    while(cur_idx == terminal_idx){
+	
+        check_control();
+	(*results_table)(terminal_idx, cur_table) = (*terminal_rule)(result_interpreter, cur_table);
+	
+	state_iterator->advance();
+	cur_idx = state_iterator->get_cur_idx();
+	cur_table = state_iterator->value();
+
+    }
+    
+    // Move on to the earlier states; each one 
+    // takes the policy's action.
+    while(state_iterator->not_finished()){
+
+        cur_table = state_iterator->value();
+        (*results_table)(cur_idx, cur_table) = policy_expected_reward(cur_idx, cur_table, policy);
+
+        state_iterator->advance();
+	cur_idx = state_iterator->get_cur_idx();
+    }
+
+    StateResult first_move = (*results_table)(0, cur_table);
+
+    std::cout << result_interpreter.pretty_print_result(first_move);
+
+}
+
+
 void TrialMDP::to_sqlite(char* db_fname, int chunk_size=10000){
+    results_table->to_sqlite(db_fname, result_interpreter, chunk_size);
+}
+
+
+std::vector<ReachMap> TrialMDP::reachable_states(){
+
+    std::vector<int>& n_vec = results_table->get_n_vec();
+    std::vector<ReachMap> reach = std::vector<ReachMap>(n_vec.size());
+    reach[0][ContingencyTable()] = 1.0;
+
+    // The deployed policy must cover the tails, too
+    transition_dist->set_epsilon(0.0);
+
+    for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+        for(ReachMap::iterator it = reach[idx].begin(); it != reach[idx].end(); ++it){
+
+            ContingencyTable ct = it->first;
+            const StateResult* res = results_table->lookup(idx, ct);
+            if(res == NULL){
+                std::cerr << "`reachable_states`: the policy has no entry for a reachable state." << std::endl;
+                transition_dist->set_epsilon(epsilon);
+                throw 1;
+            }
+            if(res->block_size == 0){
+                continue;
+            }
 
-    // Make database connection pointer
-    sqlite3* db;
-
-    try{
-        // Connect to database
-        int conn_result = 1;
-        conn_result = sqlite3_open(db_fname, &db);
-        if(conn_result != 0){ throw 1; }
-
-      
-        // Drop the table if it already exists. 
-        std::string droptable_str = "DROP TABLE IF EXISTS RESULTS;";
-        int drop_result = 1;
-        drop_result = sqlite3_exec(db, droptable_str.c_str(), NULL, NULL, NULL);
-
-        // Build table in database
-	std::string build_expr = result_interpreter.sql_create_table();
-        int build_result = 1;
-        build_result = sqlite3_exec(db, build_expr.c_str(), NULL, NULL, NULL);
-        if (build_result != 0){ throw 2; }
-
-	// Beginning and end of each chunk
-	std::string transaction_start = "BEGIN TRANSACTION;\n";
-        std::string transaction_end = "COMMIT;";
-
-	// Iterate over the results
-	StateIterator result_iter = StateIterator(*(results_table));
-        while(result_iter.not_finished()){
-
-	    // Prepare a chunk of INSERTs...
-	    std::string insert_expr = transaction_start;
-            int chunk_idx = 0;
-
-	    while(result_iter.not_finished() && chunk_idx < chunk_size){
-
-		// Get the contingency table and corresponding results
-                ContingencyTable cur_table = result_iter.value();
-	        int cur_idx = result_iter.get_cur_idx();
-                StateResult cur_results = (*results_table)(cur_idx, cur_table);
-	       
-                // add a line for this result to the SQL query         
-                insert_expr += result_interpreter.sql_insert_tuple(cur_results, cur_table);
-		
-                // Move to the next result
-                result_iter.advance();
-
-	    }
-	    insert_expr += transaction_end;
-
-	    // INSERT the chunk
-            int insert_result = 1;
-            insert_result = sqlite3_exec(db, insert_expr.c_str(), NULL, NULL, NULL);
-            if (insert_result != 0){ throw 3; }
-	}
-        // Close connection
-        sqlite3_close(db);
-
-    }
-    catch(int code){ 
-        switch(code){
-	    case 1:
-	        std::cerr << "`to_sqlite`: failed to connect to SQLite database at location " << db_fname << std::endl;
-		break;
-	    case 2:
-		std::cerr << "`to_sqlite`: failed to build table RESULTS in database." << std::endl; 
-		break;
-	    case 3: 
-		std::cerr << "`to_sqlite`: failed to insert rows into table RESULTS." << std::endl; 
-		break;
-	    default: 
-		std::cerr << "`to_sqlite`: method failed." << std::endl; 
-		break;
+            int a_A = res->a_allocation;
+            int a_B = res->block_size - a_A;
+            int next_idx = results_table->get_level_idx(n_vec[idx] + res->block_size);
+            transition_dist->set_state_action(ct, a_A, a_B);
+
+            for(int n_A = 0; n_A <= a_A; ++n_A){
+                for(int n_B = 0; n_B <= a_B; ++n_B){
+                    float prob = transition_dist->prob(n_A, n_B);
+                    if(prob <= 0.0){
+                        continue;
+                    }
+                    ContingencyTable next = ContingencyTable(ct.a0 + a_A - n_A, ct.a1 + n_A,
+                                                             ct.b0 + a_B - n_B, ct.b1 + n_B);
+                    reach[next_idx][next] += it->second * prob;
+                }
+            }
+        }
+    }
+
+    transition_dist->set_epsilon(epsilon);
+    return reach;
+}
+
+
+void TrialMDP::to_sqlite_reachable(char* db_fname, int chunk_size, bool reach_prob){
+
+    std::vector<ReachMap> reach = reachable_states();
+
+    long n_reachable = 0;
+    long n_terminal = 0;
+    for(unsigned int idx = 0; idx < reach.size(); ++idx){
+        for(ReachMap::iterator it = reach[idx].begin(); it != reach[idx].end(); ++it){
+            if(results_table->lookup(idx, it->first)->block_size == 0){
+                n_terminal++;
+            }else{
+                n_reachable++;
+            }
         }
     }
+    std::cout << "Reachable states: " << n_reachable << " with an action (and "
+              << n_terminal << " terminal)" << std::endl;
 
+    results_table->to_sqlite(db_fname, result_interpreter, chunk_size, &reach, reach_prob);
 }
     
 
 TrialMDP::~TrialMDP(){
     delete state_iterator;
     delete action_iterator;
+    results_table->release();
     delete results_table;
     delete terminal_rule;
     delete transition_dist;
@@ -14,6 +14,7 @@
 // Important methods:
 //   * solve():      perform the dynamic programming algorithm,
 //                   obtaining an optimal policy governing the RCT.
+//   * evaluate():   compute the expected values of a fixed policy.
 //   * to_sqlite():  save the optimal policy to a SQLite database.
 
 #ifndef _TRIAL_MDP_H
@@ -27,7 +28,48 @@
 #include "action_iterator.h"
 #include "transition_dist.h"
 #include "terminal_rule.h"
+#include "level_bounds.h"
 #include <string>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <limits>
+
+// The solver's version, for telling stored designs apart
+// (see PolicyStore). Increase it when a change to the
+// solver changes its solutions.
+#define TRIAL_MDP_VERSION 1
+
+// Thrown by `solve` when it's cancelled
+#define TRIAL_MDP_CANCELLED 2
+
+// Lets another thread follow a solve (the number of
+// states solved so far) and cancel it. Solves that wait
+// for other processes (see solve_sharded) also call
+// `interrupted`, if it's set, and cancel once it's true.
+struct SolveControl{
+    std::atomic<bool> cancel;
+    std::atomic<long> n_solved;
+    bool (*interrupted)();
+
+    SolveControl(){
+        cancel = false;
+        n_solved = 0;
+        interrupted = NULL;
+    }
+};
+
+// Work counts of a (partial) solve
+struct SolveCounts{
+    long n_actions_total;
+    long n_actions_pruned;
+    long n_transitions;
+    long n_transitions_kept;
+};
+
+// Relative tolerance for discarding actions whose
+// upper bound falls below the best expected reward
+#define PRUNING_TOL 1e-5
 
 class TrialMDP{
 
@@ -48,8 +90,96 @@ class TrialMDP{
         
         ResultInterpreter result_interpreter; 
 
+        // Branch-and-bound over actions (state-major backups only):
+        // range maxima of the reward in each solved level that
+        // actions can still reach, the previous state's best
+        // action, and pruning counts
+        bool use_pruning;
+        std::vector<LevelBounds> level_bounds;
+        std::vector<float> inc_lo;
+        std::vector<float> inc_hi;
+        int hint_block_size;
+        int hint_a_allocation;
+        long n_actions_total;
+        long n_actions_pruned;
+
+        // Action search strategy ("exhaustive" or "coarse_to_fine"),
+        // the number of coarse allocations per block size, and
+        // bookkeeping for validating against exhaustive search
+        std::string action_search;
+        int act_coarse;
+        int validate_every;
+        long n_states_searched;
+        long n_validated;
+        long n_suboptimal;
+        float max_reward_gap;
+
+        // Multi-resolution solve: a solution on a coarser grid of
+        // levels (not owned), the value it guarantees for the
+        // current state, and how often its suggestions were right
+        TrialMDPTable* coarse_table;
+        float reward_floor;
+        long n_coarse_hints;
+        long n_coarse_hits;
+
+        // Tail truncation of the transitions: the dropped mass 
+        // per arm, each level's value range, a bound on each 
+        // level's value error, and transition counts
+        float epsilon;
+        std::vector<float> level_min;
+        std::vector<float> level_max;
+        std::vector<float> level_error;
+        float state_error;
+        long n_transitions;
+        long n_transitions_kept;
+
+        // Backup order ("state_major", "action_major" or "factored"; see
+        // set_backup_order), and for action-major backups, the
+        // values of each solved level: n_attr per table, in rank order
+        std::string backup_order;
+        std::vector< std::vector<float> > level_values;
+
+        // (Not owned; NULL if nobody is watching)
+        SolveControl* control;
+
+        // Needed to build actions for interim states
+        // that lie between levels (see solve_from)
+        int min_size;
+        float act_l;
+        float act_u;
+        int act_n;
+
 	// Private methods
+        void expected_reward(int cur_idx, ContingencyTable ct,
+                             int result_size_idx, int a_A, int a_B,
+                             StateResult& expected_values,
+                             bool dist_ready=false);
+        float consider_action(int cur_idx, ContingencyTable& ct, BlockAction& act,
+                              StateResult& best_choice, int& best_order,
+                              StateResult& expected_values,
+                              float prune_below=std::numeric_limits<float>::infinity());
+        StateResult search_actions(int cur_idx, ContingencyTable ct, bool exhaustive);
 	StateResult max_expected_reward(int cur_idx, ContingencyTable ct);
+        float action_reward_bound(int cur_idx, ContingencyTable& ct, BlockAction& act);
+        void update_level_bounds(int idx, const LevelBounds* given=NULL);
+        void drop_level_bounds(int idx);
+        bool pruning_active() const { return use_pruning && backup_order == "state_major"; }
+        bool coarse_hint(int cur_idx, ContingencyTable& ct);
+        float truncation_error(ContingencyTable& ct, BlockAction& act);
+        StateResult policy_expected_reward(int cur_idx, ContingencyTable ct,
+                                           TrialMDPTable& policy);
+        void solve_successors(ContingencyTable& ct, std::vector<BlockAction>& actions,
+                              std::vector< std::pair<int, ContingencyTable> >& added);
+        void solve_subtree(int idx, ContingencyTable ct,
+                           std::vector< std::pair<int, ContingencyTable> >& added);
+        void check_control();
+        void backup_level(int idx);
+        void update_best(BlockAction& act, const std::vector<float>& expected,
+                         float* best, int& best_size, int& best_a);
+        void partial_contractions(int idx, BlockAction& act,
+                                  const std::vector<float>& b_table,
+                                  std::vector<float>& partials,
+                                  std::vector<int64_t>& offsets);
 
     public:
 
@@ -64,8 +194,96 @@ class TrialMDP{
 
 	void solve();
 
+        // Level-by-level solving, for solvers that split each level's
+        // states among processes (see sharded_solve.h): call 
+        // begin_levels; then, from the last level to the first, 
+        // solve_level on a range of the level's ranks (see table_rank),
+        // and finish_level once the whole level is solved, with the 
+        // largest error bound any process found in it (see 
+        // get_level_error). end_levels reports the solution.
+        // If needs_level_bounds, the processes can share one index
+        // of the solved level's rewards (see LevelBounds), and pass
+        // it to finish_level; otherwise each one builds its own.
+        void begin_levels();
+        void solve_level(int idx, int64_t rank_lo, int64_t rank_hi);
+        float get_level_error(int idx){ return level_error[idx]; }
+        void set_level_error(int idx, float error){ level_error[idx] = error; }
+        bool needs_level_bounds() const { return pruning_active(); }
+        void finish_level(int idx, float error, const LevelBounds* bounds=NULL);
+        void end_levels();
+        SolveCounts get_counts();
+        void add_counts(const SolveCounts& counts);
+
+        // Report progress to `control`, and stop (throwing
+        // TRIAL_MDP_CANCELLED) once control->cancel is set.
+        // `control` must outlive the solve.
+        void set_control(SolveControl* c){ control = c; }
+
+        // Solve only the states reachable from an interim state,
+        // top-down, and return its best action. The state's size 
+        // needn't be one of the design's levels. Solved states are
+        // memoized in the results table; if keep_memo, they stay
+        // there for later calls (and to_sqlite).
+        StateResult solve_from(ContingencyTable ct, bool keep_memo=true);
+
+        // Branch-and-bound action pruning (on by default;
+        // it never changes the solution)
+        void set_pruning(bool prune){ use_pruning = prune; }
+
+        // Choose the action search strategy. "coarse_to_fine" tries 
+        // n_coarse allocations per block size, then refines around
+        // the best one. If validate > 0, every validate-th state is
+        // also searched exhaustively, and the solver reports 
+        // how often (and by how much) the two disagree.
+        void set_action_search(std::string strategy, int n_coarse, int validate);
+
+        // Order the Bellman backups: "state_major" (the default)
+        // searches each state's actions in turn; "action_major"
+        // takes each action of a level in turn, evaluates it at
+        // every state of the level, and keeps each state's best.
+        // Action-major backups are exhaustive and read the levels 
+        // densely; they ignore the search strategy, pruning and 
+        // coarse solutions (the solution is the same), and need 
+        // epsilon = 0. (solve_from and solve_sharded stay state-major.)
+        // "factored" is action-major, but sums each arm's outcomes
+        // separately, sharing the arm-B sums among states: much less
+        // work for large blocks. Its sums are taken in another order,
+        // so its values can differ from the others' in the last bits
+        // (and, rarely, so can its choice between near-equal actions).
+        void set_backup_order(std::string order);
+
+        // Use the solution of the same problem on a coarser grid
+        // (a multiple of block_incr) to order and prune the action
+        // search. The solution stays exact. The coarse table must 
+        // outlive the solve.
+        void set_coarse_solution(TrialMDPTable& coarse);
+
+        // Drop each arm's outcomes outside the central 1 - eps
+        // of its mass (and renormalize). The solver reports a 
+        // bound on the resulting error in the expected reward.
+        void set_epsilon(float eps);
+
+        // Compute the expected values of a fixed policy
+        // (e.g., one loaded with TrialMDPTable::from_sqlite)
+        // under this problem's costs and test statistic,
+        // without re-optimizing it.
+        void evaluate(TrialMDPTable& policy);
+
 	void to_sqlite(char* db_fname, int chunk_size);
 
+        // The states the optimal policy reaches from the empty table,
+        // over every outcome with nonzero probability; and their
+        // probabilities under the (untruncated) transition distribution
+        std::vector<ReachMap> reachable_states();
+
+        // Save only the reachable states that have an action.
+        // (Much smaller; enough to run the trial, simulate it, or
+        //  compute operating characteristics, but not to `evaluate`.)
+        void to_sqlite_reachable(char* db_fname, int chunk_size, bool reach_prob);
+
+        TrialMDPTable& get_results_table(){ return *results_table; }
+        std::vector<std::string> get_attr_names();
+
 	// Destructor
 	~TrialMDP();
 };
@@ -5,7 +5,12 @@
 #include "trial_mdp_table.h"
 #include "contingency_table.h"
 #include "state_result.h"
+#include "result_interpreter.h"
+#include "contingency_iterator.h"
+#include <sqlite3.h>
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 std::vector<int> build_n_vec(unsigned int n_max, unsigned int min_size, unsigned int n_incr){
     std::vector<int> result;
@@ -31,7 +36,275 @@ TrialMDPTable::TrialMDPTable(int n_max, int min_size, int n_incr){
     for(unsigned int i = 0; i < n_vec.size(); i++){
         results.push_back( new std::unordered_map<ContingencyTable, StateResult, CTHash> ); 
     }
+    dense = std::vector<StateResult*>(n_vec.size(), (StateResult*) NULL);
 
 }
 
 
+TrialMDPTable::TrialMDPTable(std::vector<int> levels){
+    n_vec = levels;
+    results = std::vector< std::unordered_map<ContingencyTable, StateResult, CTHash>* >();
+
+    for(unsigned int i = 0; i < n_vec.size(); i++){
+        results.push_back( new std::unordered_map<ContingencyTable, StateResult, CTHash> ); 
+    }
+    dense = std::vector<StateResult*>(n_vec.size(), (StateResult*) NULL);
+}
+
+
+int TrialMDPTable::get_level_idx(int n_total) const {
+    std::vector<int>::const_iterator it = std::lower_bound(n_vec.begin(), n_vec.end(), n_total);
+    if(it == n_vec.end() || *it != n_total){
+        return -1;
+    }
+    return int(it - n_vec.begin());
+}
+
+
+const StateResult* TrialMDPTable::lookup(int idx, const ContingencyTable& ct) const {
+    if(dense[idx] != NULL){
+        return &dense[idx][table_rank(ct)];
+    }
+    std::unordered_map<ContingencyTable, StateResult, CTHash>::const_iterator it = results[idx]->find(ct);
+    if(it == results[idx]->end()){
+        return NULL;
+    }
+    return &(it->second);
+}
+
+
+TrialMDPTable* TrialMDPTable::from_sqlite(std::string db_fname,
+                                          std::vector<std::string>* attr_names){
+
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+
+    if(sqlite3_open_v2(db_fname.c_str(), &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK){
+        std::cerr << "`from_sqlite`: failed to connect to SQLite database at location " << db_fname << std::endl;
+        sqlite3_close(db);
+        throw 1;
+    }
+
+    // The levels are the distinct sizes of the stored contingency tables
+    std::vector<int> levels;
+    std::string levels_query = "SELECT DISTINCT A0+A1+B0+B1 AS N FROM RESULTS ORDER BY N;";
+    if(sqlite3_prepare_v2(db, levels_query.c_str(), -1, &stmt, NULL) != SQLITE_OK){
+        std::cerr << "`from_sqlite`: failed to read table RESULTS in database." << std::endl;
+        sqlite3_close(db);
+        throw 2;
+    }
+    while(sqlite3_step(stmt) == SQLITE_ROW){
+        levels.push_back(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+
+    TrialMDPTable* table = new TrialMDPTable(levels);
+
+    // Every column after (A0, A1, B0, B1, BlockSize, AAllocation)
+    // is one of the result attributes -- except ReachProb
+    // (see `to_sqlite`)
+    std::string rows_query = "SELECT * FROM RESULTS;";
+    if(sqlite3_prepare_v2(db, rows_query.c_str(), -1, &stmt, NULL) != SQLITE_OK){
+        std::cerr << "`from_sqlite`: failed to read table RESULTS in database." << std::endl;
+        sqlite3_close(db);
+        table->release();
+        delete table;
+        throw 2;
+    }
+    std::vector<int> attr_cols;
+    for(int col = 6; col < sqlite3_column_count(stmt); ++col){
+        if(std::string(sqlite3_column_name(stmt, col)) != "ReachProb"){
+            attr_cols.push_back(col);
+        }
+    }
+    int n_attr = attr_cols.size();
+    if(attr_names != NULL){
+        attr_names->clear();
+        for(int i=0; i < n_attr; ++i){
+            attr_names->push_back(sqlite3_column_name(stmt, attr_cols[i]));
+        }
+    }
+
+    while(sqlite3_step(stmt) == SQLITE_ROW){
+        ContingencyTable ct = ContingencyTable(sqlite3_column_int(stmt, 0),
+                                               sqlite3_column_int(stmt, 1),
+                                               sqlite3_column_int(stmt, 2),
+                                               sqlite3_column_int(stmt, 3));
+        StateResult res = StateResult(n_attr);
+        res.block_size = sqlite3_column_int(stmt, 4);
+        res.a_allocation = sqlite3_column_int(stmt, 5);
+        for(int i=0; i < n_attr; ++i){
+            // Non-finite values are stored as NULL
+            if(sqlite3_column_type(stmt, attr_cols[i]) == SQLITE_NULL){
+                res.values[i] = std::numeric_limits<float>::quiet_NaN();
+            }else{
+                res.values[i] = sqlite3_column_double(stmt, attr_cols[i]);
+            }
+        }
+        int idx = table->get_level_idx(ct.a0 + ct.a1 + ct.b0 + ct.b1);
+        (*table)(idx, ct) = res;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    return table;
+}
+
+
+void TrialMDPTable::set_dense(int idx, StateResult* records){
+    dense[idx] = records;
+}
+
+
+void TrialMDPTable::copy_dense(int idx, int64_t rank_lo, int64_t rank_hi){
+    StateResult* records = dense[idx];
+    if(records == NULL){
+        return;
+    }
+    if(rank_lo == 0){
+        results[idx]->reserve(n_tables(n_vec[idx]));
+    }
+    for(ContingencyIterator it(n_vec[idx], rank_lo, rank_hi); it.in_range(); it.advance()){
+        (*results[idx])[it.value()] = records[it.get_rank()];
+    }
+}
+
+
+void TrialMDPTable::store(int idx, const ContingencyTable& ct, const StateResult& res){
+    if(dense[idx] == NULL){
+        (*results[idx])[ct] = res;
+        return;
+    }
+    StateResult& rec = dense[idx][table_rank(ct)];
+    rec.block_size = res.block_size;
+    rec.a_allocation = res.a_allocation;
+    for(int i=0; i < rec.n_values; ++i){
+        rec.values[i] = res.values[i];
+    }
+}
+
+
+void TrialMDPTable::release(){
+    for(unsigned int i = 0; i < results.size(); i++){
+        delete results[i];
+    }
+    results.clear();
+}
+
+
+// INSERT a level's reachable, non-terminal tables in chunks
+// (throws 3 on failure, like `to_sqlite`)
+void TrialMDPTable::insert_reachable(sqlite3* db, ResultInterpreter& interp, int chunk_size,
+                                     int idx, const ReachMap& reachable, bool reach_prob){
+
+    ReachMap::const_iterator it = reachable.begin();
+    while(it != reachable.end()){
+
+        std::string insert_expr = "BEGIN TRANSACTION;\n";
+        int chunk_idx = 0;
+        while(it != reachable.end() && chunk_idx < chunk_size){
+            ContingencyTable cur_table = it->first;
+            StateResult& res = (*results[idx])[cur_table];
+            if(res.block_size != 0){
+                insert_expr += interp.sql_insert_tuple(res, cur_table,
+                                                       reach_prob ? &(it->second) : NULL);
+                ++chunk_idx;
+            }
+            ++it;
+        }
+        insert_expr += "COMMIT;";
+
+        if(sqlite3_exec(db, insert_expr.c_str(), NULL, NULL, NULL) != 0){ throw 3; }
+    }
+}
+
+
+void TrialMDPTable::to_sqlite(char* db_fname, ResultInterpreter& interp, int chunk_size,
+                              const std::vector<ReachMap>* reachable, bool reach_prob){
+
+    // Make database connection pointer
+    sqlite3* db = NULL;
+
+    try{
+        // Connect to database
+        int conn_result = 1;
+        conn_result = sqlite3_open(db_fname, &db);
+        if(conn_result != 0){ throw 1; }
+
+      
+        // Drop the table if it already exists. 
+        std::string droptable_str = "DROP TABLE IF EXISTS RESULTS;";
+        int drop_result = 1;
+        drop_result = sqlite3_exec(db, droptable_str.c_str(), NULL, NULL, NULL);
+
+        // Build table in database
+	std::string build_expr = interp.sql_create_table(reach_prob);
+        int build_result = 1;
+        build_result = sqlite3_exec(db, build_expr.c_str(), NULL, NULL, NULL);
+        if (build_result != 0){ throw 2; }
+
+	// Beginning and end of each chunk
+	std::string transaction_start = "BEGIN TRANSACTION;\n";
+        std::string transaction_end = "COMMIT;";
+
+	// Iterate over the results, one level at a time
+        // (from the last level to the first)
+        for(int idx = int(n_vec.size()) - 1; idx >= 0; --idx){
+
+            if(reachable != NULL){
+                insert_reachable(db, interp, chunk_size, idx, (*reachable)[idx], reach_prob);
+                continue;
+            }
+
+            std::unordered_map<ContingencyTable, StateResult, CTHash>::iterator it = results[idx]->begin();
+            while(it != results[idx]->end()){
+
+	        // Prepare a chunk of INSERTs...
+	        std::string insert_expr = transaction_start;
+                int chunk_idx = 0;
+
+	        while(it != results[idx]->end() && chunk_idx < chunk_size){
+
+		    // Get the contingency table and corresponding results
+                    ContingencyTable cur_table = it->first;
+	       
+                    // add a line for this result to the SQL query         
+                    insert_expr += interp.sql_insert_tuple(it->second, cur_table);
+		
+                    // Move to the next result
+                    ++it;
+                    ++chunk_idx;
+	        }
+	        insert_expr += transaction_end;
+
+	        // INSERT the chunk
+                int insert_result = 1;
+                insert_result = sqlite3_exec(db, insert_expr.c_str(), NULL, NULL, NULL);
+                if (insert_result != 0){ throw 3; }
+	    }
+        }
+        // Close connection
+        sqlite3_close(db);
+
+    }
+    catch(int code){ 
+        switch(code){
+	    case 1:
+	        std::cerr << "`to_sqlite`: failed to connect to SQLite database at location " << db_fname << std::endl;
+		break;
+	    case 2:
+		std::cerr << "`to_sqlite`: failed to build table RESULTS in database." << std::endl; 
+		break;
+	    case 3: 
+		std::cerr << "`to_sqlite`: failed to insert rows into table RESULTS." << std::endl; 
+		break;
+	    default: 
+		std::cerr << "`to_sqlite`: method failed." << std::endl; 
+		break;
+        }
+        // (The database is incomplete; callers mustn't use it)
+        sqlite3_close(db);
+        throw 1;
+    }
+
+}
@@ -14,36 +14,109 @@
 
 #include <unordered_map>
 #include <vector>
+#include <string>
 #include "contingency_table.h"
 #include "state_result.h"
 #include <iostream>
 
+class ResultInterpreter;
+struct sqlite3;
+
+// The probability of reaching each table of a level
+typedef std::unordered_map<ContingencyTable, double, CTHash> ReachMap;
+
+// The table sizes (numbers of patients) at which a 
+// trial may stop between blocks
+std::vector<int> build_n_vec(unsigned int n_max, unsigned int min_size, unsigned int n_incr);
+
 class TrialMDPTable{
 
     private:
         std::vector< std::unordered_map<ContingencyTable, StateResult, CTHash>* > results;
 	std::vector<int> n_vec;
 
+        // Levels stored densely instead (NULL for the others):
+        // one StateResult per table, indexed by table_rank. 
+        // Not owned; see set_dense.
+        std::vector<StateResult*> dense;
+
+        void insert_reachable(sqlite3* db, ResultInterpreter& interp, int chunk_size,
+                              int idx, const ReachMap& reachable, bool reach_prob);
+
     public:
         TrialMDPTable(int n_max, int min_size, int n_incr);
+        TrialMDPTable(std::vector<int> levels);
 
 	TrialMDPTable(){
             results = std::vector< std::unordered_map<ContingencyTable, StateResult, CTHash>* >();
 	    n_vec = std::vector<int>();
+            dense = std::vector<StateResult*>();
 	}
 
 	TrialMDPTable(const TrialMDPTable& other){
             results = other.results;
 	    n_vec = other.n_vec;
+            dense = other.dense;
 	}
 
 	std::vector<int> & get_n_vec(){ return n_vec; }
+
+        // Index of the level whose tables contain n_total
+        // patients (-1 if there is no such level)
+        int get_level_idx(int n_total) const;
+
+        // Read-only lookup; returns NULL if the state is absent.
+        // (Unlike operator(), this never inserts into the table.)
+        const StateResult* lookup(int idx, const ContingencyTable& ct) const;
+
+        // Remove a state (if present)
+        void erase(int idx, const ContingencyTable& ct){ results[idx]->erase(ct); }
+
+        // Rebuild a table from the RESULTS table of a 
+        // trial design database (see TrialMDP::to_sqlite).
+        // Optionally, also get the result attributes' names.
+        static TrialMDPTable* from_sqlite(std::string db_fname,
+                                          std::vector<std::string>* attr_names=NULL);
+
+        // Write every stored state to the RESULTS table of a 
+        // SQLite database (replacing it), in chunks of INSERTs.
+        // Given each level's reachable tables, write only those
+        // (and only the non-terminal ones); with reach_prob, 
+        // add a ReachProb column. Throws 1 (after saying why) on failure.
+        void to_sqlite(char* db_fname, ResultInterpreter& interp, int chunk_size,
+                       const std::vector<ReachMap>* reachable=NULL, bool reach_prob=false);
+
+        // Store a level densely, in `records` (one per table of the
+        // level, in rank order, each with its own values array). The
+        // caller owns the records, which must outlive their use here;
+        // e.g., they can live in memory shared between processes.
+        // store() and operator() then read and write the records.
+        void set_dense(int idx, StateResult* records);
+
+        // Copy ranks [rank_lo, rank_hi) of a dense level into its 
+        // hash map. (Once every rank is copied, call set_dense(idx, NULL)
+        // to stop using the records.)
+        void copy_dense(int idx, int64_t rank_lo, int64_t rank_hi);
+
+        // Store a state's result. (In a dense level, this copies the
+        // values into the record's own array.)
+        void store(int idx, const ContingencyTable& ct, const StateResult& res);
+
+        // Free the hash maps. Copies of a TrialMDPTable share
+        // their hash maps, so only the owner should call this.
+        void release();
         
 	// Set one of the hash maps
-	StateResult& operator ()(int idx, ContingencyTable ct) {return (*(results[idx]))[ct]; }
+	StateResult& operator ()(int idx, ContingencyTable ct) {
+            if(dense[idx] != NULL){ return dense[idx][table_rank(ct)]; }
+            return (*(results[idx]))[ct]; 
+        }
 	
 	// Get one of the hash maps
-	StateResult& operator ()(int idx, ContingencyTable ct) const { return (*(results[idx]))[ct];}
+	StateResult& operator ()(int idx, ContingencyTable ct) const { 
+            if(dense[idx] != NULL){ return dense[idx][table_rank(ct)]; }
+            return (*(results[idx]))[ct];
+        }
 
 };
 
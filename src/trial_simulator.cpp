@@ -0,0 +1,234 @@
+// trial_simulator.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of TrialSimulator class
+
+#include "trial_simulator.h"
+#include "contingency_table.h"
+#include "trial_mdp_table.h"
+#include "terminal_rule.h"
+#include "state_result.h"
+#include "counter_rng.h"
+#include <thread>
+#include <exception>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+
+/**
+ * Draw from Binomial(n, p) by inversion.
+ */
+int binom_draw(CounterRNG& rng, int n, double p){
+    if(p <= 0.0 || n == 0){ return 0; }
+    if(p >= 1.0){ return n; }
+    if(p > 0.5){
+        return n - binom_draw(rng, n, 1.0 - p);
+    }
+
+    double q = 1.0 - p;
+    double pmf = pow(q, n);
+
+    // For very large stages (q^n underflows) fall back
+    // to a sum of Bernoulli draws
+    if(pmf == 0.0){
+        int k = 0;
+        for(int i = 0; i < n; ++i){
+            if(rng.uniform() < p){ k++; }
+        }
+        return k;
+    }
+
+    double u = rng.uniform();
+    double ratio = p / q;
+    int k = 0;
+    double cdf = pmf;
+    while(u >= cdf && k < n){
+        pmf *= ratio * double(n - k) / double(k + 1);
+        k++;
+        cdf += pmf;
+    }
+    return k;
+}
+
+
+TrialSimulator::TrialSimulator(TrialMDPTable& policy_table, float crit_value, int threads){
+    table = policy_table;
+    critical_value = crit_value;
+    n_threads = threads;
+    if(n_threads < 1){
+        n_threads = std::thread::hardware_concurrency();
+        if(n_threads < 1){ n_threads = 1; }
+    }
+}
+
+
+SimTrace TrialSimulator::simulate_trial(CounterRNG& rng, float p_a, float p_b){
+
+    ContingencyTable ct = ContingencyTable();
+    std::vector<int>& n_vec = table.get_n_vec();
+    int idx = 0;
+
+    // Running sums for the CMH statistic
+    // (each stage is a stratum)
+    double cmh_dev = 0.0;
+    double cmh_var = 0.0;
+
+    SimTrace trace;
+    trace.n_stages = 0;
+
+    while(true){
+        const StateResult* res = table.lookup(idx, ct);
+        if(res == NULL){
+            std::cerr << "`TrialSimulator`: the policy has no entry for a reachable state." << std::endl;
+            throw 1;
+        }
+        if(res->block_size == 0){
+            break;
+        }
+
+        int a_A = res->a_allocation;
+        int a_B = res->block_size - a_A;
+        int n_A = binom_draw(rng, a_A, p_a);
+        int n_B = binom_draw(rng, a_B, p_b);
+
+        double n_k = a_A + a_B;
+        double m1 = n_A + n_B;
+        if(n_k > 1.0){
+            cmh_dev += n_A - a_A * m1 / n_k;
+            cmh_var += a_A * a_B * m1 * (n_k - m1) / (n_k * n_k * (n_k - 1.0));
+        }
+
+        ct += ContingencyTable(a_A - n_A, n_A, a_B - n_B, n_B);
+        trace.n_stages++;
+
+        // (Designs saved without their terminal tables end 
+        //  with a block past the last stored level)
+        int n_next = n_vec[idx] + res->block_size;
+        if(n_next > n_vec.back()){
+            break;
+        }
+        idx = table.get_level_idx(n_next);
+        if(idx < 0){
+            std::cerr << "`TrialSimulator`: the policy has no level with " << n_next << " patients." << std::endl;
+            throw 1;
+        }
+    }
+
+    trace.final_table = ct;
+    trace.wald_stat = wald_statistic(ct);
+    trace.cmh_stat = 0.0;
+    if(cmh_var > 0.0){
+        trace.cmh_stat = cmh_dev * cmh_dev / cmh_var;
+    }
+    return trace;
+}
+
+
+void TrialSimulator::simulate_batch(float p_a, float p_b, uint64_t seed,
+                                    long start, long stop,
+                                    SimSummary* sums,
+                                    std::vector<SimTrace>* traces,
+                                    std::exception_ptr* error){
+
+    // Exceptions can't leave a worker thread (std::terminate);
+    // hand them back to the calling thread instead.
+    try{
+        CounterRNG rng = CounterRNG(seed);
+        SimSummary s;
+
+        for(long i = start; i < stop; ++i){
+            rng.set_stream(i);
+            SimTrace tr = simulate_trial(rng, p_a, p_b);
+
+            double n_a = tr.final_table.a0 + tr.final_table.a1;
+            double n_b = tr.final_table.b0 + tr.final_table.b1;
+            double failures = tr.final_table.a0 + tr.final_table.b0;
+
+            s.n_trials++;
+            if(tr.wald_stat > critical_value){ s.reject_wald += 1.0; }
+            if(tr.cmh_stat > critical_value){ s.reject_cmh += 1.0; }
+            // (sums of squares are stored in the sd_* fields 
+            //  until the batches are combined)
+            s.mean_n_a += n_a;
+            s.sd_n_a += n_a*n_a;
+            s.mean_n_b += n_b;
+            s.mean_failures += failures;
+            s.sd_failures += failures*failures;
+            s.mean_stages += tr.n_stages;
+            s.sd_stages += double(tr.n_stages)*tr.n_stages;
+
+            if(traces != NULL){
+                (*traces)[i] = tr;
+            }
+        }
+        *sums = s;
+    }
+    catch(...){
+        *error = std::current_exception();
+    }
+}
+
+
+SimSummary TrialSimulator::simulate(float p_a, float p_b, long n_trials, uint64_t seed,
+                                    std::vector<SimTrace>* traces){
+
+    if(traces != NULL){
+        traces->resize(n_trials);
+    }
+
+    // Give each thread a contiguous batch of trials
+    int n_batches = n_threads;
+    if(n_trials < n_batches){ n_batches = (n_trials > 0) ? n_trials : 1; }
+    std::vector<SimSummary> batch_sums = std::vector<SimSummary>(n_batches);
+    std::vector<std::exception_ptr> batch_errors = std::vector<std::exception_ptr>(n_batches);
+    std::vector<std::thread> workers;
+
+    for(int b = 0; b < n_batches; ++b){
+        long start = (n_trials * b) / n_batches;
+        long stop = (n_trials * (b+1)) / n_batches;
+        workers.push_back(std::thread(&TrialSimulator::simulate_batch, this,
+                                      p_a, p_b, seed, start, stop,
+                                      &batch_sums[b], traces,
+                                      &batch_errors[b]));
+    }
+    for(unsigned int b = 0; b < workers.size(); ++b){
+        workers[b].join();
+    }
+    for(int b = 0; b < n_batches; ++b){
+        if(batch_errors[b]){ std::rethrow_exception(batch_errors[b]); }
+    }
+
+    // Combine the batches
+    SimSummary result;
+    for(int b = 0; b < n_batches; ++b){
+        result.n_trials += batch_sums[b].n_trials;
+        result.reject_wald += batch_sums[b].reject_wald;
+        result.reject_cmh += batch_sums[b].reject_cmh;
+        result.mean_n_a += batch_sums[b].mean_n_a;
+        result.mean_n_b += batch_sums[b].mean_n_b;
+        result.mean_failures += batch_sums[b].mean_failures;
+        result.mean_stages += batch_sums[b].mean_stages;
+        result.sd_n_a += batch_sums[b].sd_n_a;
+        result.sd_failures += batch_sums[b].sd_failures;
+        result.sd_stages += batch_sums[b].sd_stages;
+    }
+    if(result.n_trials == 0){
+        return result;
+    }
+
+    double N = result.n_trials;
+    result.reject_wald /= N;
+    result.reject_cmh /= N;
+    result.mean_n_a /= N;
+    result.mean_n_b /= N;
+    result.mean_failures /= N;
+    result.mean_stages /= N;
+    result.sd_n_a = sqrt(std::max(0.0, result.sd_n_a/N - result.mean_n_a*result.mean_n_a));
+    result.sd_failures = sqrt(std::max(0.0, result.sd_failures/N - result.mean_failures*result.mean_failures));
+    result.sd_stages = sqrt(std::max(0.0, result.sd_stages/N - result.mean_stages*result.mean_stages));
+
+    return result;
+}
+
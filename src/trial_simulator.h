@@ -0,0 +1,88 @@
+// trial_simulator.h
+// (c) 2021-03 David Merrell
+//
+// A multithreaded Monte Carlo simulator for solved trial designs.
+//
+// Each simulated trial starts at the empty contingency table and
+// follows the policy stored in a TrialMDPTable; the outcomes of 
+// each stage are binomial draws under "true" response rates (p_A, p_B).
+// At the end of the trial we apply two tests of p_A = p_B:
+//   * the Wald (chi-square) test on the final table, and
+//   * the Cochran-Mantel-Haenszel test, stratified by stage.
+// The first can also be computed exactly (see OperatingCharacteristics);
+// the second depends on the whole trajectory, so we simulate it.
+//
+// Trial i always draws from random stream i (see CounterRNG), so
+// results are reproducible regardless of the number of threads.
+
+#ifndef _TRIAL_SIMULATOR_H
+#define _TRIAL_SIMULATOR_H
+
+#include "contingency_table.h"
+#include "trial_mdp_table.h"
+#include "counter_rng.h"
+#include <vector>
+#include <exception>
+#include <stdint.h>
+
+// The outcome of a single simulated trial
+struct SimTrace{
+    ContingencyTable final_table;
+    int n_stages;
+    float wald_stat;
+    float cmh_stat;
+};
+
+
+struct SimSummary{
+    long n_trials;
+    double reject_wald;
+    double reject_cmh;
+    double mean_n_a;
+    double mean_n_b;
+    double mean_failures;
+    double mean_stages;
+    double sd_n_a;
+    double sd_failures;
+    double sd_stages;
+
+    SimSummary(){
+        n_trials = 0;
+        reject_wald = 0.0;
+        reject_cmh = 0.0;
+        mean_n_a = 0.0;
+        mean_n_b = 0.0;
+        mean_failures = 0.0;
+        mean_stages = 0.0;
+        sd_n_a = 0.0;
+        sd_failures = 0.0;
+        sd_stages = 0.0;
+    }
+};
+
+
+class TrialSimulator{
+
+    private:
+        TrialMDPTable table;
+        float critical_value;
+        int n_threads;
+
+        SimTrace simulate_trial(CounterRNG& rng, float p_a, float p_b);
+
+        void simulate_batch(float p_a, float p_b, uint64_t seed,
+                            long start, long stop,
+                            SimSummary* sums, 
+                            std::vector<SimTrace>* traces,
+                            std::exception_ptr* error);
+
+    public:
+        TrialSimulator(TrialMDPTable& policy_table, float crit_value, int threads);
+
+        // Simulate n_trials trials. If `traces` is not NULL,
+        // it receives the outcome of every trial.
+        SimSummary simulate(float p_a, float p_b, long n_trials, uint64_t seed,
+                            std::vector<SimTrace>* traces);
+};
+
+#endif
@@ -0,0 +1,276 @@
+// trialmdp_c.cpp
+// (c) 2021-03 David Merrell
+//
+// Implementation of the C interface. Each function
+// turns the solver's exceptions into return codes.
+
+#include "trialmdp_c.h"
+#include "trial_mdp.h"
+#include "compact_policy.h"
+#include "sharded_solve.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <exception>
+
+struct trialmdp_problem{
+    TrialMDP* solver;
+    std::vector<std::string> value_names;
+    int n_processes;
+    bool solved;
+};
+
+
+int trialmdp_version(void){
+    return TRIAL_MDP_VERSION;
+}
+
+
+trialmdp_problem* trialmdp_create(int n_patients, float failure_cost, float block_cost,
+                                  int min_size, int block_incr,
+                                  float prior_a0, float prior_a1,
+                                  float prior_b0, float prior_b1,
+                                  const char* transition_dist,
+                                  const char* test_statistic,
+                                  float act_l, float act_u, int act_n){
+
+    if(n_patients < 1 || min_size < 1 || block_incr < 1 || act_n < 1
+       || transition_dist == NULL || test_statistic == NULL){
+        std::cerr << "`trialmdp_create`: invalid parameters." << std::endl;
+        return NULL;
+    }
+    trialmdp_problem* p = NULL;
+    try{
+        // (Value-initialized: solver is NULL until it's built)
+        p = new trialmdp_problem();
+        p->solver = new TrialMDP(n_patients, failure_cost, block_cost,
+                                 min_size, block_incr,
+                                 prior_a0, prior_a1, prior_b0, prior_b1,
+                                 transition_dist, test_statistic,
+                                 act_l, act_u, act_n);
+        p->value_names = p->solver->get_attr_names();
+        p->n_processes = 1;
+        p->solved = false;
+        return p;
+    }
+    catch(int code){
+        trialmdp_free(p);
+        return NULL;
+    }
+    catch(std::exception& e){
+        std::cerr << "`trialmdp_create`: " << e.what() << std::endl;
+        trialmdp_free(p);
+        return NULL;
+    }
+    catch(...){
+        std::cerr << "`trialmdp_create`: unexpected error." << std::endl;
+        trialmdp_free(p);
+        return NULL;
+    }
+}
+
+
+int trialmdp_set_action_search(trialmdp_problem* p, const char* strategy, int n_coarse){
+    if(p == NULL || strategy == NULL){
+        return 1;
+    }
+    try{
+        p->solver->set_action_search(strategy, n_coarse, 0);
+    }
+    catch(int code){
+        return 1;
+    }
+    catch(std::exception& e){
+        std::cerr << "`trialmdp_set_action_search`: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...){
+        std::cerr << "`trialmdp_set_action_search`: unexpected error." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int trialmdp_set_epsilon(trialmdp_problem* p, float epsilon){
+    if(p == NULL){
+        return 1;
+    }
+    try{
+        p->solver->set_epsilon(epsilon);
+    }
+    catch(int code){
+        return 1;
+    }
+    catch(std::exception& e){
+        std::cerr << "`trialmdp_set_epsilon`: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...){
+        std::cerr << "`trialmdp_set_epsilon`: unexpected error." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int trialmdp_set_backup_order(trialmdp_problem* p, const char* order){
+    if(p == NULL || order == NULL){
+        return 1;
+    }
+    try{
+        p->solver->set_backup_order(order);
+    }
+    catch(int code){
+        return 1;
+    }
+    catch(std::exception& e){
+        std::cerr << "`trialmdp_set_backup_order`: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...){
+        std::cerr << "`trialmdp_set_backup_order`: unexpected error." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int trialmdp_set_processes(trialmdp_problem* p, int n_processes){
+    if(p == NULL || n_processes < 0){
+        return 1;
+    }
+    p->n_processes = n_processes;
+    return 0;
+}
+
+
+int trialmdp_solve(trialmdp_problem* p){
+    if(p == NULL){
+        return 1;
+    }
+    try{
+        if(p->n_processes == 1){
+            p->solver->solve();
+        }else{
+            solve_sharded(*p->solver, p->n_processes);
+        }
+    }
+    catch(int code){
+        return 1;
+    }
+    catch(std::exception& e){
+        std::cerr << "`trialmdp_solve`: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...){
+        std::cerr << "`trialmdp_solve`: unexpected error." << std::endl;
+        return 1;
+    }
+    p->solved = true;
+    return 0;
+}
+
+
+int trialmdp_n_values(trialmdp_problem* p){
+    return (p == NULL) ? 0 : p->value_names.size();
+}
+
+
+const char* trialmdp_value_name(trialmdp_problem* p, int i){
+    if(p == NULL || i < 0 || i >= int(p->value_names.size())){
+        return NULL;
+    }
+    return p->value_names[i].c_str();
+}
+
+
+int trialmdp_query(trialmdp_problem* p, int a0, int a1, int b0, int b1,
+                   int* block_size, int* a_allocation, double* values){
+
+    if(p == NULL || !p->solved || !ct_counts_fit(a0, a1, b0, b1)){
+        return 1;
+    }
+    TrialMDPTable& table = p->solver->get_results_table();
+    int idx = table.get_level_idx(a0 + a1 + b0 + b1);
+    if(idx < 0){
+        return 1;
+    }
+    const StateResult* res = table.lookup(idx, ContingencyTable(a0, a1, b0, b1));
+    if(res == NULL){
+        return 1;
+    }
+    if(block_size != NULL){
+        *block_size = res->block_size;
+    }
+    if(a_allocation != NULL){
+        *a_allocation = res->a_allocation;
+    }
+    if(values != NULL){
+        for(unsigned int i = 0; i < p->value_names.size(); ++i){
+            values[i] = res->values[i];
+        }
+    }
+    return 0;
+}
+
+
+int trialmdp_export_sqlite(trialmdp_problem* p, const char* fname,
+                           int reachable_only, int reach_prob){
+    if(p == NULL || !p->solved || fname == NULL){
+        return 1;
+    }
+    try{
+        std::vector<char> db_fname(fname, fname + std::strlen(fname) + 1);
+        if(reachable_only){
+            p->solver->to_sqlite_reachable(&db_fname[0], 10000, reach_prob != 0);
+        }else{
+            p->solver->to_sqlite(&db_fname[0], 10000);
+        }
+    }
+    catch(int code){
+        return 1;
+    }
+    catch(std::exception& e){
+        std::cerr << "`trialmdp_export_sqlite`: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...){
+        std::cerr << "`trialmdp_export_sqlite`: unexpected error." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int trialmdp_export_compact(trialmdp_problem* p, const char* fname, int value_bits){
+    if(p == NULL || !p->solved || fname == NULL){
+        return 1;
+    }
+    try{
+        CompactPolicy policy = CompactPolicy(p->solver->get_results_table(),
+                                             p->value_names, value_bits);
+        policy.save(fname);
+    }
+    catch(int code){
+        return 1;
+    }
+    catch(std::exception& e){
+        std::cerr << "`trialmdp_export_compact`: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...){
+        std::cerr << "`trialmdp_export_compact`: unexpected error." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+void trialmdp_free(trialmdp_problem* p){
+    if(p != NULL){
+        delete p->solver;
+        delete p;
+    }
+}
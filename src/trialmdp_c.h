@@ -0,0 +1,69 @@
+/* trialmdp_c.h
+ * (c) 2021-03 David Merrell
+ *
+ * A C interface to the solver, for programs that
+ * don't use R (or C++): set up a problem, solve it,
+ * query the solution, and save it.
+ *
+ * Functions that can fail return 0 on success and
+ * nonzero on failure (with a message on stderr).
+ */
+
+#ifndef _TRIALMDP_C_H
+#define _TRIALMDP_C_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct trialmdp_problem trialmdp_problem;
+
+/* The solver version (see TRIAL_MDP_VERSION) */
+int trialmdp_version(void);
+
+/* Set up a problem (the same parameters as the R function
+ * trial_mdp). Returns NULL if the parameters are invalid. */
+trialmdp_problem* trialmdp_create(int n_patients, float failure_cost, float block_cost,
+                                  int min_size, int block_incr,
+                                  float prior_a0, float prior_a1,
+                                  float prior_b0, float prior_b1,
+                                  const char* transition_dist,
+                                  const char* test_statistic,
+                                  float act_l, float act_u, int act_n);
+
+/* Solver options (see TrialMDP::set_action_search, set_epsilon,
+ * set_backup_order) */
+int trialmdp_set_action_search(trialmdp_problem* p, const char* strategy, int n_coarse);
+int trialmdp_set_epsilon(trialmdp_problem* p, float epsilon);
+int trialmdp_set_backup_order(trialmdp_problem* p, const char* order);
+
+/* Solve with several worker processes (0 for one per
+ * NUMA node; see sharded_solve.h). Default: 1 */
+int trialmdp_set_processes(trialmdp_problem* p, int n_processes);
+
+int trialmdp_solve(trialmdp_problem* p);
+
+/* The solution's values (e.g., "TotalReward"), by index */
+int trialmdp_n_values(trialmdp_problem* p);
+const char* trialmdp_value_name(trialmdp_problem* p, int i);
+
+/* Look up a state of the solved problem. `values` may be NULL;
+ * otherwise it gets trialmdp_n_values entries. Returns nonzero
+ * if the state isn't part of the design. block_size = 0 means
+ * the trial ends. */
+int trialmdp_query(trialmdp_problem* p, int a0, int a1, int b0, int b1,
+                   int* block_size, int* a_allocation, double* values);
+
+/* Save the solution: as a SQLite database (as trial_mdp does),
+ * or in the compact format (see CompactPolicy) */
+int trialmdp_export_sqlite(trialmdp_problem* p, const char* fname,
+                           int reachable_only, int reach_prob);
+int trialmdp_export_compact(trialmdp_problem* p, const char* fname, int value_bits);
+
+void trialmdp_free(trialmdp_problem* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
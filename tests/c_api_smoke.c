@@ -0,0 +1,59 @@
+/* c_api_smoke.c
+ * (c) 2021-03 David Merrell
+ *
+ * Smoke test of the C interface (built by CMake; run by ctest):
+ * solve a small problem, check the first move, and save it.
+ */
+
+#include "trialmdp_c.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv){
+
+    const char* out = (argc > 1) ? argv[1] : "c_api_smoke.sqlite";
+    int block_size, a_allocation, i;
+    double values[16];
+
+    trialmdp_problem* p = trialmdp_create(20, 4.0, 0.025, 4, 2,
+                                          1.0, 1.0, 1.0, 1.0,
+                                          "beta_binom", "scaled_cmh",
+                                          0.2, 0.8, 7);
+    if(p == NULL){
+        fprintf(stderr, "create failed\n");
+        return 1;
+    }
+    if(trialmdp_solve(p) != 0){
+        fprintf(stderr, "solve failed\n");
+        return 1;
+    }
+    if(trialmdp_n_values(p) < 1 || trialmdp_n_values(p) > 16){
+        fprintf(stderr, "unexpected number of values\n");
+        return 1;
+    }
+    if(trialmdp_query(p, 0, 0, 0, 0, &block_size, &a_allocation, values) != 0
+       || block_size < 4 || block_size > 20
+       || a_allocation < 0 || a_allocation > block_size){
+        fprintf(stderr, "bad first move\n");
+        return 1;
+    }
+    for(i = 0; i < trialmdp_n_values(p); ++i){
+        printf("%s = %g\n", trialmdp_value_name(p, i), values[i]);
+    }
+    /* 3 patients isn't a level of this design */
+    if(trialmdp_query(p, 1, 1, 1, 0, &block_size, &a_allocation, NULL) == 0){
+        fprintf(stderr, "found a state between levels\n");
+        return 1;
+    }
+    /* Counts past the 16-bit limit aren't wrapped around */
+    if(trialmdp_query(p, 65536, 0, 0, 0, &block_size, &a_allocation, NULL) == 0){
+        fprintf(stderr, "found a state out of range\n");
+        return 1;
+    }
+    if(trialmdp_export_sqlite(p, out, 0, 0) != 0){
+        fprintf(stderr, "export failed\n");
+        return 1;
+    }
+    trialmdp_free(p);
+    return 0;
+}
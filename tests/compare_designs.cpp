@@ -0,0 +1,84 @@
+// compare_designs.cpp
+// (c) 2021-03 David Merrell
+//
+// Check that two trial designs agree (built by CMake; run by
+// ctest, e.g. to compare the backup orders with the default
+// solve): the same levels and states, the same action in every
+// state, and every value within a relative tolerance.
+//
+// usage: compare_designs A.sqlite B.sqlite TOLERANCE
+
+#include "trial_mdp_table.h"
+#include "contingency_iterator.h"
+#include "state_result.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv){
+
+    if(argc != 4){
+        std::fprintf(stderr, "usage: compare_designs A.sqlite B.sqlite TOLERANCE\n");
+        return 2;
+    }
+    double tol = std::atof(argv[3]);
+
+    std::vector<std::string> names_a, names_b;
+    TrialMDPTable* a;
+    TrialMDPTable* b;
+    try{
+        a = TrialMDPTable::from_sqlite(argv[1], &names_a);
+        b = TrialMDPTable::from_sqlite(argv[2], &names_b);
+    }
+    catch(int code){
+        return 2;
+    }
+    if(a->get_n_vec() != b->get_n_vec() || names_a != names_b){
+        std::fprintf(stderr, "the designs have different levels or values\n");
+        return 1;
+    }
+
+    long n_states = 0;
+    long n_actions_differ = 0;
+    long n_values_differ = 0;
+    double max_diff = 0.0;
+    std::vector<int>& n_vec = a->get_n_vec();
+    for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+        for(ContingencyIterator it(n_vec[idx]); it.in_range(); it.advance()){
+            const StateResult* x = a->lookup(idx, it.value());
+            const StateResult* y = b->lookup(idx, it.value());
+            n_states++;
+            if(x == NULL || y == NULL){
+                if(x != y){ n_actions_differ++; }
+                continue;
+            }
+            if(x->block_size != y->block_size || x->a_allocation != y->a_allocation){
+                n_actions_differ++;
+            }
+            for(unsigned int i = 0; i < names_a.size(); ++i){
+                float u = x->values[i];
+                float v = y->values[i];
+                if(std::isnan(u) && std::isnan(v)){ continue; }
+                if(u == v){ continue; }
+                double diff = std::fabs(double(u) - v);
+                if(std::isnan(diff)){ diff = INFINITY; }
+                max_diff = std::max(max_diff, diff);
+                if(!(diff <= tol*(1.0 + std::fabs(u)))){
+                    n_values_differ++;
+                }
+            }
+        }
+    }
+    a->release();
+    delete a;
+    b->release();
+    delete b;
+
+    std::printf("%ld states: %ld with different actions, %ld values off by more than %g "
+                "(largest difference %g)\n",
+                n_states, n_actions_differ, n_values_differ, tol, max_diff);
+    return (n_actions_differ == 0 && n_values_differ == 0) ? 0 : 1;
+}
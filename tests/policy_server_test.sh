@@ -0,0 +1,53 @@
+#!/bin/sh
+# policy_server_test.sh
+# (c) 2021-03 David Merrell
+#
+# End-to-end check of policy_server and policy_client (run by
+# ctest, after cli_solve and cli_compact): serve the design in
+# both formats on a temporary socket, look up the first state in
+# each, and stop the server with SIGTERM.
+#
+# usage: policy_server_test.sh POLICY_SERVER POLICY_CLIENT DESIGN.sqlite DESIGN.tmdp
+
+server=$1
+client=$2
+dir=$(mktemp -d) || exit 1
+sock=$dir/policy.sock
+
+fail(){
+    echo "failed: $1" >&2
+    kill -TERM "$pid" 2>/dev/null
+    wait "$pid" 2>/dev/null
+    rm -rf "$dir"
+    exit 1
+}
+
+"$server" "$sock" "$3" "$4" > "$dir/server.out" 2>&1 &
+pid=$!
+
+# Wait for the server to load the designs and listen
+i=0
+while [ ! -S "$sock" ]; do
+    kill -0 "$pid" 2>/dev/null || fail "the server exited"
+    i=$((i + 1))
+    [ "$i" -le 100 ] || fail "the server never listened on $sock"
+    sleep 0.1
+done
+
+# Both formats give the same action in the empty table: a block
+# of patients (the design never stops before it starts)
+sqlite_row=$("$client" "$sock" 0 0 0 0 0 | tail -n 1) || fail "lookup in the SQLite design"
+compact_row=$("$client" "$sock" 1 0 0 0 0 | tail -n 1) || fail "lookup in the compact design"
+echo "SQLite:  $sqlite_row"
+echo "compact: $compact_row"
+[ "$sqlite_row" = "$compact_row" ] || fail "the designs disagree"
+block_size=$(echo "$sqlite_row" | cut -f 5)
+[ "$block_size" -gt 0 ] 2>/dev/null || fail "no action in the empty table"
+
+kill -TERM "$pid"
+wait "$pid" || fail "the server failed to stop cleanly"
+grep -q "^requests: 2" "$dir/server.out" || fail "the server's statistics are missing"
+[ ! -e "$sock" ] || fail "the server left its socket behind"
+
+rm -rf "$dir"
+echo "policy_server: all checks passed"
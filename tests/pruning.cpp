@@ -0,0 +1,82 @@
+// pruning.cpp
+// (c) 2021-03 David Merrell
+//
+// Regression check of the branch-and-bound action pruning (built
+// by CMake; run by ctest): with the exhaustive and the coarse-to-fine
+// searches, a pruned solve gives the same action and the same values
+// in every state as set_pruning(false).
+
+#include "trial_mdp.h"
+#include "trial_mdp_table.h"
+#include "contingency_iterator.h"
+#include "state_result.h"
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Count the states whose action or values differ
+static long n_differ(TrialMDPTable& a, TrialMDPTable& b, int n_attr){
+    long n = 0;
+    std::vector<int>& n_vec = a.get_n_vec();
+    for(unsigned int idx = 0; idx < n_vec.size(); ++idx){
+        for(ContingencyIterator it(n_vec[idx]); it.in_range(); it.advance()){
+            const StateResult* x = a.lookup(idx, it.value());
+            const StateResult* y = b.lookup(idx, it.value());
+            if(x->block_size != y->block_size || x->a_allocation != y->a_allocation){
+                n++;
+                continue;
+            }
+            for(int i = 0; i < n_attr; ++i){
+                if(x->values[i] != y->values[i]
+                   && !(std::isnan(x->values[i]) && std::isnan(y->values[i]))){
+                    n++;
+                    break;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+static int check(const char* strategy){
+
+    TrialMDP* solvers[2];
+    std::ostringstream quiet;
+    std::streambuf* out = std::cout.rdbuf(quiet.rdbuf());
+    for(int p = 0; p < 2; ++p){
+        solvers[p] = new TrialMDP(20, 4.0, 0.025, 4, 2, 1.0, 1.0, 1.0, 1.0);
+        solvers[p]->set_action_search(strategy, 3, 0);
+        solvers[p]->set_pruning(p == 1);
+        solvers[p]->solve();
+    }
+    std::cout.rdbuf(out);
+
+    long n = n_differ(solvers[0]->get_results_table(),
+                      solvers[1]->get_results_table(),
+                      solvers[0]->get_attr_names().size());
+    long n_pruned = solvers[1]->get_counts().n_actions_pruned;
+    delete solvers[0];
+    delete solvers[1];
+    if(n_pruned == 0){
+        std::fprintf(stderr, "failed: %s search: no actions were pruned\n", strategy);
+        return 1;
+    }
+    if(n > 0){
+        std::fprintf(stderr, "failed: %s search: %ld states differ when pruned\n",
+                     strategy, n);
+        return 1;
+    }
+    return 0;
+}
+
+int main(){
+
+    int n_failed = check("exhaustive") + check("coarse_to_fine");
+    if(n_failed == 0){
+        std::printf("pruning: all checks passed\n");
+    }
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+// transition_probs.cpp
+// (c) 2021-03 David Merrell
+//
+// Regression check of the transition probabilities (built by
+// CMake; run by ctest): each arm's distribution is finite and
+// sums to one, at the ends of [0, 1] and with the counts of a
+// large trial; and small cases match the closed forms.
+
+#include "transition_dist.h"
+#include "contingency_table.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static int n_failed = 0;
+
+static void check(bool ok, const char* what){
+    if(!ok){
+        std::fprintf(stderr, "failed: %s\n", what);
+        n_failed++;
+    }
+}
+
+// Finite, nonnegative, and summing to one
+static bool is_distribution(const std::vector<float>& probs){
+    double total = 0.0;
+    for(unsigned int i=0; i < probs.size(); ++i){
+        if(!std::isfinite(probs[i]) || probs[i] < 0.0){
+            return false;
+        }
+        total += probs[i];
+    }
+    return std::fabs(total - 1.0) < 1e-4;
+}
+
+int main(){
+
+    // Binomial(4, 0.3), against its closed form
+    std::vector<float> binom = initialize_binom_probs(4, 0.3);
+    const double binom_4[] = {0.2401, 0.4116, 0.2646, 0.0756, 0.0081};
+    for(int x=0; x <= 4; ++x){
+        check(std::fabs(binom[x] - binom_4[x]) < 1e-6, "binomial(4, 0.3)");
+    }
+
+    // The ends of [0, 1]
+    std::vector<float> at_0 = initialize_binom_probs(10, 0.0);
+    std::vector<float> at_1 = initialize_binom_probs(10, 1.0);
+    check(is_distribution(at_0) && at_0[0] == 1.0, "binomial at p = 0");
+    check(is_distribution(at_1) && at_1[10] == 1.0, "binomial at p = 1");
+
+    // Beta-binomial(3; 1, 1) is uniform
+    TransitionDist* dist = TransitionDist::make_transition_dist("beta_binom", 1.0, 1.0, 1.0, 1.0);
+    std::vector<float> uniform = dist->arm_probs(0, 0, 3, true);
+    for(int x=0; x <= 3; ++x){
+        check(std::fabs(uniform[x] - 0.25) < 1e-6, "beta-binomial(3; 1, 1)");
+    }
+
+    // A large trial's counts (a float beta function underflows here)
+    check(is_distribution(dist->arm_probs(1500, 1400, 600, true)), "beta-binomial, large counts");
+    check(is_distribution(dist->arm_probs(0, 2900, 600, false)), "beta-binomial, one-sided counts");
+    delete dist;
+
+    dist = TransitionDist::make_transition_dist("binom", 1.0, 1.0, 1.0, 1.0);
+    check(is_distribution(dist->arm_probs(1500, 1400, 600, true)), "binomial, large counts");
+    delete dist;
+
+    return (n_failed == 0) ? 0 : 1;
+}
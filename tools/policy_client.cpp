@@ -0,0 +1,100 @@
+// policy_client.cpp
+// (c) 2021-03 David Merrell
+//
+// A client for policy_server, for trying it out locally.
+//
+//     policy_client SOCKET POLICY A0 A1 B0 B1 [A0 A1 B0 B1 ...]
+//         look up states, and print their actions
+//     policy_client SOCKET POLICY --bench N_REQUESTS BATCH N_MAX
+//         send N_REQUESTS batches of BATCH random tables
+//         (with at most N_MAX patients), and report latencies
+//     policy_client SOCKET --stats
+//         print the server's statistics
+
+#include "policy_server.h"
+#include "counter_rng.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+int main(int argc, char** argv){
+
+    if(argc == 3 && std::strcmp(argv[2], "--stats") == 0){
+        try{
+            PolicyClient client = PolicyClient(argv[1]);
+            std::cout << client.stats();
+        }
+        catch(int code){
+            return 1;
+        }
+        return 0;
+    }
+
+    if(argc == 7 && std::strcmp(argv[3], "--bench") == 0){
+        int policy = std::atoi(argv[2]);
+        long n_requests = std::atol(argv[4]);
+        int batch = std::atoi(argv[5]);
+        int n_max = std::atoi(argv[6]);
+        try{
+            PolicyClient client = PolicyClient(argv[1]);
+            CounterRNG rng = CounterRNG(1);
+            LatencyHistogram latency;
+            std::vector<ContingencyTable> cts(batch);
+            std::vector<int> block_size, a_allocation;
+            long n_found = 0;
+            for(long r = 0; r < n_requests; ++r){
+                for(int k = 0; k < batch; ++k){
+                    // Uniform over the tables with n patients
+                    int n = int(rng.uniform() * (n_max + 1));
+                    cts[k] = table_unrank(n, int64_t(rng.uniform() * n_tables(n)));
+                }
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                client.lookup(policy, cts, block_size, a_allocation);
+                latency.record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+                for(int k = 0; k < batch; ++k){
+                    n_found += (block_size[k] >= 0);
+                }
+            }
+            std::cout << n_requests << " requests of " << batch << " states ("
+                      << n_found << " found)" << std::endl;
+            std::cout << "round trip p50: " << latency.quantile(0.5)/1000.0 << " us"
+                      << "\tp99: " << latency.quantile(0.99)/1000.0 << " us" << std::endl;
+        }
+        catch(int code){
+            return 1;
+        }
+        return 0;
+    }
+
+    if(argc < 7 || (argc - 3) % 4 != 0){
+        std::cerr << "usage: policy_client SOCKET POLICY A0 A1 B0 B1 [A0 A1 B0 B1 ...]" << std::endl
+                  << "       policy_client SOCKET POLICY --bench N_REQUESTS BATCH N_MAX" << std::endl
+                  << "       policy_client SOCKET --stats" << std::endl;
+        return 2;
+    }
+
+    std::vector<ContingencyTable> cts;
+    for(int i = 3; i < argc; i += 4){
+        cts.push_back(ContingencyTable(std::atoi(argv[i]), std::atoi(argv[i+1]),
+                                       std::atoi(argv[i+2]), std::atoi(argv[i+3])));
+    }
+    try{
+        PolicyClient client = PolicyClient(argv[1]);
+        std::vector<int> block_size, a_allocation;
+        client.lookup(std::atoi(argv[2]), cts, block_size, a_allocation);
+        std::cout << "A0\tA1\tB0\tB1\tBlockSize\tAAllocation" << std::endl;
+        for(unsigned int k = 0; k < cts.size(); ++k){
+            std::cout << cts[k].a0 << "\t" << cts[k].a1 << "\t" << cts[k].b0 << "\t" << cts[k].b1 << "\t";
+            if(block_size[k] < 0){
+                std::cout << "NA\tNA" << std::endl;
+            }else{
+                std::cout << block_size[k] << "\t" << a_allocation[k] << std::endl;
+            }
+        }
+    }
+    catch(int code){
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+// policy_server.cpp
+// (c) 2021-03 David Merrell
+//
+// Serve solved trial designs over a Unix domain socket
+// (see src/policy_server.h).
+//
+//     policy_server SOCKET DESIGN [DESIGN ...]
+//
+// Each DESIGN is a trial design SQLite database or a compact
+// design (see trial_mdp_compact); the first is policy 0, and so on.
+// SIGINT or SIGTERM stops the server, and prints its statistics.
+
+#include "policy_server.h"
+#include <iostream>
+#include <csignal>
+
+PolicyServer* server = NULL;
+
+void handle_signal(int sig){
+    if(server != NULL){
+        server->stop();
+    }
+}
+
+int main(int argc, char** argv){
+
+    if(argc < 3){
+        std::cerr << "usage: policy_server SOCKET DESIGN [DESIGN ...]" << std::endl;
+        return 2;
+    }
+
+    try{
+        server = new PolicyServer(argv[1]);
+        for(int i = 2; i < argc; ++i){
+            int idx = server->add_policy(argv[i]);
+            std::cout << "policy " << idx << ": " << argv[i] << std::endl;
+        }
+    }
+    catch(int code){
+        delete server;
+        return 1;
+    }
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    std::cout << "Listening on " << argv[1] << std::endl;
+
+    server->serve();
+
+    std::cout << server->stats();
+    delete server;
+    return 0;
+}
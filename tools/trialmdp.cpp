@@ -0,0 +1,136 @@
+// trialmdp.cpp
+// (c) 2021-03 David Merrell
+//
+// Compute an optimal trial design from the command line,
+// without R (a client of the C interface, trialmdp_c.h).
+//
+//     trialmdp N_PATIENTS FAILURE_COST BLOCK_COST OUTPUT [options]
+//
+// The options mirror the R function trial_mdp's arguments:
+//     --min-size 4  --block-incr 2
+//     --prior-a0 1  --prior-a1 1  --prior-b0 1  --prior-b1 1
+//     --transition-dist beta_binom  --test-statistic scaled_cmh
+//     --act-l 0.2  --act-u 0.8  --act-n 7
+//     --act-search exhaustive  --act-coarse 7  --epsilon 0
+//     --backup state_major   (or action_major, factored)
+//     --reachable-only  --reach-prob
+//     --compact VALUE_BITS   (save in the compact format instead)
+//     --processes N          (worker processes; 0 for one per NUMA node)
+//
+// The exit status is 0 on success, 1 if the solve or export
+// fails, and 2 for bad arguments.
+
+#include "trialmdp_c.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+void usage(){
+    std::cerr << "usage: trialmdp N_PATIENTS FAILURE_COST BLOCK_COST OUTPUT [options]" << std::endl
+              << "  --min-size N  --block-incr N" << std::endl
+              << "  --prior-a0 X  --prior-a1 X  --prior-b0 X  --prior-b1 X" << std::endl
+              << "  --transition-dist NAME  --test-statistic NAME" << std::endl
+              << "  --act-l X  --act-u X  --act-n N" << std::endl
+              << "  --act-search NAME  --act-coarse N  --epsilon X" << std::endl
+              << "  --backup ORDER" << std::endl
+              << "  --reachable-only  --reach-prob  --compact VALUE_BITS" << std::endl
+              << "  --processes N" << std::endl;
+}
+
+int main(int argc, char** argv){
+
+    if(argc < 5){
+        usage();
+        return 2;
+    }
+    int n_patients = std::atoi(argv[1]);
+    float failure_cost = std::atof(argv[2]);
+    float block_cost = std::atof(argv[3]);
+    std::string output = argv[4];
+
+    int min_size = 4;
+    int block_incr = 2;
+    float prior_a0 = 1.0, prior_a1 = 1.0, prior_b0 = 1.0, prior_b1 = 1.0;
+    std::string transition_dist = "beta_binom";
+    std::string test_statistic = "scaled_cmh";
+    float act_l = 0.2, act_u = 0.8;
+    int act_n = 7;
+    std::string act_search = "exhaustive";
+    int act_coarse = 7;
+    float epsilon = 0.0;
+    std::string backup = "state_major";
+    bool reachable_only = false;
+    bool reach_prob = false;
+    int compact_bits = -1;
+    int n_processes = 1;
+
+    for(int i = 5; i < argc; ++i){
+        std::string opt = argv[i];
+        if(opt == "--reachable-only"){
+            reachable_only = true;
+            continue;
+        }
+        if(opt == "--reach-prob"){
+            reach_prob = true;
+            continue;
+        }
+        if(i + 1 >= argc){
+            std::cerr << "trialmdp: " << opt << " needs a value" << std::endl;
+            usage();
+            return 2;
+        }
+        const char* val = argv[++i];
+        if(opt == "--min-size"){ min_size = std::atoi(val); }
+        else if(opt == "--block-incr"){ block_incr = std::atoi(val); }
+        else if(opt == "--prior-a0"){ prior_a0 = std::atof(val); }
+        else if(opt == "--prior-a1"){ prior_a1 = std::atof(val); }
+        else if(opt == "--prior-b0"){ prior_b0 = std::atof(val); }
+        else if(opt == "--prior-b1"){ prior_b1 = std::atof(val); }
+        else if(opt == "--transition-dist"){ transition_dist = val; }
+        else if(opt == "--test-statistic"){ test_statistic = val; }
+        else if(opt == "--act-l"){ act_l = std::atof(val); }
+        else if(opt == "--act-u"){ act_u = std::atof(val); }
+        else if(opt == "--act-n"){ act_n = std::atoi(val); }
+        else if(opt == "--act-search"){ act_search = val; }
+        else if(opt == "--act-coarse"){ act_coarse = std::atoi(val); }
+        else if(opt == "--epsilon"){ epsilon = std::atof(val); }
+        else if(opt == "--backup"){ backup = val; }
+        else if(opt == "--compact"){ compact_bits = std::atoi(val); }
+        else if(opt == "--processes"){ n_processes = std::atoi(val); }
+        else{
+            std::cerr << "trialmdp: unknown option " << opt << std::endl;
+            usage();
+            return 2;
+        }
+    }
+
+    trialmdp_problem* p = trialmdp_create(n_patients, failure_cost, block_cost,
+                                          min_size, block_incr,
+                                          prior_a0, prior_a1, prior_b0, prior_b1,
+                                          transition_dist.c_str(), test_statistic.c_str(),
+                                          act_l, act_u, act_n);
+    if(p == NULL){
+        return 2;
+    }
+    if(trialmdp_set_action_search(p, act_search.c_str(), act_coarse) != 0
+       || trialmdp_set_epsilon(p, epsilon) != 0
+       || trialmdp_set_backup_order(p, backup.c_str()) != 0
+       || trialmdp_set_processes(p, n_processes) != 0){
+        trialmdp_free(p);
+        return 2;
+    }
+
+    int status = trialmdp_solve(p);
+    if(status == 0){
+        if(compact_bits >= 0){
+            status = trialmdp_export_compact(p, output.c_str(), compact_bits);
+        }else{
+            status = trialmdp_export_sqlite(p, output.c_str(), reachable_only, reach_prob);
+        }
+    }
+    if(status == 0){
+        std::cout << "Saved to file: " << output << std::endl;
+    }
+    trialmdp_free(p);
+    return (status == 0) ? 0 : 1;
+}